@@ -0,0 +1,402 @@
+#include "autosave.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOTS_MIN_CAP 64
+#define OP_DROPPED    0   // an INSERT that was cancelled by a later DELETE
+
+/*
+ * home_slot:
+ * - Same Fibonacci scramble as the ID index so consecutive IDs spread out.
+ */
+static size_t home_slot(int id, size_t cap)
+{
+    uint32_t h = (uint32_t)id * 2654435769u;
+    h ^= h >> 16;
+    return (size_t)h & (cap - 1);
+}
+
+/*
+ * find_pending:
+ * - Looks id up in the map of queued entries.
+ *
+ * Returns:
+ *   pointer to the slot holding id, or to the empty slot where it would go
+ */
+static size_t* find_pending(Autosave* a, int id)
+{
+    size_t mask = a->slot_cap - 1;
+    size_t i = home_slot(id, a->slot_cap);
+    while (a->slots[i] && a->pending[a->slots[i] - 1].st.id != id) {
+        i = (i + 1) & mask;
+    }
+    return &a->slots[i];
+}
+
+/*
+ * grow_slots:
+ * - Rebuilds the map with twice the slots once it is 70% full.
+ *
+ * Returns:
+ *   0  on success, -1 if the allocation failed
+ */
+static int grow_slots(Autosave* a)
+{
+    size_t cap = a->slot_cap ? a->slot_cap * 2 : SLOTS_MIN_CAP;
+    size_t* slots = calloc(cap, sizeof *slots);
+    if (!slots) {
+        return -1;
+    }
+    free(a->slots);
+    a->slots = slots;
+    a->slot_cap = cap;
+
+    for (size_t k = 0; k < a->len; k++) {
+        *find_pending(a, a->pending[k].st.id) = k + 1;
+    }
+    return 0;
+}
+
+/*
+ * copy_name:
+ * - A queued entry's own copy of a name, so the record can be renamed or
+ *   deleted (and the list's names moved) before the entry is written.
+ *
+ * Returns:
+ *   the copy (NULL stays NULL), or NULL with *failed set if memory ran out
+ */
+static const char* copy_name(const char* name, int* failed)
+{
+    if (!name) {
+        return NULL;
+    }
+    size_t n = strlen(name) + 1;
+    char* copy = malloc(n);
+    if (!copy) {
+        *failed = 1;
+        return NULL;
+    }
+    return memcpy(copy, name, n);
+}
+
+static void free_name(JournalEntry* e)
+{
+    free((char*)e->st.name);
+    e->st.name = NULL;
+}
+
+/*
+ * merge:
+ * - Folds a new change into the one already queued for the same ID, so only
+ *   the latest state of each record is written:
+ *     INSERT + UPDATE -> INSERT with the new record
+ *     INSERT + DELETE -> nothing
+ *     UPDATE + DELETE -> DELETE
+ *     DELETE + INSERT -> UPDATE with the new record
+ * - Replay treats INSERT and UPDATE alike (both upsert), so this leaves the
+ *   replayed database exactly as the unmerged entries would.
+ *
+ * Returns:
+ *   0  on success, -1 if the new name could not be copied (e is unchanged)
+ */
+static int merge(JournalEntry* e, JournalOp op, const Student* st)
+{
+    if (op == JOURNAL_DELETE) {
+        e->op = (e->op == JOURNAL_INSERT) ? OP_DROPPED : JOURNAL_DELETE;
+        e->st.id = st->id;
+        free_name(e);
+        return 0;
+    }
+
+    int failed = 0;
+    const char* name = copy_name(st->name, &failed);
+    if (failed) {
+        return -1;
+    }
+    if (e->op == JOURNAL_DELETE) {
+        e->op = JOURNAL_UPDATE;
+    } else if (e->op == OP_DROPPED) {
+        e->op = op;
+    }
+    free_name(e);
+    e->st = *st;
+    e->st.name = name;
+    return 0;
+}
+
+/*
+ * enqueue:
+ * - Adds a copy of the change (name included) to the pending batch,
+ *   merging it with a queued change for the same ID. Called with the lock
+ *   held.
+ *
+ * Returns:
+ *   1  if it was merged into a queued entry
+ *   0  if it was queued as a new entry
+ *  -1  if an allocation failed
+ */
+static int enqueue(Autosave* a, JournalOp op, const Student* st)
+{
+    if ((a->len + 1) * 10 > a->slot_cap * 7 && grow_slots(a) == -1) {
+        return -1;
+    }
+
+    size_t* slot = find_pending(a, st->id);
+    if (*slot) {
+        return merge(&a->pending[*slot - 1], op, st) == -1 ? -1 : 1;
+    }
+
+    if (a->len == a->cap) {
+        size_t cap = a->cap ? a->cap * 2 : SLOTS_MIN_CAP;
+        JournalEntry* p = realloc(a->pending, cap * sizeof *p);
+        if (!p) {
+            return -1;
+        }
+        a->pending = p;
+        a->cap = cap;
+    }
+
+    int failed = 0;
+    const char* name = copy_name(st->name, &failed);
+    if (failed) {
+        return -1;
+    }
+    a->pending[a->len].op = op;
+    a->pending[a->len].st = *st;
+    a->pending[a->len].st.name = name;
+    *slot = ++a->len;
+    return 0;
+}
+
+/*
+ * write_batch:
+ * - Appends every entry that was not cancelled out and syncs once, then
+ *   frees the entries' names.
+ *
+ * Returns:
+ *   number of entries written, or -1 on I/O failure
+ */
+static long write_batch(Journal* j, JournalEntry* batch, size_t n)
+{
+    size_t kept = 0;
+    for (size_t k = 0; k < n; k++) {
+        if (batch[k].op != OP_DROPPED) {
+            batch[kept++] = batch[k];
+        } else {
+            free_name(&batch[k]);
+        }
+    }
+    int rc = kept ? journal_append_batch(j, batch, kept) : 0;
+    for (size_t k = 0; k < kept; k++) {
+        free_name(&batch[k]);
+    }
+    return rc == -1 ? -1 : (long)kept;
+}
+
+/*
+ * worker_main:
+ * - Waits for queued entries, takes the whole pending batch in one go and
+ *   writes it while the command loop keeps queuing into a fresh one.
+ * - Being the only thread that writes, there is never more than one write
+ *   in flight; whatever arrives meanwhile is merged and goes in the next batch.
+ */
+static void* worker_main(void* p)
+{
+    Autosave* a = p;
+    JournalEntry* batch = NULL;
+    size_t batch_cap = 0;
+
+    pthread_mutex_lock(&a->lock);
+    for (;;) {
+        while (!a->stop && (a->len == 0 || a->held)) {
+            pthread_cond_wait(&a->wake, &a->lock);
+        }
+        if (a->len == 0) {
+            break;
+        }
+
+        // Swap buffers: the queued entries become this batch
+        JournalEntry* taken = a->pending;
+        size_t taken_cap = a->cap, n = a->len;
+        a->pending = batch;
+        a->cap = batch_cap;
+        a->len = 0;
+        memset(a->slots, 0, a->slot_cap * sizeof *a->slots);
+        batch = taken;
+        batch_cap = taken_cap;
+        size_t merged = a->merged;
+        a->merged = 0;
+        a->busy = 1;
+        pthread_mutex_unlock(&a->lock);
+
+        long rc = write_batch(a->journal, batch, n);
+
+        pthread_mutex_lock(&a->lock);
+        a->busy = 0;
+        if (rc < 0) {
+            a->failed = 1;
+        } else {
+            a->written += (size_t)rc;
+            a->merged_done += merged;
+        }
+        pthread_cond_broadcast(&a->idle);
+    }
+    pthread_mutex_unlock(&a->lock);
+
+    free(batch);
+    return NULL;
+}
+
+/*
+ * autosave_start:
+ * - Starts the worker that will append to j. If the thread can't be started
+ *   the Autosave still works, it just writes each entry inline.
+ *
+ * Returns:
+ *   0  if the worker is running, -1 if entries will be written inline
+ */
+int autosave_start(Autosave* a, Journal* j)
+{
+    memset(a, 0, sizeof *a);
+    a->journal = j;
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->wake, NULL);
+    pthread_cond_init(&a->idle, NULL);
+
+    a->running = pthread_create(&a->thread, NULL, worker_main, a) == 0;
+    return a->running ? 0 : -1;
+}
+
+/*
+ * autosave_submit:
+ * - Queues a copy of the change for the worker and returns straight away,
+ *   so the caller never waits for the disk. The copy is what gets written,
+ *   whatever happens to the record afterwards.
+ * - Without a worker the entry is appended before returning.
+ *
+ * Returns:
+ *   0  if the change was queued (or written), -1 if it could not be
+ */
+int autosave_submit(Autosave* a, JournalOp op, const Student* st)
+{
+    if (!a->running) {
+        int rc = journal_append(a->journal, op, st);
+        if (rc == -1) {
+            a->failed = 1;
+        } else {
+            a->written++;
+        }
+        return rc;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    int rc = enqueue(a, op, st);
+    if (rc == 1) {
+        a->merged++;
+    }
+    pthread_cond_signal(&a->wake);
+    pthread_mutex_unlock(&a->lock);
+    return rc == -1 ? -1 : 0;
+}
+
+/*
+ * autosave_flush:
+ * - Waits until every queued entry has been written. Used before the journal
+ *   is checkpointed or closed.
+ *
+ * Returns:
+ *   0  if everything was written, -1 if a write has failed since the last report
+ */
+int autosave_flush(Autosave* a)
+{
+    if (!a->running) {
+        return a->failed ? -1 : 0;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    int held = a->held;
+    a->held = 0;
+    pthread_cond_signal(&a->wake);
+    while (a->len > 0 || a->busy) {
+        pthread_cond_wait(&a->idle, &a->lock);
+    }
+    a->held = held;
+    int rc = a->failed ? -1 : 0;
+    pthread_mutex_unlock(&a->lock);
+    return rc;
+}
+
+/*
+ * autosave_hold:
+ * - While held, submitted changes are only queued (and merged); nothing is
+ *   written until the hold is lifted or the queue is flushed. A script run
+ *   or an IMPORT uses this so all of its changes go out as one autosave.
+ * - Holds nest: on adds one, off removes one, and writing resumes when the
+ *   last hold is lifted.
+ */
+void autosave_hold(Autosave* a, int on)
+{
+    pthread_mutex_lock(&a->lock);
+    if (on) {
+        a->held++;
+    } else if (a->held > 0) {
+        a->held--;
+    }
+    pthread_cond_signal(&a->wake);
+    pthread_mutex_unlock(&a->lock);
+}
+
+/*
+ * autosave_report:
+ * - Prints what the worker finished since the last call. The command loop
+ *   calls this before each prompt, so results show up without it ever
+ *   having waited for them.
+ */
+void autosave_report(Autosave* a)
+{
+    pthread_mutex_lock(&a->lock);
+    size_t written = a->written, merged = a->merged_done;
+    int failed = a->failed;
+    a->written = a->merged_done = 0;
+    a->failed = 0;
+    pthread_mutex_unlock(&a->lock);
+
+    if (failed) {
+        printf("Error: Autosave failed.\n");
+    }
+    if (written || merged) {
+        if (merged) {
+            printf("CMS: Autosave completed. (%s updated, %zu change(s), %zu merged) \n",
+                   a->journal->path, written, merged);
+        } else {
+            printf("CMS: Autosave completed. (%s updated) \n", a->journal->path);
+        }
+    }
+}
+
+/*
+ * autosave_stop:
+ * - Lets the worker write what is still queued, then joins it.
+ */
+void autosave_stop(Autosave* a)
+{
+    if (a->running) {
+        pthread_mutex_lock(&a->lock);
+        a->stop = 1;
+        pthread_cond_signal(&a->wake);
+        pthread_mutex_unlock(&a->lock);
+        pthread_join(a->thread, NULL);
+        a->running = 0;
+    }
+
+    for (size_t k = 0; k < a->len; k++) {
+        free_name(&a->pending[k]);
+    }
+    free(a->pending);
+    free(a->slots);
+    pthread_cond_destroy(&a->idle);
+    pthread_cond_destroy(&a->wake);
+    pthread_mutex_destroy(&a->lock);
+}
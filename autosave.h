@@ -0,0 +1,39 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include "journal.h"
+
+typedef struct { //Background thread that appends journal entries off the command loop
+    Journal* journal;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // work was queued, or the worker should stop
+    pthread_cond_t idle;        // a batch finished
+    int running;                // 0 = no thread, entries are written inline
+
+    JournalEntry* pending;      // queued entries, at most one per ID
+    size_t len, cap;
+    size_t* slots;              // open-addressing map: id -> position in pending + 1 (0 = empty)
+    size_t slot_cap;
+
+    int busy;                   // a batch is being written right now
+    int stop;
+    int held;                   // number of holds, see autosave_hold
+
+    size_t merged;              // changes folded into the pending batch
+
+    size_t written;             // results not reported yet
+    size_t merged_done;
+    int failed;
+} Autosave;
+
+int autosave_start(Autosave* a, Journal* j);
+int autosave_submit(Autosave* a, JournalOp op, const Student* st);
+int autosave_flush(Autosave* a);
+void autosave_hold(Autosave* a, int on);
+void autosave_report(Autosave* a);
+void autosave_stop(Autosave* a);
+
+#endif
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "linked_list.h"
+#include "operations.h"
+#include "commands.h"
+#include "journal.h"
+#include "sorted_view.h"
+
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#include <io.h>
+#define NULL_DEVICE "NUL"
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+/*
+ * bench:
+ * Times the hot paths of the CMS on synthetic databases. For each size it
+ * generates a database shaped like P3_1-CMS.txt (weighted programmes,
+ * common first and last names, marks around 65), then measures:
+ *   savedb, opendb, list_find_by_id, a sorted view build (what SHOW ALL
+ *   SORT= does) and a repeat read, show_summary and
+ *   SUMMARY BY PROGRAMME (output discarded), recoverChanges and
+ *   journal_replay on a journal of updates, and list_delete_by_id.
+ *
+ * Output is one tab-separated line per measurement, after a header line:
+ *   records  op  count  seconds  ns_per_op  per_sec  peak_rss_kb
+ * per_sec is records/s for whole-database operations and ops/s otherwise.
+ * Peak RSS is for the whole process so far, so sizes run smallest first.
+ *
+ * Usage: bench [records ...]   (default 10000 100000 1000000)
+ * Files bench_db.txt and bench.journal are written to the current
+ * directory and removed at the end.
+ */
+
+#define BENCH_DB      "bench_db.txt"
+#define BENCH_JOURNAL "bench.journal"
+#define MAX_RECORDS   9000000     // 7-digit IDs: 1000000 .. 9999999
+#define ID_STRIDE     7919        // prime, so i * stride covers every ID once
+
+typedef struct {
+    const char *name;
+    int weight;
+} Weighted;
+
+static const Weighted programmes[] = {
+    { "Computer Science", 22 }, { "Information System", 14 }, { "Software Engineering", 12 },
+    { "Data Science", 10 }, { "Business Administration", 9 }, { "Accountancy", 8 },
+    { "Mechanical Engineering", 6 }, { "Electrical Engineering", 6 }, { "Law", 5 },
+    { "Medicine", 4 }, { "Psychology", 2 }, { "Architecture", 2 },
+};
+
+static const char *first_names[] = {
+    "Joshua", "Kelly", "Alice", "Wei", "Jun", "Mei", "Hui", "Ahmad", "Siti", "Nur",
+    "Daniel", "Sarah", "Ethan", "Chloe", "Ryan", "Rachel", "Marcus", "Priya", "Arjun", "Li",
+    "Jia", "Kai", "Amanda", "Benjamin", "Grace", "Isaac", "Hannah", "Lucas", "Zoe", "Aaron",
+};
+
+static const char *last_names[] = {
+    "Tan", "Lim", "Lee", "Ng", "Ong", "Wong", "Goh", "Chua", "Chan", "Koh",
+    "Teo", "Ang", "Yeo", "Tay", "Ho", "Low", "Toh", "Sim", "Chong", "Chen",
+    "Kumar", "Singh", "Rahman", "Ismail", "Nair", "Smith", "Brown", "Wilson", "Taylor", "Martin",
+};
+
+#define COUNT(a) (sizeof (a) / sizeof (a)[0])
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof pmc))
+        return (long)(pmc.PeakWorkingSetSize / 1024);
+    return -1;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+        return ru.ru_maxrss;        // kilobytes on Linux
+    return -1;
+#endif
+}
+
+// The functions under test print to stdout; these send that to the null device
+static int saved_stdout = -1;
+
+static void quiet_begin(void)
+{
+    fflush(stdout);
+    saved_stdout = dup(fileno(stdout));
+    if (!freopen(NULL_DEVICE, "w", stdout))
+        saved_stdout = -1;
+}
+
+static void quiet_end(void)
+{
+    fflush(stdout);
+    if (saved_stdout != -1) {
+        dup2(saved_stdout, fileno(stdout));
+        close(saved_stdout);
+        saved_stdout = -1;
+    }
+}
+
+static void report(size_t records, const char *op, size_t count, double seconds)
+{
+    double ns = count ? seconds * 1e9 / count : 0;
+    double per_sec = seconds > 0 ? count / seconds : 0;
+    printf("%zu\t%s\t%zu\t%.6f\t%.1f\t%.0f\t%ld\n",
+           records, op, count, seconds, ns, per_sec, peak_rss_kb());
+    fflush(stdout);
+}
+
+static unsigned long long rng_state = 88172645463325252ull;
+
+static unsigned rnd(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (unsigned)(rng_state >> 32);
+}
+
+static const char *pick_programme(void)
+{
+    static int total = 0;
+    if (!total)
+        for (size_t i = 0; i < COUNT(programmes); i++)
+            total += programmes[i].weight;
+
+    int r = (int)(rnd() % (unsigned)total);
+    for (size_t i = 0; i < COUNT(programmes); i++) {
+        if (r < programmes[i].weight)
+            return programmes[i].name;
+        r -= programmes[i].weight;
+    }
+    return programmes[0].name;
+}
+
+static int record_id(size_t i)
+{
+    return 1000000 + (int)((i * ID_STRIDE) % MAX_RECORDS);
+}
+
+// Mark around 65 with a spread of about 12: the sum of four uniforms, clamped
+static float pick_mark(void)
+{
+    double m = 0;
+    for (int k = 0; k < 4; k++)
+        m += rnd() % 10001 / 100.0;
+    m = 65 + (m - 200) * 0.42;
+    if (m < 0)
+        m = 0;
+    if (m > 100)
+        m = 100;
+    return (float)((int)(m * 100 + 0.5) / 100.0);
+}
+
+static void generate(LinkedList *list, size_t n)
+{
+    list_begin_bulk(list);
+    for (size_t i = 0; i < n; i++) {
+        Student st;
+        char name[64];
+        st.id = record_id(i);
+        st.name = name;
+        snprintf(name, sizeof name, "%s %s",
+                 first_names[rnd() % COUNT(first_names)], last_names[rnd() % COUNT(last_names)]);
+        snprintf(st.programme, sizeof st.programme, "%s", pick_programme());
+        st.mark = pick_mark();
+        insert_node(list, &st);
+    }
+    list_end_bulk(list);
+}
+
+static void bench_size(size_t n)
+{
+    LinkedList list;
+    list_init(&list);
+
+    // ----- savedb / opendb -----
+    double t0 = now_sec();
+    generate(&list, n);
+    report(n, "generate", n, now_sec() - t0);
+
+    t0 = now_sec();
+    if (savedb(&list, BENCH_DB) != 0) {
+        fprintf(stderr, "bench: could not write %s\n", BENCH_DB);
+        list_clear(&list);
+        return;
+    }
+    report(n, "savedb", n, now_sec() - t0);
+    list_clear(&list);
+
+    quiet_begin();
+    t0 = now_sec();
+    int rc = opendb(&list, BENCH_DB, 0);
+    double t = now_sec() - t0;
+    quiet_end();
+    if (rc == -1) {
+        fprintf(stderr, "bench: could not open %s\n", BENCH_DB);
+        return;
+    }
+    report(n, "opendb", n, t);
+
+    // ----- lookups: half hits in random order, half misses -----
+    size_t lookups = 1000000;
+    size_t found = 0;
+    t0 = now_sec();
+    for (size_t i = 0; i < lookups; i++) {
+        int id = (i & 1) ? record_id(rnd() % n) : (int)(rnd() % 1000000);
+        found += list_find_by_id(&list, id) != NULL;
+    }
+    report(n, "list_find_by_id", lookups, now_sec() - t0);
+    if (found == 0)
+        fprintf(stderr, "bench: no lookups hit\n");
+
+    // ----- sorting -----
+    SortSpec keys[2] = { { SORT_BY_PROGRAMME, 1 }, { SORT_BY_MARK, 0 } };
+    t0 = now_sec();
+    view_get(&list, keys, 2);
+    report(n, "view_build", n, now_sec() - t0);
+
+    t0 = now_sec();
+    view_get(&list, keys, 2);
+    report(n, "view_cached", 1, now_sec() - t0);
+
+    // ----- summaries -----
+    size_t rounds = 1000;
+    quiet_begin();
+    t0 = now_sec();
+    for (size_t i = 0; i < rounds; i++)
+        show_summary(&list);
+    t = now_sec() - t0;
+    quiet_end();
+    report(n, "show_summary", rounds, t);
+
+    quiet_begin();
+    t0 = now_sec();
+    show_summary_by_programme(&list);
+    t = now_sec() - t0;
+    quiet_end();
+    report(n, "summary_by_programme", n, t);
+
+    // ----- recovery: a journal of updates to 1% of the records -----
+    size_t changes = n / 100 ? n / 100 : 1;
+    Journal j;
+    if (journal_open(&j, BENCH_JOURNAL, BENCH_DB, JOURNAL_FSYNC_NONE) == 0) {
+        JournalEntry *batch = malloc(changes * sizeof *batch);
+        if (batch) {
+            for (size_t i = 0; i < changes; i++) {
+                batch[i].op = JOURNAL_UPDATE;
+                record_to_student(&batch[i].st, &list_find_by_id(&list, record_id(rnd() % n))->s);
+                batch[i].st.mark = pick_mark();
+            }
+            journal_append_batch(&j, batch, changes);
+            free(batch);
+        }
+        journal_close(&j);
+
+        t0 = now_sec();
+        recoverChanges(BENCH_DB, BENCH_JOURNAL);
+        report(n, "recoverChanges", 1, now_sec() - t0);
+
+        size_t applied = 0;
+        t0 = now_sec();
+        journal_replay(BENCH_JOURNAL, &list, NULL, &applied);
+        report(n, "journal_replay", applied, now_sec() - t0);
+        remove(BENCH_JOURNAL);
+    }
+
+    // ----- deletes: 10% of the records in random order -----
+    size_t deletes = n / 10 ? n / 10 : 1;
+    t0 = now_sec();
+    for (size_t i = 0; i < deletes; i++)
+        list_delete_by_id(&list, record_id(rnd() % n));     // repeats miss, like a real typo
+    report(n, "list_delete_by_id", deletes, now_sec() - t0);
+
+    list_clear(&list);
+    remove(BENCH_DB);
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t defaults[] = { 10000, 100000, 1000000 };
+
+    printf("records\top\tcount\tseconds\tns_per_op\tper_sec\tpeak_rss_kb\n");
+    if (argc < 2) {
+        for (size_t i = 0; i < COUNT(defaults); i++)
+            bench_size(defaults[i]);
+        return 0;
+    }
+
+    for (int a = 1; a < argc; a++) {
+        size_t n = (size_t)strtoull(argv[a], NULL, 10);
+        if (n == 0 || n > MAX_RECORDS) {
+            fprintf(stderr, "bench: records must be 1 to %d (IDs have 7 digits)\n", MAX_RECORDS);
+            return 1;
+        }
+        bench_size(n);
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fast_parse.h"
+
+/*
+ * bench_parse:
+ * Microbenchmark for the opendb number parsers. Builds a table of ID and
+ * Mark fields shaped like the ones savedb writes, then times the old
+ * strtol / strtof path against fast_parse_id / fast_parse_mark.
+ *
+ * Before timing it checks that both paths agree:
+ * - every mark from 0.00 to 999.99 gives the same float,
+ * - every 7-digit ID with one byte replaced by any other byte is either
+ *   parsed to the strtol value or handed back to the slow path.
+ *
+ * Usage: bench_parse [fields]   (default 1000000)
+ */
+
+#define FIELD_W 16
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int check_marks(void)
+{
+    char buf[FIELD_W];
+    for (int h = 0; h < 100000; h++) {
+        int len = snprintf(buf, sizeof buf, "%.2f", h / 100.0);
+        float fast;
+        if (!fast_parse_mark(buf, (size_t)len, &fast) || fast != strtof(buf, NULL)) {
+            printf("MISMATCH mark \"%s\"\n", buf);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int check_ids(void)
+{
+    char buf[FIELD_W];
+    for (int pos = 0; pos < 7; pos++) {
+        for (int c = 0; c < 256; c++) {
+            memcpy(buf, "2301234\t", 9);
+            buf[pos] = (char)c;
+
+            int fast;
+            if (!fast_parse_id(buf, 7, &fast)) {
+                continue;                       // slow path handles it, nothing to compare
+            }
+            char *endp;
+            long slow = strtol(buf, &endp, 10);
+            if (endp != buf + 7 || slow != fast) {
+                printf("MISMATCH id byte %d = 0x%02x\n", pos, c);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : 1000000;
+    if (n == 0) {
+        n = 1;
+    }
+
+    if (check_marks() == -1 || check_ids() == -1) {
+        return 1;
+    }
+
+    // Field tables laid out like TSV rows: each field followed by a TAB
+    char *ids   = malloc(n * FIELD_W);
+    char *marks = malloc(n * FIELD_W);
+    size_t *mark_len = malloc(n * sizeof *mark_len);
+    if (!ids || !marks || !mark_len) {
+        puts("out of memory");
+        return 1;
+    }
+
+    srand(12345);
+    for (size_t i = 0; i < n; i++) {
+        snprintf(ids + i * FIELD_W, FIELD_W, "%07d\t", 2000000 + rand() % 1000000);
+        mark_len[i] = (size_t)snprintf(marks + i * FIELD_W, FIELD_W, "%.2f", (rand() % 10001) / 100.0);
+    }
+
+    long long id_slow = 0, id_fast = 0;
+    double mark_slow = 0, mark_fast = 0;
+
+    // ----- old path: copy into a terminated buffer, then strtol / strtof -----
+    double t0 = now_sec();
+    for (size_t i = 0; i < n; i++) {
+        char num[64];
+        memcpy(num, ids + i * FIELD_W, 7);
+        num[7] = '\0';
+        id_slow += strtol(num, NULL, 10);
+    }
+    double t1 = now_sec();
+    for (size_t i = 0; i < n; i++) {
+        char num[64];
+        memcpy(num, marks + i * FIELD_W, mark_len[i]);
+        num[mark_len[i]] = '\0';
+        mark_slow += strtof(num, NULL);
+    }
+    double t2 = now_sec();
+
+    // ----- fast path -----
+    for (size_t i = 0; i < n; i++) {
+        int id;
+        fast_parse_id(ids + i * FIELD_W, 7, &id);
+        id_fast += id;
+    }
+    double t3 = now_sec();
+    for (size_t i = 0; i < n; i++) {
+        float m;
+        fast_parse_mark(marks + i * FIELD_W, mark_len[i], &m);
+        mark_fast += m;
+    }
+    double t4 = now_sec();
+
+    // Both paths must add up to the same totals
+    if (id_slow != id_fast || mark_slow != mark_fast) {
+        puts("MISMATCH totals");
+        return 1;
+    }
+
+    printf("fields: %zu\n", n);
+    printf("id   strtol:        %7.2f ns/op\n", (t1 - t0) * 1e9 / n);
+    printf("id   fast_parse_id: %7.2f ns/op\n", (t3 - t2) * 1e9 / n);
+    printf("mark strtof:        %7.2f ns/op\n", (t2 - t1) * 1e9 / n);
+    printf("mark fast_parse_mark: %5.2f ns/op\n", (t4 - t3) * 1e9 / n);
+
+    free(ids);
+    free(marks);
+    free(mark_len);
+    return 0;
+}
@@ -0,0 +1,33 @@
+
+#include "checksum.h"
+#include <string.h>
+
+#define CHECKSUM_PRIME 0x100000001b3ULL
+
+/*
+ * checksum64:
+ * - FNV-1a style hash that folds in 8 bytes per step instead of one, which
+ *   keeps it cheap enough to run over a whole database file.
+ * - The words are read as little-endian so the result is the same on every
+ *   machine, and seed lets a hash be continued over several buffers (pass
+ *   CHECKSUM_SEED for the first one). It detects corruption, nothing more.
+ */
+uint64_t checksum64(const void* data, size_t len, uint64_t seed)
+{
+    const unsigned char* p = data;
+    uint64_t h = seed;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t w = 0;
+        for (int i = 7; i >= 0; i--) {
+            w = (w << 8) | p[i];
+        }
+        h = (h ^ w) * CHECKSUM_PRIME;
+        h ^= h >> 29;
+    }
+
+    for (; len; p++, len--) {
+        h = (h ^ *p) * CHECKSUM_PRIME;
+    }
+    return h;
+}
@@ -0,0 +1,11 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHECKSUM_SEED 0xcbf29ce484222325ULL
+
+uint64_t checksum64(const void* data, size_t len, uint64_t seed);
+
+#endif
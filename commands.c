@@ -2,8 +2,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <math.h>
 #include "commands.h"
 #include "linked_list.h"
+#include "programme_stats.h"
+#include "sorted_view.h"
 
 
 static const char *skip_ws(const char *p)
@@ -13,6 +17,128 @@ static const char *skip_ws(const char *p)
     return p;
 }
 
+// Copies the text between begin and end into out (at most cap - 1 chars),
+// dropping surrounding spaces. Returns 0 if it did not fit.
+static int copy_field(char *out, size_t cap, const char *begin, const char *end)
+{
+    begin = skip_ws(begin);
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        --end;
+
+    size_t len = (size_t)(end - begin);
+    if (len >= cap)
+        return 0;
+    memcpy(out, begin, len);
+    out[len] = '\0';
+    return 1;
+}
+
+// Letters and spaces only
+static int letters_only(const char *text)
+{
+    for (const char *p = text; *p; ++p)
+    {
+        if (!isalpha((unsigned char)*p) && *p != ' ')
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * The field rules shared by INSERT, UPDATE and IMPORT. Each returns NULL
+ * if the text is acceptable, otherwise the message to show the user.
+ */
+
+const char *check_id(const char *text, int *id)
+{
+    // Check that the ID has exactly 7 characters
+    if (strlen(text) != 7)
+        return "Student ID must be exactly 7 digits.";
+
+    // Check that every character is a digit
+    for (int i = 0; i < 7; i++)
+    {
+        if (!isdigit((unsigned char)text[i]))
+            return "Student ID must contain only digits.";
+    }
+
+    *id = atoi(text);
+    return NULL;
+}
+
+const char *check_name(const char *text)
+{
+    if (text[0] == '\0')
+        return "Student Name cannot be empty.";
+    if (strlen(text) > NAME_LIMIT)
+        return "Student Name cannot exceed 22 characters.";
+    if (!letters_only(text))
+        return "Student Name must contain only letters.";
+    return NULL;
+}
+
+const char *check_programme(const char *text)
+{
+    if (text[0] == '\0')
+        return "Programme cannot be empty.";
+    if (strlen(text) >= MAX_PROGRAM)
+        return "Programme is too long.";
+    if (!letters_only(text))
+        return "Programme must contain only letters.";
+    return NULL;
+}
+
+const char *check_mark(const char *text, float *mark)
+{
+    char *endp;
+    float m = strtof(text, &endp);
+
+    if (endp == text || *skip_ws(endp) != '\0')
+        return "Please enter a valid number.";
+    if (!(m >= 0 && m <= 100)) // also rejects NaN
+        return "Mark must be between 0 and 100.";
+
+    *mark = m;
+    return NULL;
+}
+
+// Checks a whole record given as four (text, length) fields that need not
+// be NUL-terminated, in the order ID, name, programme, mark, and fills *st
+// if every field passes, with st->name pointing at name (the caller's
+// buffer). Returns NULL or the message for the first bad field.
+const char *check_record(const char *const field[4], const size_t len[4], Student *st,
+                         char name[NAME_LIMIT + 1])
+{
+    static const char *too_long[4] = {
+        "Student ID must be exactly 7 digits.", "Student Name cannot exceed 22 characters.",
+        "Programme is too long.", "Please enter a valid number.",
+    };
+    char text[4][MAX_PROGRAM];
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (len[i] >= sizeof text[i])
+            return too_long[i];
+        memcpy(text[i], field[i], len[i]);
+        text[i][len[i]] = '\0';
+    }
+
+    const char *err = check_id(text[0], &st->id);
+    if (!err)
+        err = check_name(text[1]);
+    if (!err)
+        err = check_programme(text[2]);
+    if (!err)
+        err = check_mark(text[3], &st->mark);
+    if (!err)
+    {
+        strcpy(name, text[1]);
+        st->name = name;
+        strcpy(st->programme, text[2]);
+    }
+    return err;
+}
+
 
 void show_all_cmd(const LinkedList *list, int fileOpened)
 {
@@ -23,7 +149,7 @@ void show_all_cmd(const LinkedList *list, int fileOpened)
     }
 
     // If the list is empty or not initialised, just say there are no records
-    if (!list || !list->head)
+    if (!list || list->head == POOL_NIL)
     {
         puts("(no records)");
         return;
@@ -36,10 +162,10 @@ void show_all_cmd(const LinkedList *list, int fileOpened)
     puts("---------- ---------------------- -------------------------- ------");
 
     // Loop through each node and print the student info
-    for (const Node *n = list->head; n; n = n->next)
+    for (const Node *n = list_node(list, list->head); n; n = list_node(list, n->next))
     {
         printf("%-10d %-22.22s %-26.26s %6.2f\n",
-               n->s.id, n->s.name, n->s.programme, n->s.mark);
+               n->s.id, n->s.name, record_programme(&n->s), record_mark(&n->s));
         records++;
     }
 
@@ -48,15 +174,17 @@ void show_all_cmd(const LinkedList *list, int fileOpened)
 }
 
 
-void insertStudentRecords(LinkedList *list, int fileOpened) 
+// Returns the ID of the inserted record, or -1 if nothing was inserted
+int insertStudentRecords(LinkedList *list, int fileOpened) 
 {
     // Must have an opened file before we allow insert
     if (!fileOpened) {
         printf("CMS: Please OPEN the database before inserting records.\n");
-        return; // exit the function immediately if database not opened
+        return -1; // exit the function immediately if database not opened
     }
     
     char buffer[22]; // temporary buffer to store user input
+    char name[50]; // the name; room well past NAME_LIMIT so check_name sees a long one
     Student s; // structure to store validated student data
 
     // -----------------------------
@@ -70,42 +198,15 @@ void insertStudentRecords(LinkedList *list, int fileOpened)
         // Remove trailing newline if present
         buffer[strcspn(buffer, "\n")] = '\0';
 
-        // Check that the ID has exactly 7 characters
-        if (strlen(buffer) != 7) {
-            printf("CMS: Student ID must be exactly 7 digits.\n");
-            continue;
-        }
-
-        // Check that every character is a digit
-        int valid = 1;
-        for (int i = 0; i < 7; i++) {
-            if (!isdigit((unsigned char)buffer[i])) {
-                valid = 0;
-                break;
-            }
-        }
-
-        if (!valid) {
-            printf("CMS: Student ID must contain only digits.\n");
+        int id;
+        const char *err = check_id(buffer, &id);
+        if (err) {
+            printf("CMS: %s\n", err);
             continue; // reprompt
         }
-
-        // Convert the validated string ID to an integer
-        int id = atoi(buffer);
-        
-        // Check for duplicate ID in the linked list
-        Node *n = list->head;
-        int duplicate = 0;
         
-        while (n) {
-            if (n->s.id == id) {
-                duplicate = 1;
-                break;
-            }
-            n = n->next;
-        }
-
-        if (duplicate) {
+        // Check for duplicate ID through the id index
+        if (list_find_by_id(list, id)) {
             printf("CMS: Student record with ID=%d already exists.\n", id);
             continue; // reprompt
         }
@@ -120,34 +221,15 @@ void insertStudentRecords(LinkedList *list, int fileOpened)
     // -----------------------------
     while (1) {
         printf("Enter Student Name (max 22 characters): ");
-        if (!fgets(s.name, MAX_NAME, stdin)) continue;
+        if (!fgets(name, sizeof name, stdin)) continue;
 
         // Remove newline
-        s.name[strcspn(s.name, "\n")] = '\0'; 
-
-        // Disallow empty name
-        if (strlen(s.name) == 0) {
-            printf("CMS: Student Name cannot be empty.\n");
-            continue;
-        }
+        name[strcspn(name, "\n")] = '\0'; 
+        s.name = name;
 
-        // Enforce max length 22 characters
-        if (strlen(s.name) > 22) {
-            printf("CMS: Student Name cannot exceed 22 characters.\n");
-            continue;
-        }
-        
-        // Name must only contain letters and spaces
-        int valid = 1;
-        for (int i = 0; s.name[i] != '\0'; i++) {
-            if (!isalpha((unsigned char)s.name[i]) && s.name[i] != ' ') {
-                valid = 0;
-                break;
-            }
-        }
-        
-        if (!valid) {
-            printf("CMS: Student Name must contain only letters.\n");
+        const char *err = check_name(s.name);
+        if (err) {
+            printf("CMS: %s\n", err);
             continue;
         }
             
@@ -165,23 +247,9 @@ void insertStudentRecords(LinkedList *list, int fileOpened)
         // Remove newline
         s.programme[strcspn(s.programme, "\n")] = '\0'; 
 
-        // Disallow empty programme
-        if (strlen(s.programme) == 0) {
-            printf("CMS: Programme cannot be empty.\n");
-            continue;
-        }
-        
-        // Programme must only contain letters and spaces
-        int valid = 1;
-        for (int i = 0; s.programme[i] != '\0'; i++) {
-            if (!isalpha((unsigned char)s.programme[i]) && s.programme[i] != ' ') {
-                valid = 0;
-                break;
-            }
-        }
-        
-        if (!valid) {
-            printf("CMS: Programme must contain only letters.\n");
+        const char *err = check_programme(s.programme);
+        if (err) {
+            printf("CMS: %s\n", err);
             continue;
         }
         
@@ -199,58 +267,89 @@ void insertStudentRecords(LinkedList *list, int fileOpened)
         // Remove newline
         buffer[strcspn(buffer, "\n")] = '\0'; 
         
-        float mark;
-        // sscanf returns 1 if it successfully reads a float
-        if (sscanf(buffer, "%f", &mark) == 1) {
-            // Ensure mark is in range 0–100
-            if (mark < 0 || mark > 100) {
-                printf("CMS: Mark must be between 0 and 100.\n");
-                continue; // reprompt
-            }
-            
-            // store valid mark
-            s.mark = mark;
-            break; 
-
-        } else {
-            printf("CMS: Please enter a valid number.\n");
+        // Must be a number in the range 0–100
+        const char *err = check_mark(buffer, &s.mark);
+        if (err) {
+            printf("CMS: %s\n", err);
+            continue; // reprompt
         }
+        break;
     }
 
     // -----------------------------
-    // Create a new Node
+    // Insert Node into Linked List
     // -----------------------------
-    Node *newNode = malloc(sizeof(Node)); // allocate memory
-    if (!newNode) {
+    // insert_node appends at the tail and registers the ID in the index
+    if (insert_node(list, &s) != 0) {
         puts("CMS: Memory allocation failed."); // check allocation
-        return;
+        return -1;
     }
-    newNode->s   = s; // copy student data
-    newNode->next = NULL; // end of list
 
-    // -----------------------------
-    // Insert Node into Linked List
-    // -----------------------------
-    if (!list->head) {
-        list->head = newNode; // first node becomes head
-    } else {
-        Node *curr = list->head;
-        while (curr->next)
-            curr = curr->next; // traverse to end
-        curr->next = newNode; // append new node
+    printf("CMS: Student record with ID=%d successfully inserted.\n", s.id);
+    return s.id;
+}
+
+// Inline form used by scripts: "<id>|<name>|<programme>|<mark>".
+// Same rules as the prompts, but a bad field rejects the whole command.
+// Returns the ID of the inserted record, or -1 if nothing was inserted
+int insertInline(LinkedList *list, const char *args, int fileOpened)
+{
+    if (!fileOpened) {
+        printf("CMS: Please OPEN the database before inserting records.\n");
+        return -1;
+    }
+
+    // Split into exactly four '|'-separated fields, without surrounding spaces
+    const char *field[4];
+    size_t len[4];
+    const char *p = args;
+    for (int i = 0; i < 4; i++) {
+        const char *bar = strchr(p, '|');
+        if ((i < 3) != (bar != NULL)) {
+            puts("Please do: INSERT <id>|<name>|<programme>|<mark> instead");
+            return -1;
+        }
+        const char *end = bar ? bar : p + strlen(p);
+
+        field[i] = skip_ws(p);
+        while (end > field[i] && (end[-1] == ' ' || end[-1] == '\t'))
+            --end;
+        len[i] = (size_t)(end - field[i]);
+        p = bar ? bar + 1 : end;
+    }
+
+    Student s;
+    char name[NAME_LIMIT + 1];
+    const char *err = check_record(field, len, &s, name);
+    if (err) {
+        printf("CMS: %s\n", err);
+        return -1;
+    }
+
+    int rc = insert_node(list, &s);
+    if (rc == -2) {
+        printf("CMS: Student record with ID=%d already exists.\n", s.id);
+        return -1;
+    }
+    if (rc != 0) {
+        puts("CMS: Memory allocation failed.");
+        return -1;
     }
 
     printf("CMS: Student record with ID=%d successfully inserted.\n", s.id);
+    return s.id;
 }
 
-static int parse_id(const char *args, int *id)
+// Reads "ID=<number>" from the start of args. Returns a pointer to whatever
+// follows the number (spaces skipped), or NULL if there is no valid ID.
+static const char *scan_id(const char *args, int *id)
 {
     const char *p = skip_ws(args);
 
     // Expect the keyword "ID=" (case-insensitive)
     if (!((p[0] == 'I' || p[0] == 'i') && (p[1] == 'D' || p[1] == 'd') && p[2] == '='))
     {
-        return 0;
+        return NULL;
     }
 
     p += 3;                // move past "ID="
@@ -261,15 +360,34 @@ static int parse_id(const char *args, int *id)
 
     // If nothing was read, then the ID is missing or invalid
     if (endp == p)
-        return 0;
+        return NULL;
+
+    *id = (int)idv;
+    return skip_ws(endp);
+}
 
+static int parse_id(const char *args, int *id)
+{
     // After the number, we only allow whitespace and then end of string
-    endp = (char *)skip_ws(endp);
-    if (*endp != '\0')
-        return 0;
+    const char *rest = scan_id(args, id);
+    return rest && *rest == '\0';
+}
 
-    *id = (int)idv;
-    return 1;
+// Case-insensitive: does text start with prefix (given in upper case)?
+static int has_prefix(const char *text, const char *prefix)
+{
+    while (*prefix && toupper((unsigned char)*text) == *prefix)
+    {
+        ++text;
+        ++prefix;
+    }
+    return *prefix == '\0';
+}
+
+// Case-insensitive "word" followed by nothing but spaces
+static int is_word(const char *text, const char *word)
+{
+    return has_prefix(text, word) && *skip_ws(text + strlen(word)) == '\0';
 }
 
 
@@ -302,39 +420,491 @@ static int yes_no_qn(void)
 }
 
 
+// Table header and row shared by the QUERY forms
+static void print_header(void)
+{
+    printf("%-10s %-22s %-26s %-6s\n", "ID", "Name", "Programme", "Mark");
+    puts(  "---------- ---------------------- -------------------------- ------");
+}
+
+static void print_row(const Record *s)
+{
+    printf("%-10d %-22.22s %-26.26s %6.2f\n", s->id, s->name, record_programme(s), record_mark(s));
+}
+
+/* ----- Sorted display and paging: SHOW ALL SORT=..., LIMIT n [OFFSET m], NEXT ----- */
+
+/*
+ * show_sorted:
+ * - SHOW ALL SORT=...: prints every record in the order of keys through a
+ *   cached view, so the list (and the file SAVE writes) keeps its insertion
+ *   order, and showing the same order again costs only the printing.
+ */
+void show_sorted(LinkedList *list, const SortSpec *keys, size_t nkeys)
+{
+    const SortedView *v = view_get(list, keys, nkeys);
+    if (!v)
+    {
+        puts("CMS: Not enough memory to sort the records.");
+        return;
+    }
+    if (v->len == 0)
+    {
+        puts("(no records)");
+        return;
+    }
+
+    print_header();
+    for (size_t i = 0; i < v->len; i++)
+        print_row(&v->order[i]->s);
+    printf("There are in total %zu record(s).\n", v->len);
+}
+
+// The order a page walks: the cursor's sort keys, or the list's own order
+static const SortedView *page_view(LinkedList *list, const PageCursor *c)
+{
+    return c->nkeys > 0 ? view_get(list, c->keys, c->nkeys) : view_list_order(list);
+}
+
+// Prints up to c->limit rows of v from position pos and moves the cursor past them
+static void print_page(LinkedList *list, PageCursor *c, const SortedView *v, size_t pos)
+{
+    c->shown = pos;
+    if (pos >= v->len)
+    {
+        puts(c->shown ? "CMS: No more records." : "(no records)");
+        c->active = 0;
+        return;
+    }
+
+    size_t first = pos + 1;
+    size_t end = v->len - pos < c->limit ? v->len : pos + c->limit;
+    print_header();
+    for (; pos < end; pos++)
+        print_row(&v->order[pos]->s);
+
+    const Record *last = &v->order[end - 1]->s;
+    // The record's name can move or go before NEXT, so the cursor keeps a copy
+    size_t name_len = strlen(last->name) + 1;
+    char *name = realloc(c->last_name, name_len);
+    if (name)
+    {
+        memcpy(name, last->name, name_len);
+        c->last_name = name;
+    }
+    record_to_student(&c->last, last);
+    c->last.name = name ? name : "";
+    c->last_seq = last->seq;
+    c->shown = end;
+    c->active = end < v->len;
+    if (c->active)
+        printf("CMS: Rows %zu-%zu of %zu. Type NEXT for more.\n", first, c->shown, list->cols.len);
+    else
+        printf("CMS: Rows %zu-%zu of %zu. End of records.\n", first, c->shown, list->cols.len);
+}
+
+/*
+ * show_page:
+ * - SHOW ALL [SORT=...] LIMIT n [OFFSET m]: prints one page and leaves *c
+ *   where it stopped.
+ * - Pages index straight into a cached view - the sort order, or without
+ *   SORT= the list order - so a page costs O(limit) however deep it starts
+ *   (plus building the view the first time that order is asked for).
+ */
+void show_page(LinkedList *list, PageCursor *c, const SortSpec *keys, size_t nkeys,
+               size_t limit, size_t offset)
+{
+    c->limit = limit;
+    c->nkeys = nkeys;
+    if (nkeys > 0)
+        memcpy(c->keys, keys, nkeys * sizeof *keys);
+
+    const SortedView *v = page_view(list, c);
+    if (!v)
+    {
+        puts("CMS: Not enough memory to sort the records.");
+        c->active = 0;
+        return;
+    }
+    print_page(list, c, v, offset);
+}
+
+/*
+ * show_next:
+ * - NEXT: the page after the one SHOW ALL ... LIMIT or NEXT printed last.
+ * - The page resumes right after the last row printed, found by binary
+ *   search in the same view (by Record.seq when unsorted). Rows inserted,
+ *   updated or deleted in the meantime therefore can't make it skip or
+ *   repeat a row that did not move, and the row numbers shown stay exact
+ *   without counting anything again.
+ *
+ * Returns:
+ *   0, or -1 if there is no page in progress
+ */
+int show_next(LinkedList *list, PageCursor *c)
+{
+    if (!c->active)
+    {
+        puts("CMS: Nothing to continue. Start with SHOW ALL LIMIT <n>.");
+        return -1;
+    }
+
+    const SortedView *v = page_view(list, c);
+    Record key;
+    if (!v || record_key(&key, &c->last) == -1)
+    {
+        puts("CMS: Not enough memory to sort the records.");
+        return -1;
+    }
+    key.seq = c->last_seq;
+    size_t pos = view_lower_bound(v, &key);
+    const Record *at = pos < v->len ? &v->order[pos]->s : NULL;
+    if (at && at->id == key.id && (c->nkeys > 0 || at->seq == key.seq))
+        pos++;          // the last row is still there, unchanged
+    print_page(list, c, v, pos);
+    return 0;
+}
+
+// TreeBefore for a lower bound: node x is below it (NaN marks never are)
+static int below_bound(const void *list, uint32_t x, const void *key)
+{
+    const MarkBound *b = key;
+    float m = record_mark(&list_node(list, x)->s);
+    return b->inclusive ? m < b->mark : m <= b->mark;
+}
+
+// Is the node past the upper bound? NaN marks sort last, so they always are
+static int above_bound(const Node *n, const MarkBound *hi)
+{
+    float m = record_mark(&n->s);
+    return hi->inclusive ? !(m <= hi->mark) : !(m < hi->mark);
+}
+
+// QUERY MARK>=a AND MARK<b (any of <, <=, >, >=, = joined by AND), read
+// into the tightest bound on each side
+static int parse_marks(const char *args, QuerySpec *q)
+{
+    MarkBound lo = { 0.0f, 1 }, hi = { 100.0f, 1 };
+    int have_lo = 0, have_hi = 0;
+
+    for (const char *p = skip_ws(args); *p; ) {
+        if (!has_prefix(p, "MARK"))
+            goto usage;
+        p = skip_ws(p + 4);
+
+        // One of <, <=, >, >=, = (which bounds both sides)
+        int less = (*p == '<'), greater = (*p == '>');
+        if (!less && !greater && *p != '=')
+            goto usage;
+        int inclusive = 1;
+        if (less || greater) {
+            inclusive = (p[1] == '=');
+            p += inclusive ? 2 : 1;
+        } else {
+            p++;
+        }
+
+        char *endp;
+        float v = strtof(p, &endp);
+        if (endp == p || v != v)
+            goto usage;
+        p = skip_ws(endp);
+
+        // Keep the tightest bound seen on each side
+        MarkBound b = { v, inclusive };
+        if (!less && (!have_lo || v > lo.mark || (v == lo.mark && !inclusive))) {
+            lo = b;
+            have_lo = 1;
+        }
+        if (!greater && (!have_hi || v < hi.mark || (v == hi.mark && !inclusive))) {
+            hi = b;
+            have_hi = 1;
+        }
+
+        if (has_prefix(p, "AND "))
+            p = skip_ws(p + 4);
+        else if (*p)
+            goto usage;
+    }
+    if (!have_lo && !have_hi)
+        goto usage;
+    if (!have_lo)
+        lo.mark = -HUGE_VALF;
+    if (!have_hi)
+        hi.mark = HUGE_VALF;
+
+    q->kind = QUERY_MARK;
+    q->lo = lo;
+    q->hi = hi;
+    return 1;
+
+usage:
+    puts("Usage: QUERY MARK>=<a> AND MARK<<b>  (operators <, <=, >, >=, =)");
+    return 0;
+}
+
+// TreeBefore for the name tree: node x's name sorts before the prefix
+static int name_before(const void *list, uint32_t x, const void *key)
+{
+    return name_order(list_node(list, x)->s.name, key) < 0;
+}
+
+// Does name start with prefix, ignoring case?
+static int starts_with(const char *name, const char *prefix)
+{
+    while (*prefix && tolower((unsigned char)*name) == tolower((unsigned char)*prefix)) {
+        ++name;
+        ++prefix;
+    }
+    return *prefix == '\0';
+}
+
+/*
+ * parse_query:
+ * - Reads QUERY's arguments (ID=, NAME=, PROGRAMME= or MARK bounds) into
+ *   *q, so the same query can be run against one list or several. Prints
+ *   the usage line when they don't make sense.
+ *
+ * Returns:
+ *   1 if *q was filled in, 0 otherwise
+ */
+int parse_query(const char *args, QuerySpec *q)
+{
+    const char *p = skip_ws(args);
+    if (has_prefix(p, "PROGRAMME=")) {
+        p = skip_ws(p + 10);
+        if (!copy_field(q->text, sizeof q->text, p, p + strlen(p)) || q->text[0] == '\0') {
+            puts("Usage: QUERY PROGRAMME=<programme>");
+            return 0;
+        }
+        q->kind = QUERY_PROGRAMME;
+        return 1;
+    }
+    if (has_prefix(p, "MARK"))
+        return parse_marks(p, q);
+    if (has_prefix(p, "NAME=")) {
+        p = skip_ws(p + 5);
+        if (!copy_field(q->text, sizeof q->text, p, p + strlen(p)) || q->text[0] == '\0') {
+            puts("Usage: QUERY NAME=<name> | QUERY NAME=<prefix>*");
+            return 0;
+        }
+        size_t len = strlen(q->text);
+        q->wildcard = q->text[len - 1] == '*';
+        if (q->wildcard)
+            q->text[len - 1] = '\0';
+        q->kind = QUERY_NAME;
+        return 1;
+    }
+
+    if (!parse_id(args, &q->id)) {
+        puts("Usage: QUERY ID=<id> | QUERY NAME=<prefix>* | QUERY PROGRAMME=<programme> | QUERY MARK>=<a> AND MARK<<b>");
+        return 0;
+    }
+    q->kind = QUERY_ID;
+    return 1;
+}
+
+/*
+ * query_run:
+ * - Calls visit for every record of list that matches q, in the order
+ *   QUERY prints them, and only walks the matches:
+ *   - PROGRAMME= follows the programme index, in insertion order;
+ *   - MARK is a lower bound search in the mark tree, then a walk along it
+ *     until the upper bound;
+ *   - NAME=<prefix>* (or an exact NAME=, case ignored either way) is one
+ *     descent in the name tree, where matching names are adjacent.
+ *
+ * Returns:
+ *   the number of matches
+ */
+size_t query_run(const LinkedList *list, const QuerySpec *q, NodeVisit visit, void *ctx)
+{
+    size_t count = 0;
+
+    if (q->kind == QUERY_ID) {
+        // list_find_by_id in my linked_list.h takes a (non-const) LinkedList*
+        const Node *n = list_find_by_id((LinkedList *)list, q->id);
+        if (n) {
+            visit(ctx, n);
+            count++;
+        }
+    } else if (q->kind == QUERY_PROGRAMME) {
+        const ProgrammeGroup *g = list_programme((LinkedList *)list, q->text);
+        for (const Node *n = g ? list_node(list, g->head) : NULL; n; n = list_node(list, n->group_next)) {
+            visit(ctx, n);
+            count++;
+        }
+    } else if (q->kind == QUERY_MARK) {
+        const Node *n = list_node(list, tree_lower_bound(&list->by_mark, below_bound, &q->lo));
+        for (; n && !above_bound(n, &q->hi); n = list_node(list, tree_next(&list->by_mark, n->slot))) {
+            visit(ctx, n);
+            count++;
+        }
+    } else {
+        const Node *n = list_node(list, tree_lower_bound(&list->by_name, name_before, q->text));
+        for (; n; n = list_node(list, tree_next(&list->by_name, n->slot))) {
+            if (q->wildcard ? !starts_with(n->s.name, q->text) : name_order(n->s.name, q->text) != 0)
+                break;
+            visit(ctx, n);
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * query_order:
+ * - Compares two matches the way query_run orders them (name or mark, then
+ *   ID), so the matches of several lists can be merged. PROGRAMME= and ID=
+ *   matches have no order of their own, so every pair compares equal.
+ */
+int query_order(const QuerySpec *q, const Record *a, const Record *b)
+{
+    int c;
+    if (q->kind == QUERY_NAME)
+        c = name_order(a->name, b->name);
+    else if (q->kind == QUERY_MARK)
+        c = (a->hundredths > b->hundredths) - (a->hundredths < b->hundredths);
+    else
+        return 0;
+    return c ? c : (a->id > b->id) - (a->id < b->id);
+}
+
+/*
+ * query_footer:
+ * - What QUERY prints after count matches: the total, or what was not
+ *   found. A single ID match needs neither.
+ */
+void query_footer(const QuerySpec *q, size_t count)
+{
+    if (count > 0) {
+        if (q->kind != QUERY_ID || count > 1)
+            printf("There are in total %zu record(s).\n", count);
+    } else if (q->kind == QUERY_ID) {
+        printf("No record with ID %d found.\n", q->id);
+    } else if (q->kind == QUERY_PROGRAMME) {
+        printf("No records in programme %s found.\n", q->text);
+    } else if (q->kind == QUERY_MARK) {
+        puts("No records in that mark range found.");
+    } else {
+        printf("No records with name %s%s found.\n", q->text, q->wildcard ? "*" : "");
+    }
+}
+
+// NodeVisit for QUERY: the table header goes out with the first match
+static void print_match(void *ctx, const Node *n)
+{
+    size_t *count = ctx;
+    if ((*count)++ == 0)
+        print_header();
+    print_row(&n->s);
+}
+
 void query(const LinkedList *list, const char *args) {
     if (!list) { 
         puts("(no list)"); 
         return; 
     }
 
+    QuerySpec q;
+    if (!parse_query(args, &q))
+        return;
+
+    size_t count = 0;
+    query_run(list, &q, print_match, &count);
+    query_footer(&q, count);
+}
+
+// TOP k / BOTTOM k: the k highest (or lowest) marks, read off one end of
+// the mark tree. NaN marks are skipped and ties go to the smallest ID
+// first, so TOP 1 and BOTTOM 1 agree with SUMMARY's highest and lowest.
+// highest selects TOP.
+void show_top(const LinkedList *list, const char *args, int highest)
+{
+    char *endp;
+    long k = strtol(args, &endp, 10);
+    if (endp == args || k <= 0 || *skip_ws(endp) != '\0') {
+        puts(highest ? "Usage: TOP <k>" : "Usage: BOTTOM <k>");
+        return;
+    }
+
+    size_t numeric = list_numeric_marks(list);
+    if (numeric == 0) {
+        puts("(no records)");
+        return;
+    }
+
+    print_header();
+    if (!highest) {
+        uint32_t x = tree_at(&list->by_mark, 0);
+        for (size_t i = 0; i < (size_t)k && i < numeric; i++) {
+            print_row(&list_node(list, x)->s);
+            x = tree_next(&list->by_mark, x);
+        }
+        return;
+    }
+
+    // Walk down one mark at a time, printing each run of ties by ascending ID
+    size_t shown = 0, end = numeric;
+    while (shown < (size_t)k && end > 0) {
+        MarkBound at = { record_mark(&list_node(list, tree_at(&list->by_mark, end - 1))->s), 1 };
+        size_t first = tree_count_before(&list->by_mark, below_bound, &at);
+        uint32_t x = tree_at(&list->by_mark, first);
+        for (size_t i = first; i < end && shown < (size_t)k; i++, shown++) {
+            print_row(&list_node(list, x)->s);
+            x = tree_next(&list->by_mark, x);
+        }
+        end = first;
+    }
+}
+
+// RANK ID=<id>: the student's position by mark (1 = highest) and percentile
+// rank, from two O(log n) counts in the mark tree
+void show_rank(const LinkedList *list, const char *args)
+{
     int id = 0;
     if (!parse_id(args, &id)) {
-        puts("Usage: QUERY ID=<id>");
+        puts("Usage: RANK ID=<id>");
         return;
     }
 
-    // list_find_by_id in my linked_list.h takes a (non-const) LinkedList*
-    Node *n = list_find_by_id((LinkedList*)list, id);
+    const Node *n = list_find_by_id((LinkedList *)list, id);
     if (!n) {
         printf("No record with ID %d found.\n", id);
         return;
     }
 
-    printf("%-10s %-22s %-26s %-6s\n", "ID", "Name", "Programme", "Mark");
-    puts(  "---------- ---------------------- -------------------------- ------");
-    printf("%-10d %-22.22s %-26.26s %6.2f\n",
-           n->s.id, n->s.name, n->s.programme, n->s.mark);
-}
+    // Students with a strictly lower mark, and with the same mark
+    float mark = record_mark(&n->s);
+    MarkBound at = { mark, 1 }, above = { mark, 0 };
+    size_t total = tree_size(&list->by_mark);
+    size_t lower = tree_count_before(&list->by_mark, below_bound, &at);
+    size_t same = tree_count_before(&list->by_mark, below_bound, &above) - lower;
+    if (mark != mark) {
+        lower = total - 1;      // a NaN mark sorts last and matches nothing
+        same = 1;
+    }
+
+    // Ties share the best position; percentile counts half of the ties
+    size_t position = total - lower - same + 1;
+    double percentile = 100.0 * ((double)lower + 0.5 * (double)same) / (double)total;
 
+    printf("CMS: ID=%d (%s, %.2f) is ranked %zu of %zu by mark, percentile %.1f.\n",
+           n->s.id, n->s.name, mark, position, total, percentile);
+}
 
-void delete(LinkedList *list, const char *args)
+// "DELETE ID=<id> FORCE" skips the confirmation; without FORCE a
+// non-interactive caller gets an error instead of a question.
+// Returns the ID of the deleted record, or -1 if nothing was deleted
+int delete(LinkedList *list, const char *args, int interactive)
 {
     int id = 0;
-    if (!parse_id(args, &id))
+    const char *rest = scan_id(args, &id);
+    int force = rest && *rest && is_word(rest, "FORCE");
+    if (!rest || (*rest && !force))
     {
         puts("Use DELETE ID=<id>");
-        return;
+        return -1;
     }
 
     // First check if record exists
@@ -342,18 +912,27 @@ void delete(LinkedList *list, const char *args)
     if (!n)
     {
         printf("CMS: The record with ID=%d does not exist.\n", id);
-        return;
+        return -1;
     }
     
-    // Ask for confirmation before actually deleting
-    printf("CMS: Are you sure you want to delete record with ID=%d Please type \"Y\" to confirm or \"N\" to cancel.\n", id);
-    printf("P1_1: ");
-    fflush(stdout); // keep cursor on same line
+    if (!force && !interactive)
+    {
+        printf("CMS: Use DELETE ID=%d FORCE when running a script.\n", id);
+        return -1;
+    }
 
-    if (!yes_no_qn())
+    // Ask for confirmation before actually deleting
+    if (!force)
     {
-        printf("CMS: The deletion is cancelled.\n");
-        return;
+        printf("CMS: Are you sure you want to delete record with ID=%d Please type \"Y\" to confirm or \"N\" to cancel.\n", id);
+        printf("P1_1: ");
+        fflush(stdout); // keep cursor on same line
+
+        if (!yes_no_qn())
+        {
+            printf("CMS: The deletion is cancelled.\n");
+            return -1;
+        }
     }
 
     // Actually remove from the list
@@ -361,22 +940,83 @@ void delete(LinkedList *list, const char *args)
     if (removedcheck)
     {
         printf("CMS: The record with ID=%d is successfully deleted.\n", id);
+        return id;
     }
     else
     {
         // This path is unlikely since we already checked, but it's a safe fallback
         printf("CMS: The record with ID=%d does not exist.\n", id);
+        return -1;
+    }
+}
+
+// Inline form of UPDATE used by scripts: the fields to change follow the ID as
+// NAME=<name>|PROGRAMME=<programme>|MARK=<mark>, any subset in any order.
+// Everything is validated before n is touched.
+static int update_inline(LinkedList *list, Node *n, const char *fields)
+{
+    static const char *keys[3] = { "NAME=", "PROGRAMME=", "MARK=" };
+    Student upd;
+    char name[NAME_LIMIT + 1];
+    record_to_student(&upd, &n->s);
+
+    for (const char *p = fields; *p; )
+    {
+        const char *end = strchr(p, '|');
+        if (!end)
+            end = p + strlen(p);
+        p = skip_ws(p);
+
+        int k = 0;
+        while (k < 3 && !has_prefix(p, keys[k]))
+            k++;
+        if (k == 3)
+        {
+            puts("CMS: Use UPDATE ID=<id> NAME=<name>|PROGRAMME=<programme>|MARK=<mark>");
+            return -1;
+        }
+
+        char text[MAX_PROGRAM];
+        const char *err = NULL;
+        if (!copy_field(text, sizeof text, p + strlen(keys[k]), end))
+            err = k == 0 ? "Student Name cannot exceed 22 characters."
+                : k == 1 ? "Programme is too long." : "Please enter a valid number.";
+        else if (k == 0 && !(err = check_name(text)))
+            upd.name = strcpy(name, text);
+        else if (k == 1 && !(err = check_programme(text)))
+            strcpy(upd.programme, text);
+        else if (k == 2)
+            err = check_mark(text, &upd.mark);
+
+        if (err)
+        {
+            printf("CMS: %s\n", err);
+            return -1;
+        }
+        p = *end ? end + 1 : end;
+    }
+
+    if (list_update(list, n, &upd) != 0)
+    {
+        puts("CMS: Memory allocation failed.");
+        return -1;
     }
+    printf("CMS: The record with ID=%d is successfully updated. \n", n->s.id);
+    return n->s.id;
 }
 
 // This function updates an existing student's record based on the ID provided.
-void updateStudentRecord(LinkedList *list, const char *args) // this function looks for student using studentID and then based on this, updates the record
+// Fields given inline after the ID are applied straight away; otherwise the
+// user is prompted for each one (only allowed when interactive is set).
+// Returns the ID of the updated record, or -1 if nothing changed.
+int updateStudentRecord(LinkedList *list, const char *args, int interactive) // this function looks for student using studentID and then based on this, updates the record
 {
     int id = 0; // creates an integer variable id, its initialized to 0 but this variable is basically for storing the student ID parsed from args
-    if (!parse_id(args, &id)) // calls parse_id to extract the ID from args, if this thing fail, it will prompt an error message and return
+    const char *fields = scan_id(args, &id); // calls scan_id to extract the ID from args, if this thing fail, it will prompt an error message and return
+    if (!fields || (!*fields && !interactive))
     {
         puts("CMS: Use UPDATE ID =<id>");
-        return;
+        return -1;
     }
 
    
@@ -384,13 +1024,21 @@ void updateStudentRecord(LinkedList *list, const char *args) // this function lo
     if (!n) // this checks if the node is NULL, means studentID doesnt not exist inside the linkedlist
     {
         printf("CMS: The record with ID=%d does not exist.\n", id); // this will be printed out if studentID doesnt exist 
-        return;
+        return -1;
+    }
+
+    if (*fields) // fields were given inline, no prompting
+    {
+        return update_inline(list, n, *fields == '|' ? fields + 1 : fields);
     }
 
     printf("CMS: Record with ID=%d found.\n", id); // this will be printed if the n is not NULL, means student ID exists
 
     char buffer[128]; // temporary buffer to hold user input for each field
+    char name[sizeof buffer]; // the new name, kept apart since buffer is reused below
     int fieldUpdated = 0; // this is just for tracking if theres any field updated or not
+    Student upd; // edits go into a copy and are committed through list_update at the end
+    record_to_student(&upd, &n->s);
 
     // optional update for name, since user can just press enter to skip updating name
     while(1) // this is an infinite loop, will break out of it when invalid or valid input is given
@@ -423,15 +1071,14 @@ void updateStudentRecord(LinkedList *list, const char *args) // this function lo
         }
 
        
-        strncpy(n->s.name, buffer, MAX_NAME); // copy the valid name into the student struct
-        n->s.name[MAX_NAME -1] = '\0'; // this ensures null termination
+        upd.name = strcpy(name, buffer); // copy the valid name and point the student struct at it
         fieldUpdated = 1; // this indicates that tehre is changes in the name field 
         break; // this will break out of the loop since we have valid input
     }
     // optional field since user can just press enter to skip updating a programme
     while (1) // infinite loop to keep asking for programme until valid input or skip
     {
-        printf("Enter new Programme (current: %s): ", n->s.programme); // this will prompt for user for new programme, this will still show the current programme inside the parenthesis
+        printf("Enter new Programme (current: %s): ", record_programme(&n->s)); // this will prompt for user for new programme, this will still show the current programme inside the parenthesis
         if (!fgets(buffer, sizeof(buffer), stdin)) continue; // read user input into buffer, if fgets fails, we just reprompt
         buffer[strcspn(buffer, "\n")] = '\0'; // this will remove the trailing newline character from the input
         
@@ -458,8 +1105,8 @@ void updateStudentRecord(LinkedList *list, const char *args) // this function lo
             continue; // reprompt for programme
         }
 
-        strncpy(n->s.programme, buffer, MAX_PROGRAM); // this will make a copy of the valid programme into the student struct
-        n->s.programme[MAX_PROGRAM -1] = '\0'; // this ensures null termination
+        strncpy(upd.programme, buffer, MAX_PROGRAM); // this will make a copy of the valid programme into the student struct
+        upd.programme[MAX_PROGRAM -1] = '\0'; // this ensures null termination
         fieldUpdated = 1; // indicates that there is changes in the programme field
         break;
     }
@@ -467,7 +1114,7 @@ void updateStudentRecord(LinkedList *list, const char *args) // this function lo
     // optional field since user can just press enter to skip updating a mark
     while (1)
     {
-        printf("Enter new Student Mark (current: %.2f): ", n->s.mark); // prompt user for new mark, shows current mark in parentheses
+        printf("Enter new Student Mark (current: %.2f): ", record_mark(&n->s)); // prompt user for new mark, shows current mark in parentheses
         if (!fgets(buffer, sizeof(buffer), stdin)) continue; // read user input into buffer, if fgets fails, we just reprompt
         buffer[strcspn(buffer, "\n")] = '\0'; // this will remove the trailing newline character from the input
 
@@ -486,7 +1133,7 @@ void updateStudentRecord(LinkedList *list, const char *args) // this function lo
                 printf("Error: Mark must be between 0 and 100.\n"); // print error message
                 continue; // reprompt for mark
             }
-            n->s.mark = mark; // update the mark in the student struct
+            upd.mark = mark; // update the mark in the student struct
             fieldUpdated = 1; // indicates that there is changes in the mark field
             break; // break out of the loop since we have valid input
         }
@@ -499,73 +1146,131 @@ void updateStudentRecord(LinkedList *list, const char *args) // this function lo
     
     if (fieldUpdated) // if any field was updated
     {
+        if (list_update(list, n, &upd) != 0) // store the edited copy, keeping the list's columns and indexes in sync
+        {
+            puts("CMS: Memory allocation failed.");
+            return -1;
+        }
         printf("CMS: The record with ID=%d is successfully updated. \n", id); // print success message
+        return id;
     }
     else    
     {
         printf("CMS: No changes made to the record with ID=%d. \n", id); // print message indicating no changes were made
+        return -1;
     }
 }
    
-// Function to swap the data of two Student nodes
-void swapStudents(Node *a, Node *b) {
-    Student temp = a->s; // store data of node a temporarily
-    a->s = b->s; // copy data of node b into node a
-    b->s = temp; // copy temp (original a) into node b
-}
-
-// Function to sort a linked list of students by a given field (ID or MARK)
-// ascending = 1 for ascending order, 0 for descending
-void bubbleSortLinkedList(LinkedList *list, const char *field, int ascending) {
-    // If list is empty or has only one element, nothing to sort
-    if (!list || !list->head || !list->head->next) return;
-
-    int swapped; // flag to check if a swap occurred in a pass
-    Node *ptr; // pointer to traverse the list
-    Node *lptr = NULL; // marks the last node boundary for each pass
-
-    do { 
-        swapped = 0; // reset swap flag at start of each pass
-        ptr = list->head; // start from the head of the list
-
-        // Traverse until the last sorted node
-        while (ptr->next != lptr) { 
-            int cmp = 0; // comparison result between two nodes
-
-            // Compare by ID
-            if (strcmp(field, "ID") == 0) {
-                cmp = ptr->s.id - ptr->next->s.id; // positive if current > next
-            } 
-            // Compare by MARK
-            else if (strcmp(field, "MARK") == 0) {
-                if (ptr->s.mark > ptr->next->s.mark)      cmp = 1;
-                else if (ptr->s.mark < ptr->next->s.mark) cmp = -1;
-                else                                      cmp = 0;
-            }
+// Maps a sort field typed by the user (ID, NAME, PROGRAMME or MARK, any case)
+// onto a SortKey. Returns 1 on success, 0 if the word is not a sort field.
+int parse_sort_key(const char *word, SortKey *key)
+{
+    static const struct { const char *name; SortKey key; } fields[] = {
+        { "ID", SORT_BY_ID }, { "NAME", SORT_BY_NAME },
+        { "PROGRAMME", SORT_BY_PROGRAMME }, { "MARK", SORT_BY_MARK },
+    };
+
+    for (size_t i = 0; i < sizeof fields / sizeof fields[0]; i++) {
+        const char *a = word, *b = fields[i].name;
+        while (*a && toupper((unsigned char)*a) == *b) {
+            ++a;
+            ++b;
+        }
+        if (*a == '\0' && *b == '\0') {
+            *key = fields[i].key;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Parses the inline sort order of "SHOW ALL SORT=<spec>", where spec is one
+// or more comma-separated "<field> [ASC|DESC]" (ascending if omitted), e.g.
+// "MARK DESC,NAME". Returns the number of keys filled in, 0 if spec is invalid.
+size_t parse_sort_spec(const char *text, SortSpec *keys, size_t max)
+{
+    size_t n = 0;
 
-            // Flip comparison result if descending order is requested
-            if (!ascending) cmp = -cmp;
+    for (const char *p = text; ; ) {
+        const char *end = strchr(p, ',');
+        if (!end)
+            end = p + strlen(p);
 
-            // Swap nodes if they are in the wrong order
-            if (cmp > 0) {
-                swapStudents(ptr, ptr->next); // swap the student data
-                swapped = 1; // mark that a swap occurred
-            }
+        char field[16], order[8], extra[2];
+        char item[64];
+        size_t len = (size_t)(end - p);
+        if (n == max || len >= sizeof item)
+            return 0;
+        memcpy(item, p, len);
+        item[len] = '\0';
 
-            // move to the next node
-            ptr = ptr->next;
+        int got = sscanf(item, "%15s %7s %1s", field, order, extra);
+        if (got < 1 || got > 2 || !parse_sort_key(field, &keys[n].key))
+            return 0;
+
+        keys[n].ascending = 1;
+        if (got == 2) {
+            if (is_word(order, "DESC"))
+                keys[n].ascending = 0;
+            else if (!is_word(order, "ASC"))
+                return 0;
         }
-        
-        // After each pass, the last node is in its correct position
-        lptr = ptr;
+        n++;
 
-    } while (swapped); // Repeat passes until no swaps are needed
+        if (*end == '\0')
+            return n;
+        p = end + 1;
+    }
 }
 
-void show_summary(const LinkedList *list)
+/*
+ * summary_of:
+ * - SUMMARY's figures for one list: the count, the sum of the marks and
+ *   the records with the highest and lowest mark.
+ * - Count and sum are kept up to date by every insert, update and delete,
+ *   and the extremes sit at the ends of the mark tree, so nothing is
+ *   scanned here.
+ * - A NaN mark makes the sum NaN, so the average prints as nan, just as
+ *   when SUMMARY added up every mark itself.
+ */
+void summary_of(const LinkedList *list, Summary *out)
+{
+    out->count = list->cols.len;
+    out->sum = list->odd_marks > 0 ? NAN : list->mark_sum;
+
+    const Node *highest = list_highest(list);
+    const Node *lowest = list_lowest(list);
+    out->highest = highest ? &highest->s : NULL;
+    out->lowest = lowest ? &lowest->s : NULL;
+}
+
+// Does a beat b as the highest (or lowest) mark? Equal marks go to the smaller ID
+static int mark_then_id(const Record *a, const Record *b, int highest)
+{
+    if (a->hundredths != b->hundredths)
+        return highest ? a->hundredths > b->hundredths : a->hundredths < b->hundredths;
+    return a->id < b->id;
+}
+
+/*
+ * summary_merge:
+ * - Adds the summary of another list into *into. Ties on the extremes go
+ *   to the smallest ID, as they do inside one list.
+ */
+void summary_merge(Summary *into, const Summary *part)
+{
+    into->count += part->count;
+    into->sum += part->sum;
+    if (part->highest && (!into->highest || mark_then_id(part->highest, into->highest, 1)))
+        into->highest = part->highest;
+    if (part->lowest && (!into->lowest || mark_then_id(part->lowest, into->lowest, 0)))
+        into->lowest = part->lowest;
+}
+
+void print_summary(const Summary *sum)
 {
     // Handle empty list case cleanly
-    if (!list || !list->head)
+    if (sum->count == 0)
     {
         printf("Total number of students: 0\n");
         printf("Average mark: 0.00\n");
@@ -574,53 +1279,141 @@ void show_summary(const LinkedList *list)
         return;
     }
 
-    size_t total_students = 0;
-    float total_marks = 0.0;
-    float highest_mark = -1.0;   // start below possible range
-    float lowest_mark  = 101.0;  // start above possible range
-    char highest_name[MAX_NAME] = "";
-    char lowest_name[MAX_NAME]  = "";
-
-    // Go through the whole list and update stats
-    for (const Node *n = list->head; n; n = n->next)
-    {
-        total_students++;
-        total_marks += n->s.mark;
-
-        // Track highest mark and name
-        if (n->s.mark > highest_mark)
-        {
-            highest_mark = n->s.mark;
-            strncpy(highest_name, n->s.name, MAX_NAME - 1);
-            highest_name[MAX_NAME - 1] = '\0';
-        }
-
-        // Track lowest mark and name
-        if (n->s.mark < lowest_mark)
-        {
-            lowest_mark = n->s.mark;
-            strncpy(lowest_name, n->s.name, MAX_NAME - 1);
-            lowest_name[MAX_NAME - 1] = '\0';
-        }
-    }
-
-    // Compute average safely (though total_students will never be 0 here)
-    float average_mark = total_students > 0 ? total_marks / total_students : 0.0;
+    // Kept in double like the running sum, so it rounds the same way as
+    // SUMMARY BY PROGRAMME's mean
+    double average_mark = sum->sum / (double)sum->count;
 
     // Print out the summary nicely
     printf("CMS: Summary Statistics\n");
-    printf("Total number of students: %zu\n", total_students);
+    printf("Total number of students: %zu\n", sum->count);
     printf("Average mark: %.2f\n", average_mark);
-    
-    if (total_students > 0)
+
+    if (sum->highest && sum->lowest)
     {
-        printf("Highest mark: %.2f (%s)\n", highest_mark, highest_name);
-        printf("Lowest mark: %.2f (%s)\n", lowest_mark, lowest_name);
+        printf("Highest mark: %.2f (%s)\n", record_mark(sum->highest), sum->highest->name);
+        printf("Lowest mark: %.2f (%s)\n", record_mark(sum->lowest), sum->lowest->name);
     }
     else
     {
-        // This branch is just extra defensive code
+        // Only reachable when every mark is NaN
         printf("Highest mark: N/A\n");
         printf("Lowest mark: N/A\n");
     }
 }
+
+void show_summary(const LinkedList *list)
+{
+    Summary sum = { 0 };
+    if (list)
+        summary_of(list, &sum);
+    print_summary(&sum);
+}
+
+// Orders report rows by programme name, ignoring case
+static int cmp_stats_rows(const void *a, const void *b)
+{
+    return name_order(programme_name(((const ProgrammeStats *)a)->group->spelling),
+                      programme_name(((const ProgrammeStats *)b)->group->spelling));
+}
+
+static void print_stats_row(const char *label, const ProgrammeStats *st)
+{
+    if (st->count == 0)
+    {
+        printf("%-26.26s %7d  (no numeric marks)\n", label, 0);
+        return;
+    }
+    printf("%-26.26s %7zu %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f |",
+           label, st->count, st->mean, st->stddev, st->min,
+           st->q1, st->median, st->q3, st->max);
+    for (int b = 0; b < GRADE_BANDS; b++)
+        printf(" %7zu", st->bands[b]);
+    printf("\n");
+}
+
+// SUMMARY BY PROGRAMME: one row of statistics per programme, then a row for
+// every student together. The work happens in programme_stats.
+void show_summary_by_programme(const LinkedList *list)
+{
+    show_summary_by_programme_lists(&list, 1);
+}
+
+// The same report over several lists, programmes matched across them
+void show_summary_by_programme_lists(const LinkedList *const *lists, size_t nlists)
+{
+    ProgrammeStats *rows;
+    size_t n;
+    if (programme_stats(lists, nlists, &rows, &n) == -1)
+    {
+        puts("CMS: Not enough memory to build the summary.");
+        return;
+    }
+
+    qsort(rows, n - 1, sizeof *rows, cmp_stats_rows);
+
+    printf("CMS: Summary by programme\n");
+    printf("%-26s %7s %6s %6s %6s %6s %6s %6s %6s | %7s %7s %7s %7s %7s\n",
+           "Programme", "Count", "Mean", "StdDev", "Min", "Q1", "Median", "Q3", "Max",
+           "A >=80", "B >=70", "C >=60", "D >=50", "F <50");
+    for (size_t i = 0; i + 1 < n; i++)
+        print_stats_row(programme_name(rows[i].group->spelling), &rows[i]);
+    print_stats_row("All programmes", &rows[n - 1]);
+    free(rows);
+}
+
+// Prints one line of the change report; status is ADDED, REMOVED, BEFORE or AFTER
+static void print_change(const char *status, const Record *s)
+{
+    printf("%-8s %-10d %-22.22s %-26.26s %6.2f\n",
+           status, s->id, s->name, record_programme(s), record_mark(s));
+}
+
+// Two records count as the same if every field matches (equal programmes share an id)
+static int same_record(const Record *a, const Record *b)
+{
+    return a->id == b->id && a->hundredths == b->hundredths &&
+           a->programme == b->programme && strcmp(a->name, b->name) == 0;
+}
+
+// Shows a record-level diff between the state before the journal was replayed
+// and the current list. Only IDs the journal touched are looked at (through
+// the id index), so the cost follows the number of changes, not the database size.
+// Returns the number of records that really differ.
+size_t show_changes(const LinkedList *before, const LinkedList *fresh, const LinkedList *after)
+{
+    size_t added = 0, removed = 0, changed = 0;
+
+    printf("%-8s %-10s %-22s %-26s %-6s\n", "Change", "ID", "Name", "Programme", "Mark");
+    puts(  "-------- ---------- ---------------------- -------------------------- ------");
+
+    // IDs that existed before replay: removed, changed, or changed and changed back
+    for (const Node *n = list_node(before, before->head); n; n = list_node(before, n->next))
+    {
+        Node *now = list_find_by_id((LinkedList *)after, n->s.id);
+        if (!now)
+        {
+            print_change("REMOVED", &n->s);
+            removed++;
+        }
+        else if (!same_record(&n->s, &now->s))
+        {
+            print_change("BEFORE", &n->s);
+            print_change("AFTER", &now->s);
+            changed++;
+        }
+    }
+
+    // IDs that did not exist before replay: added, unless deleted again
+    for (const Node *n = list_node(fresh, fresh->head); n; n = list_node(fresh, n->next))
+    {
+        Node *now = list_find_by_id((LinkedList *)after, n->s.id);
+        if (now)
+        {
+            print_change("ADDED", &now->s);
+            added++;
+        }
+    }
+
+    printf("%zu added, %zu removed, %zu changed.\n", added, removed, changed);
+    return added + removed + changed;
+}
@@ -3,13 +3,81 @@
 
 #include "linked_list.h"
 
+#define NAME_LIMIT 22           // longest name INSERT and UPDATE accept (stored names may be longer)
+#define QUERY_TEXT_MAX 512      // as long as a whole batch command line
+
+typedef struct { //Where SHOW ALL ... LIMIT stopped, so NEXT can carry on
+    int active;
+    SortSpec keys[SORT_MAX_KEYS];
+    size_t nkeys;       // 0 = list order
+    size_t limit;
+    size_t shown;       // rows before the next page: the offset plus every row printed
+    Student last;       // last row printed; the next page resumes right after it
+                        // (a copy: the record itself may be deleted meanwhile)
+    char *last_name;    // last.name: the cursor's own copy, reused from page to page
+    uint32_t last_seq;  // and its Record.seq, which places it in list order
+} PageCursor;
+
+typedef struct { //One side of a QUERY MARK range
+    float mark;
+    int inclusive;      // bound is ">=" rather than ">"
+} MarkBound;
+
+typedef enum { //The forms of QUERY
+    QUERY_ID,
+    QUERY_NAME,
+    QUERY_PROGRAMME,
+    QUERY_MARK
+} QueryKind;
+
+typedef struct { //A parsed QUERY, run against one list at a time by query_run
+    QueryKind kind;
+    int id;                     // QUERY ID=
+    char text[QUERY_TEXT_MAX];  // name prefix (without '*') or programme
+    int wildcard;               // QUERY NAME=<prefix>*
+    MarkBound lo, hi;           // QUERY MARK
+} QuerySpec;
+
+typedef void (*NodeVisit)(void *ctx, const Node *n);
+
+typedef struct { //SUMMARY's figures, for one list or merged over several
+    size_t count;
+    double sum;                 // of the marks; NaN if any mark is NaN
+    const Record *highest;      // NULL when no mark is a number
+    const Record *lowest;
+} Summary;
+
 void show_all_cmd(const LinkedList* list, int fileOpened);
-void insertStudentRecords(LinkedList *list, int fileOpened);
+void show_sorted(LinkedList *list, const SortSpec *keys, size_t nkeys);
+void show_page(LinkedList *list, PageCursor *c, const SortSpec *keys, size_t nkeys,
+               size_t limit, size_t offset);
+int show_next(LinkedList *list, PageCursor *c);
+int insertStudentRecords(LinkedList *list, int fileOpened);
+int insertInline(LinkedList *list, const char *args, int fileOpened);
 void query(const LinkedList *list, const char *args);
-void delete(LinkedList *list, const char *args);
-void updateStudentRecord(LinkedList *list, const char * args);
-void swapStudents(Node *a, Node *b);
-void bubbleSortLinkedList(LinkedList *list, const char *field, int ascending);
+int parse_query(const char *args, QuerySpec *q);
+size_t query_run(const LinkedList *list, const QuerySpec *q, NodeVisit visit, void *ctx);
+int query_order(const QuerySpec *q, const Record *a, const Record *b);
+void query_footer(const QuerySpec *q, size_t count);
+void show_top(const LinkedList *list, const char *args, int highest);
+void show_rank(const LinkedList *list, const char *args);
+int delete(LinkedList *list, const char *args, int interactive);
+int updateStudentRecord(LinkedList *list, const char * args, int interactive);
+int parse_sort_key(const char *word, SortKey *key);
+size_t parse_sort_spec(const char *text, SortSpec *keys, size_t max);
+
+const char *check_id(const char *text, int *id);
+const char *check_name(const char *text);
+const char *check_programme(const char *text);
+const char *check_mark(const char *text, float *mark);
+const char *check_record(const char *const field[4], const size_t len[4], Student *st,
+                         char name[NAME_LIMIT + 1]);
+void summary_of(const LinkedList *list, Summary *out);
+void summary_merge(Summary *into, const Summary *part);
+void print_summary(const Summary *sum);
 void show_summary(const LinkedList *list);
+void show_summary_by_programme(const LinkedList *list);
+void show_summary_by_programme_lists(const LinkedList *const *lists, size_t nlists);
+size_t show_changes(const LinkedList *before, const LinkedList *fresh, const LinkedList *after);
 #endif
 
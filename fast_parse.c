@@ -0,0 +1,99 @@
+
+#include "fast_parse.h"
+#include <stdint.h>
+#include <string.h>
+
+#define ID_DIGITS 7
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SWAR_LITTLE_ENDIAN 1
+#endif
+
+/*
+ * fast_parse_id:
+ * - Fast path for the only ID shape the CMS writes: exactly 7 ASCII digits.
+ * - On little-endian machines the digits are checked and converted with one
+ *   8-byte load and three multiplies (SWAR) instead of a strtol call.
+ * - The caller must make sure s[7] is readable; in a TSV row it is the TAB
+ *   that ends the ID field.
+ *
+ * Returns:
+ *   1  if s was 7 digits and *out holds the value
+ *   0  if s has any other shape; the caller should use strtol instead
+ */
+int fast_parse_id(const char* s, size_t len, int* out)
+{
+    if (len != ID_DIGITS) {
+        return 0;
+    }
+
+#ifdef SWAR_LITTLE_ENDIAN
+    uint64_t v;
+    memcpy(&v, s, sizeof v);
+
+    // Drop the byte after the field and put a leading '0' in front,
+    // giving eight digit bytes with the most significant one first.
+    v = (v << 8) | '0';
+
+    // Every byte must be in '0'..'9': adding 0x46 carries out of bit 7 for
+    // bytes above '9', subtracting 0x30 borrows into bit 7 for bytes below '0'.
+    if (((v + 0x4646464646464646ULL) | (v - 0x3030303030303030ULL)) & 0x8080808080808080ULL) {
+        return 0;
+    }
+
+    v -= 0x3030303030303030ULL;
+    v = (v * 10 + (v >> 8)) & 0x00FF00FF00FF00FFULL;               // pairs of digits
+    v = (v * 100 + (v >> 16)) & 0x0000FFFF0000FFFFULL;             // groups of four
+    v = (v * 10000 + (v >> 32)) & 0x00000000FFFFFFFFULL;           // all eight
+    *out = (int)v;
+    return 1;
+#else
+    int value = 0;
+    for (size_t i = 0; i < ID_DIGITS; i++) {
+        unsigned d = (unsigned char)s[i] - '0';
+        if (d > 9) {
+            return 0;
+        }
+        value = value * 10 + (int)d;
+    }
+    *out = value;
+    return 1;
+#endif
+}
+
+/*
+ * fast_parse_mark:
+ * - Fast path for marks written by savedb with "%.2f": one to three digits,
+ *   a '.', then exactly two digits ("5.00", "70.50", "100.00").
+ * - The digits are combined into hundredths and divided once. For values of
+ *   this shape the result is the same float strtof returns (bench_parse
+ *   checks every hundredth from 0.00 to 999.99).
+ * - s does not need to be NUL-terminated and nothing past s[len-1] is read.
+ *
+ * Returns:
+ *   1  if s had the NNN.NN shape and *out holds the value
+ *   0  otherwise; the caller should use strtof instead
+ */
+int fast_parse_mark(const char* s, size_t len, float* out)
+{
+    if (len < 4 || len > 6 || s[len - 3] != '.') {
+        return 0;
+    }
+
+    unsigned hundredths = 0;
+    unsigned bad = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (i == len - 3) {
+            continue;               // the decimal point
+        }
+        unsigned d = (unsigned char)s[i] - '0';
+        bad |= d > 9;
+        hundredths = hundredths * 10 + d;
+    }
+    if (bad) {
+        return 0;
+    }
+
+    *out = (float)(hundredths / 100.0);
+    return 1;
+}
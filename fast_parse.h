@@ -0,0 +1,9 @@
+#ifndef FAST_PARSE_H
+#define FAST_PARSE_H
+
+#include <stddef.h>
+
+int fast_parse_id(const char* s, size_t len, int* out);
+int fast_parse_mark(const char* s, size_t len, float* out);
+
+#endif
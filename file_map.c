@@ -0,0 +1,242 @@
+
+#include "file_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * read_whole_file:
+ * - Fallback for platforms without mmap (the Windows build): reads the file
+ *   into one heap buffer with a single fread.
+ */
+static int read_whole_file(FileMap* fm, const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    if (fseek(f, 0, SEEK_END) != 0) {
+        fclose(f);
+        return -1;
+    }
+    long size = ftell(f);
+    if (size < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return -1;
+    }
+
+    char* buf = NULL;
+    if (size > 0) {
+        buf = malloc((size_t)size);
+        if (!buf || fread(buf, 1, (size_t)size, f) != (size_t)size) {
+            free(buf);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+
+    fm->data   = buf;
+    fm->size   = (size_t)size;
+    fm->mapped = 0;
+    return 0;
+}
+
+/*
+ * map_file:
+ * - Makes the whole file available as one read-only block of memory.
+ * - On POSIX systems the file is mmap'ed, so nothing is copied until a page
+ *   is actually touched; elsewhere it falls back to read_whole_file().
+ * - errno is left set by the failing call so callers can use perror.
+ *
+ * Returns:
+ *   0  on success (an empty file gives data == NULL, size == 0)
+ *  -1  if the file could not be opened or mapped
+ */
+int map_file(FileMap* fm, const char* filename)
+{
+    fm->data   = NULL;
+    fm->size   = 0;
+    fm->mapped = 0;
+
+#ifdef _WIN32
+    return read_whole_file(fm, filename);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (sb.st_size == 0) {
+        close(fd);
+        return 0;  // mmap refuses zero-length mappings; an empty view is fine
+    }
+
+    void* p = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);     // the mapping keeps its own reference to the file
+    if (p == MAP_FAILED) {
+        // e.g. a pipe or special file: read it the ordinary way instead
+        return read_whole_file(fm, filename);
+    }
+
+    madvise(p, (size_t)sb.st_size, MADV_SEQUENTIAL);
+    fm->data   = p;
+    fm->size   = (size_t)sb.st_size;
+    fm->mapped = 1;
+    return 0;
+#endif
+}
+
+/*
+ * unmap_file:
+ * - Releases whatever map_file set up.
+ */
+void unmap_file(FileMap* fm)
+{
+#ifndef _WIN32
+    if (fm->mapped) {
+        munmap((void*)fm->data, fm->size);
+    } else
+#endif
+    {
+        free((void*)fm->data);
+    }
+    fm->data = NULL;
+    fm->size = 0;
+    fm->mapped = 0;
+}
+
+/*
+ * replace_open:
+ * - Starts writing a new version of filename. The data goes to
+ *   "<filename>.tmp"; filename itself stays untouched until
+ *   replace_commit, so a crash or a full disk halfway through a save never
+ *   leaves it half-written.
+ *
+ * Returns:
+ *   the stream to write to, or NULL if the temporary file could not be
+ *   created (errno set)
+ */
+FILE* replace_open(FileReplace* r, const char* filename, const char* mode)
+{
+    r->f = NULL;
+    if ((size_t)snprintf(r->path, sizeof r->path, "%s", filename) >= sizeof r->path ||
+        (size_t)snprintf(r->tmp, sizeof r->tmp, "%s.tmp", filename) >= sizeof r->tmp) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    r->f = fopen(r->tmp, mode);
+    return r->f;
+}
+
+// Makes the rename itself durable: fsync the directory holding path
+static int sync_parent_dir(const char* path)
+{
+#ifdef _WIN32
+    (void)path;     // MOVEFILE_WRITE_THROUGH already waited for it
+    return 0;
+#else
+    char dir[256];
+    const char* slash = strrchr(path, '/');
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == path) {
+        strcpy(dir, "/");
+    } else {
+        snprintf(dir, sizeof dir, "%.*s", (int)(slash - path), path);
+    }
+
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = fsync(fd);
+    if (rc != 0 && (errno == EINVAL || errno == ENOTSUP)) {
+        rc = 0;     // the filesystem can't sync directories; nothing more to do
+    }
+    close(fd);
+    return rc;
+#endif
+}
+
+/*
+ * replace_commit:
+ * - Flushes and fsyncs the temporary file, closes it, renames it over the
+ *   original and fsyncs the directory, in that order. Only after this
+ *   returns 0 is the new version guaranteed to be the one on disk.
+ * - On failure the temporary file is removed and the original is left as
+ *   it was; errno is set for perror.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  on I/O failure
+ */
+int replace_commit(FileReplace* r)
+{
+    FILE* f = r->f;
+    r->f = NULL;
+
+    int ok = fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    int saved = errno;
+    if (fclose(f) != 0) {
+        ok = 0;
+        saved = errno;
+    }
+    if (!ok) {
+        remove(r->tmp);
+        errno = saved;
+        return -1;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(r->tmp, r->path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        remove(r->tmp);
+        errno = EIO;
+        return -1;
+    }
+#else
+    if (rename(r->tmp, r->path) != 0) {
+        saved = errno;
+        remove(r->tmp);
+        errno = saved;
+        return -1;
+    }
+#endif
+    return sync_parent_dir(r->path);
+}
+
+/*
+ * replace_abort:
+ * - Gives up on the new version: closes and removes the temporary file.
+ */
+void replace_abort(FileReplace* r)
+{
+    if (r->f) {
+        fclose(r->f);
+        r->f = NULL;
+    }
+    remove(r->tmp);
+}
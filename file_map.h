@@ -0,0 +1,26 @@
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct { //Read-only view of a whole file
+    const char* data;   // NULL for an empty file
+    size_t size;
+    int mapped;         // 1 if data came from mmap, 0 if it was read into a heap buffer
+} FileMap;
+
+typedef struct { //A new version of a file, written beside it until it is complete
+    FILE* f;
+    char path[256];     // the file that gets replaced
+    char tmp[260];      // path + ".tmp"
+} FileReplace;
+
+int map_file(FileMap* fm, const char* filename);
+void unmap_file(FileMap* fm);
+
+FILE* replace_open(FileReplace* r, const char* filename, const char* mode);
+int replace_commit(FileReplace* r);
+void replace_abort(FileReplace* r);
+
+#endif
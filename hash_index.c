@@ -0,0 +1,203 @@
+
+#include "hash_index.h"
+#include "linked_list.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define INDEX_MIN_CAP 64
+
+/*
+ * home_slot:
+ * - Maps an id onto its preferred slot.
+ * - Student IDs are mostly consecutive 7-digit numbers, so I scramble them
+ *   with a Fibonacci multiply before masking, otherwise neighbouring IDs
+ *   would pile up in neighbouring slots.
+ */
+static size_t home_slot(int id, size_t cap)
+{
+    uint32_t h = (uint32_t)id * 2654435769u;
+    h ^= h >> 16;
+    return (size_t)h & (cap - 1);
+}
+
+/*
+ * index_init:
+ * - Starts the index off empty. Slots are only allocated on the first insert
+ *   so an unused list costs nothing.
+ */
+void index_init(IdIndex* ix)
+{
+    ix->slots = NULL;
+    ix->cap   = 0;
+    ix->count = 0;
+}
+
+/*
+ * index_free:
+ * - Releases the slot array. The nodes themselves belong to the list.
+ */
+void index_free(IdIndex* ix)
+{
+    free(ix->slots);
+    index_init(ix);
+}
+
+// The id of the node an occupied slot points at
+static int slot_id(const NodePool* pool, uint32_t slot)
+{
+    return POOL_NODE(pool, slot - 1)->s.id;
+}
+
+/*
+ * grow:
+ * - Allocates a slot array of new_cap entries and re-inserts every node.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if the allocation failed (the old table is left untouched)
+ */
+static int grow(IdIndex* ix, const NodePool* pool, size_t new_cap)
+{
+    uint32_t* slots = calloc(new_cap, sizeof *slots);
+    if (!slots) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < ix->cap; i++) {
+        if (!ix->slots[i]) {
+            continue;
+        }
+        size_t j = home_slot(slot_id(pool, ix->slots[i]), new_cap);
+        while (slots[j]) {
+            j = (j + 1) & (new_cap - 1);
+        }
+        slots[j] = ix->slots[i];
+    }
+
+    free(ix->slots);
+    ix->slots = slots;
+    ix->cap   = new_cap;
+    return 0;
+}
+
+/*
+ * index_reserve:
+ * - Grows the table once so that n entries fit under the 70% load limit,
+ *   instead of doubling step by step while a large batch is inserted.
+ *
+ * Returns:
+ *   0  on success (or if it is already big enough)
+ *  -1  if the allocation failed
+ */
+int index_reserve(IdIndex* ix, const NodePool* pool, size_t n)
+{
+    size_t cap = ix->cap ? ix->cap : INDEX_MIN_CAP;
+    while (n * 10 > cap * 7) {
+        cap *= 2;
+    }
+    return cap == ix->cap ? 0 : grow(ix, pool, cap);
+}
+
+/*
+ * index_find:
+ * - Linear probing from the id's home slot until we hit the id or an empty slot.
+ *
+ * Returns:
+ *   pointer to the matching Node
+ *   NULL if the id is not indexed
+ */
+Node* index_find(const IdIndex* ix, const NodePool* pool, int id)
+{
+    if (ix->cap == 0) {
+        return NULL;
+    }
+
+    size_t mask = ix->cap - 1;
+    for (size_t i = home_slot(id, ix->cap);; i = (i + 1) & mask) {
+        uint32_t slot = ix->slots[i];
+        if (!slot) {
+            return NULL;
+        }
+        Node* n = POOL_NODE(pool, slot - 1);
+        if (n->s.id == id) {
+            return n;
+        }
+    }
+}
+
+/*
+ * index_insert:
+ * - Adds n under n->s.id, growing the table once it is 70% full so probe
+ *   sequences stay short.
+ *
+ * Returns:
+ *   0  on success
+ *   1  if another node with the same id is already indexed
+ *  -1  if growing the table failed
+ */
+int index_insert(IdIndex* ix, const NodePool* pool, const Node* n)
+{
+    if ((ix->count + 1) * 10 > ix->cap * 7) {
+        if (grow(ix, pool, ix->cap ? ix->cap * 2 : INDEX_MIN_CAP) == -1) {
+            return -1;
+        }
+    }
+
+    size_t mask = ix->cap - 1;
+    size_t i = home_slot(n->s.id, ix->cap);
+    while (ix->slots[i]) {
+        if (slot_id(pool, ix->slots[i]) == n->s.id) {
+            return 1;
+        }
+        i = (i + 1) & mask;
+    }
+
+    ix->slots[i] = n->slot + 1;
+    ix->count++;
+    return 0;
+}
+
+/*
+ * index_remove:
+ * - Removes the entry for id.
+ * - Uses backward-shift deletion instead of tombstones: every entry after the
+ *   hole that could legally live in it gets moved back, so lookups never have
+ *   to skip over dead slots no matter how many deletes happen.
+ *
+ * Returns:
+ *   1  if the id was found and removed
+ *   0  if the id was not indexed
+ */
+int index_remove(IdIndex* ix, const NodePool* pool, int id)
+{
+    if (ix->cap == 0) {
+        return 0;
+    }
+
+    size_t mask = ix->cap - 1;
+    size_t hole = home_slot(id, ix->cap);
+    for (;; hole = (hole + 1) & mask) {
+        if (!ix->slots[hole]) {
+            return 0;
+        }
+        if (slot_id(pool, ix->slots[hole]) == id) {
+            break;
+        }
+    }
+
+    for (size_t j = (hole + 1) & mask; ix->slots[j]; j = (j + 1) & mask) {
+        size_t home = home_slot(slot_id(pool, ix->slots[j]), ix->cap);
+
+        // Entry j may move into the hole only if its home slot is not in (hole, j]
+        int stays = (hole <= j) ? (home > hole && home <= j)
+                                : (home > hole || home <= j);
+        if (!stays) {
+            ix->slots[hole] = ix->slots[j];
+            hole = j;
+        }
+    }
+
+    ix->slots[hole] = 0;
+    ix->count--;
+    return 1;
+}
@@ -0,0 +1,23 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "node_pool.h"
+
+struct Node;
+
+typedef struct { //Open-addressing hash index: Student.id -> the node's pool slot
+    uint32_t* slots;      // pool slot + 1, 0 marks an empty slot
+    size_t cap;           // number of slots, always a power of two (0 = not allocated yet)
+    size_t count;         // number of occupied slots
+} IdIndex;
+
+void index_init(IdIndex* ix);
+void index_free(IdIndex* ix);
+int index_reserve(IdIndex* ix, const NodePool* pool, size_t n);
+struct Node* index_find(const IdIndex* ix, const NodePool* pool, int id);
+int index_insert(IdIndex* ix, const NodePool* pool, const struct Node* n);
+int index_remove(IdIndex* ix, const NodePool* pool, int id);
+
+#endif
@@ -0,0 +1,572 @@
+
+#include "journal.h"
+#include "checksum.h"
+#include "file_map.h"
+#include "snapshot.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define fsync_file(f) _commit(_fileno(f))
+#else
+#include <unistd.h>
+#define fsync_file(f) fsync(fileno(f))
+#endif
+
+/*
+ * Journal layout, all integers little-endian:
+ *
+ *   header (32 bytes): magic "CMSJ", version (uint32),
+ *                      size (uint64) and checksum64 (uint64) of the database
+ *                      file the entries apply to, 8 reserved zero bytes
+ *   entry (n bytes):   n (uint32), op (1) + 3 zero bytes, sequence number
+ *                      (uint64), the Student as a snapshot record (as long
+ *                      as its name needs), checksum64 over everything
+ *                      before it (uint64), n again (uint32)
+ *
+ * A DELETE entry only needs the ID; the rest of its record is empty.
+ * Entries are only ever appended. If the program dies halfway through a
+ * write, the torn last entry fails its checksum and replay stops there.
+ * The trailing copy of n lets journal_probe find the last entry from the
+ * end of the file.
+ */
+
+#define JOURNAL_MAGIC   "CMSJ"
+#define JOURNAL_VERSION 3
+#define JOURNAL_HEADER  32
+#define ENTRY_FIXED     (4 + 4 + 8 + 8 + 4)     // everything but the record
+#define ENTRY_MIN       (ENTRY_FIXED + SNAPSHOT_RECORD_MIN)
+#define ENTRY_SMALL     256                     // entries up to this size are built on the stack
+#define JOURNAL_BATCH   32
+
+static void put_le(unsigned char* p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint64_t get_le(const unsigned char* p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+/*
+ * entry_ok:
+ * - Checks the entry at e, which has avail bytes after it: both copies of
+ *   its size, and its checksum.
+ *
+ * Returns:
+ *   the entry's size, or 0 if it is torn or corrupt
+ */
+static size_t entry_ok(const unsigned char* e, size_t avail)
+{
+    if (avail < ENTRY_MIN) {
+        return 0;
+    }
+    size_t n = get_le(e, 4);
+    if (n < ENTRY_MIN || n > avail || get_le(e + n - 4, 4) != n ||
+        checksum64(e, n - 12, CHECKSUM_SEED) != get_le(e + n - 12, 8)) {
+        return 0;
+    }
+    return n;
+}
+
+/*
+ * file_fingerprint:
+ * - Size and checksum64 of a whole file; a missing file counts as empty.
+ */
+static void file_fingerprint(const char* path, uint64_t* size, uint64_t* hash)
+{
+    FileMap fm;
+    *size = 0;
+    *hash = 0;
+    if (map_file(&fm, path) == 0) {
+        *size = fm.size;
+        *hash = checksum64(fm.data, fm.size, CHECKSUM_SEED);
+        unmap_file(&fm);
+    }
+}
+
+/*
+ * write_header:
+ * - Empties the journal file and writes a fresh header that fingerprints
+ *   the database file as it is right now. This only happens when the
+ *   journal starts over (first run, SAVE, recovery), never per edit.
+ */
+static int write_header(Journal* j)
+{
+    uint64_t size, hash;
+    file_fingerprint(j->db_path, &size, &hash);
+
+    unsigned char h[JOURNAL_HEADER];
+    memset(h, 0, sizeof h);
+    memcpy(h, JOURNAL_MAGIC, 4);
+    put_le(h + 4, JOURNAL_VERSION, 4);
+    put_le(h + 8, size, 8);
+    put_le(h + 16, hash, 8);
+
+    FILE* f = freopen(j->path, "wb", j->f);
+    j->f = f;
+    if (!f || fwrite(h, 1, sizeof h, f) != sizeof h || fflush(f) != 0) {
+        perror("journal: write header");
+        return -1;
+    }
+    fsync_file(f);
+
+    // Switch back to append mode so every write lands at the end
+    j->f = freopen(j->path, "ab", f);
+    if (!j->f) {
+        perror("journal: reopen");
+        return -1;
+    }
+    j->seq = 0;
+    j->unsynced = 0;
+    return 0;
+}
+
+/*
+ * journal_open:
+ * - Opens (or creates) the journal at path for appending. dbFile is the
+ *   database the entries apply to; its fingerprint goes into the header.
+ * - An existing journal is kept as it is, so opening it costs the same
+ *   however big the database is. Only a missing/foreign file or one with a
+ *   torn tail gets a fresh header. A journal written by another version
+ *   of the CMS can't be replayed, so if it holds entries it is moved aside
+ *   to "<path>.v<N>" first rather than lost.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if the file could not be opened
+ */
+int journal_open(Journal* j, const char* path, const char* dbFile, JournalSync sync)
+{
+    snprintf(j->path, sizeof j->path, "%s", path);
+    snprintf(j->db_path, sizeof j->db_path, "%s", dbFile);
+    j->sync = sync;
+    j->unsynced = 0;
+
+    JournalInfo info;
+    journal_probe(path, &info);
+
+    struct stat sb;
+    if (info.version && info.version != JOURNAL_VERSION &&
+        stat(path, &sb) == 0 && sb.st_size > JOURNAL_HEADER) {
+        char aside[sizeof j->path + 16];
+        snprintf(aside, sizeof aside, "%s.v%u", path, info.version);
+        if (rename(path, aside) == 0) {
+            printf("CMS: %s is from another version of the CMS and can't be replayed; kept it as %s.\n",
+                   path, aside);
+        }
+    }
+
+    j->f = fopen(path, "ab");
+    if (!j->f) {
+        perror("journal: fopen");
+        return -1;
+    }
+
+    if (!info.valid || info.torn) {
+        return write_header(j);
+    }
+    j->seq = info.entries;
+    return 0;
+}
+
+/*
+ * journal_sync:
+ * - Flushes stdio buffers and forces the entries onto the disk.
+ *
+ * Returns:
+ *   0  on success, -1 on I/O failure
+ */
+int journal_sync(Journal* j)
+{
+    if (!j->f) {
+        return -1;
+    }
+    if (fflush(j->f) != 0 || fsync_file(j->f) != 0) {
+        perror("journal: sync");
+        return -1;
+    }
+    j->unsynced = 0;
+    return 0;
+}
+
+/*
+ * write_entry:
+ * - Encodes one checksummed entry and hands it to stdio without syncing.
+ *
+ * Returns:
+ *   0  on success, -1 on allocation or I/O failure
+ */
+static int write_entry(Journal* j, JournalOp op, const Student* st)
+{
+    Student only_id = { .id = st->id };
+    if (op == JOURNAL_DELETE) {
+        st = &only_id;
+    }
+
+    size_t n = ENTRY_FIXED + snapshot_record_size(st);
+    unsigned char small[ENTRY_SMALL];
+    unsigned char* e = n <= sizeof small ? small : malloc(n);
+    if (!e) {
+        perror("journal: malloc");
+        return -1;
+    }
+    memset(e, 0, 16);
+    put_le(e, n, 4);
+    e[4] = (unsigned char)op;
+    put_le(e + 8, j->seq, 8);
+    snapshot_encode_record(e + 16, st);
+    put_le(e + n - 12, checksum64(e, n - 12, CHECKSUM_SEED), 8);
+    put_le(e + n - 4, n, 4);
+
+    size_t put = fwrite(e, 1, n, j->f);
+    if (e != small) {
+        free(e);
+    }
+    if (put != n) {
+        perror("journal: fwrite");
+        return -1;
+    }
+    STATS_ADD(STAT_BYTES_JOURNALED, n);
+    j->seq++;
+    j->unsynced++;
+    return 0;
+}
+
+/*
+ * sync_by_policy:
+ * - Forces what was written so far to disk if the journal's JournalSync
+ *   policy asks for it, otherwise just flushes stdio.
+ */
+static int sync_by_policy(Journal* j)
+{
+    if (j->sync == JOURNAL_FSYNC_ALWAYS ||
+        (j->sync == JOURNAL_FSYNC_BATCH && j->unsynced >= JOURNAL_BATCH)) {
+        return journal_sync(j);
+    }
+    return fflush(j->f) == 0 ? 0 : -1;
+}
+
+/*
+ * journal_append:
+ * - Appends one checksummed entry describing a change and syncs it
+ *   according to the journal's JournalSync policy.
+ * - This costs the same no matter how large the database is.
+ *
+ * Returns:
+ *   0  on success, -1 on I/O failure
+ */
+int journal_append(Journal* j, JournalOp op, const Student* st)
+{
+    if (!j->f) {
+        return -1;
+    }
+    if (write_entry(j, op, st) == -1) {
+        return -1;
+    }
+    return sync_by_policy(j);
+}
+
+/*
+ * journal_append_batch:
+ * - Appends n entries and then applies the sync policy once for the whole
+ *   batch, so under JOURNAL_FSYNC_ALWAYS a burst of edits costs a single
+ *   fsync instead of one per entry.
+ *
+ * Returns:
+ *   0  on success, -1 on I/O failure
+ */
+int journal_append_batch(Journal* j, const JournalEntry* entries, size_t n)
+{
+    if (!j->f) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (write_entry(j, entries[i].op, &entries[i].st) == -1) {
+            return -1;
+        }
+    }
+    return sync_by_policy(j);
+}
+
+/*
+ * journal_checkpoint:
+ * - Called once the database file itself is saved: every entry is now
+ *   part of the file, so the journal is truncated back to just its header,
+ *   which records the fingerprint of the newly saved file.
+ *
+ * Returns:
+ *   0  on success, -1 on I/O failure
+ */
+int journal_checkpoint(Journal* j)
+{
+    if (!j->f) {
+        return -1;
+    }
+    return write_header(j);
+}
+
+/*
+ * journal_close:
+ * - Syncs anything still pending and closes the file.
+ */
+void journal_close(Journal* j)
+{
+    if (j->f) {
+        if (j->unsynced) {
+            journal_sync(j);
+        }
+        fclose(j->f);
+        j->f = NULL;
+    }
+}
+
+/*
+ * last_entry:
+ * - Reads the entry that ends the file (found through its trailing size)
+ *   and checks it.
+ *
+ * Returns:
+ *   1 plus its sequence number, or 0 if it is torn or corrupt
+ */
+static uint64_t last_entry(FILE* f, size_t size)
+{
+    unsigned char tail[4];
+    if (size < JOURNAL_HEADER + ENTRY_MIN || fseek(f, (long)(size - 4), SEEK_SET) != 0 ||
+        fread(tail, 1, 4, f) != 4) {
+        return 0;
+    }
+    size_t n = get_le(tail, 4);
+    if (n < ENTRY_MIN || n > size - JOURNAL_HEADER) {
+        return 0;
+    }
+
+    unsigned char* e = malloc(n);
+    uint64_t seq = 0;
+    if (e && fseek(f, (long)(size - n), SEEK_SET) == 0 && fread(e, 1, n, f) == n &&
+        entry_ok(e, n)) {
+        seq = get_le(e + 8, 8) + 1;
+    }
+    free(e);
+    return seq;
+}
+
+/*
+ * count_entries:
+ * - Walks the journal from the start and counts the entries before the
+ *   first torn or corrupt one: what replay would apply.
+ */
+static uint64_t count_entries(const char* path)
+{
+    FileMap fm;
+    if (map_file(&fm, path) == -1) {
+        return 0;
+    }
+    const unsigned char* p = (const unsigned char*)fm.data;
+    uint64_t count = 0;
+    size_t off = JOURNAL_HEADER, n;
+    while (off < fm.size && (n = entry_ok(p + off, fm.size - off))) {
+        off += n;
+        count++;
+    }
+    unmap_file(&fm);
+    return count;
+}
+
+/*
+ * journal_probe:
+ * - Reads only the header and the last entry (located from the end of
+ *   the file), so with an intact tail it takes the same time however long
+ *   the journal or database is. Entries are numbered from 0, so the last
+ *   one's sequence number gives info->entries.
+ * - Only a torn or corrupt tail makes it walk the entries to count the
+ *   replayable ones; the entries themselves are checked one by one when
+ *   they are replayed.
+ *
+ * Returns:
+ *   0  if path is a journal of this version (info filled in)
+ *  -1  if it is missing or not one (info->valid = 0; info->version is set
+ *      if it is a journal of another version)
+ */
+int journal_probe(const char* path, JournalInfo* info)
+{
+    memset(info, 0, sizeof *info);
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    unsigned char buf[JOURNAL_HEADER];
+    size_t got = fread(buf, 1, sizeof buf, f);
+    long size = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+
+    if (got < JOURNAL_HEADER || size < 0 || memcmp(buf, JOURNAL_MAGIC, 4) != 0) {
+        fclose(f);
+        return -1;
+    }
+    info->version = (uint32_t)get_le(buf + 4, 4);
+    if (info->version != JOURNAL_VERSION) {
+        fclose(f);
+        return -1;
+    }
+
+    info->valid     = 1;
+    info->base_size = get_le(buf + 8, 8);
+    info->base_hash = get_le(buf + 16, 8);
+    if ((size_t)size > JOURNAL_HEADER) {
+        info->entries = last_entry(f, (size_t)size);
+        if (info->entries == 0) {
+            info->torn = 1;
+            info->entries = count_entries(path);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+/*
+ * journal_base_matches:
+ * - Checks that dbFile is still the file the journal was started against:
+ *   the size (a stat) is compared first, and the content hash only if the
+ *   sizes agree.
+ *
+ * Returns:
+ *   1  if it matches, 0 if the file changed behind the journal's back
+ */
+int journal_base_matches(const JournalInfo* info, const char* dbFile)
+{
+    struct stat sb;
+    uint64_t size = stat(dbFile, &sb) == 0 ? (uint64_t)sb.st_size : 0;
+    if (size != info->base_size) {
+        return 0;
+    }
+
+    uint64_t hash;
+    file_fingerprint(dbFile, &size, &hash);
+    return hash == info->base_hash;
+}
+
+/*
+ * remember_before:
+ * - The first time an ID is touched during replay, records what the list
+ *   held for it beforehand: the old record in changes->before, or just the
+ *   ID in changes->fresh if there was no such record.
+ */
+static int remember_before(JournalChanges* changes, LinkedList* list, int id)
+{
+    if (list_find_by_id(&changes->before, id) || list_find_by_id(&changes->fresh, id)) {
+        return 0;
+    }
+
+    Node* n = list_find_by_id(list, id);
+    if (n) {
+        Student old;
+        record_to_student(&old, &n->s);
+        return insert_node(&changes->before, &old) == -1 ? -1 : 0;
+    }
+    Student only_id = { .id = id, .name = "" };
+    return insert_node(&changes->fresh, &only_id) == -1 ? -1 : 0;
+}
+
+/*
+ * journal_replay:
+ * - Applies every valid entry in the journal at path to list, in order.
+ *   INSERT of an existing ID and UPDATE of a missing one are treated as
+ *   "make the record look like this", so replay is safe to repeat.
+ * - If changes is not NULL, the before-image of every touched ID is kept
+ *   there (see remember_before) so the caller can show a record-level diff
+ *   without a second copy of the database.
+ * - Stops at the first torn or corrupt entry and says how much was ignored.
+ * - An entry whose mark a record cannot hold (see mark_fits) stops the
+ *   replay, so the caller keeps the journal instead of saving without it.
+ *
+ * Returns:
+ *   0  on success (*applied = number of entries applied)
+ *  -1  if the journal could not be read, holds such a mark or an insert
+ *      failed (list then holds the entries applied so far)
+ */
+int journal_replay(const char* path, LinkedList* list, JournalChanges* changes, size_t* applied)
+{
+    FileMap fm;
+    *applied = 0;
+
+    if (map_file(&fm, path) == -1) {
+        perror("journal: open for replay");
+        return -1;
+    }
+
+    const unsigned char* p = (const unsigned char*)fm.data;
+    if (fm.size < JOURNAL_HEADER || memcmp(p, JOURNAL_MAGIC, 4) != 0 ||
+        get_le(p + 4, 4) != JOURNAL_VERSION) {
+        unmap_file(&fm);
+        fprintf(stderr, "journal: %s is not a journal file of this version.\n", path);
+        return -1;
+    }
+
+    size_t off = JOURNAL_HEADER, n;
+    for (; off < fm.size && (n = entry_ok(p + off, fm.size - off)); off += n) {
+        const unsigned char* e = p + off;
+        Student st;     // st.name points into the mapping
+        if (snapshot_decode_record(e + 16, n - ENTRY_FIXED, &st) != n - ENTRY_FIXED) {
+            break;
+        }
+
+        if (changes && remember_before(changes, list, st.id) == -1) {
+            unmap_file(&fm);
+            return -1;
+        }
+
+        Node* node = list_find_by_id(list, st.id);
+        switch (e[4]) {
+        case JOURNAL_INSERT:
+        case JOURNAL_UPDATE:
+        {
+            int rc = node ? list_update(list, node, &st) : insert_node(list, &st);
+            if (rc == -3) {
+                fprintf(stderr, "journal: mark %g of ID %d is outside 0 to %.2f, which a record can't hold.\n",
+                        st.mark, st.id, MARK_LIMIT);
+            }
+            if (rc != 0) {
+                unmap_file(&fm);
+                return -1;
+            }
+            break;
+        }
+        case JOURNAL_DELETE:
+            list_delete_by_id(list, st.id);
+            break;
+        }
+        (*applied)++;
+    }
+
+    if (off < fm.size) {
+        fprintf(stderr, "journal: ignoring %zu trailing byte(s) of a torn or corrupt entry.\n", fm.size - off);
+    }
+    unmap_file(&fm);
+    return 0;
+}
+
+/*
+ * journal_sync_from_env:
+ * - Reads the fsync policy from CMS_JOURNAL_SYNC ("always", "batch" or
+ *   "none"). Defaults to "always" so an edit is on disk once it is reported.
+ */
+JournalSync journal_sync_from_env(void)
+{
+    const char* v = getenv("CMS_JOURNAL_SYNC");
+    if (v && strcmp(v, "batch") == 0) {
+        return JOURNAL_FSYNC_BATCH;
+    }
+    if (v && strcmp(v, "none") == 0) {
+        return JOURNAL_FSYNC_NONE;
+    }
+    return JOURNAL_FSYNC_ALWAYS;
+}
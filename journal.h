@@ -0,0 +1,60 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "linked_list.h"
+
+typedef enum { //When appended entries are forced to disk
+    JOURNAL_FSYNC_ALWAYS,   // fsync after every entry
+    JOURNAL_FSYNC_BATCH,    // fsync every JOURNAL_BATCH entries (and on checkpoint/close)
+    JOURNAL_FSYNC_NONE      // leave it to the OS
+} JournalSync;
+
+typedef enum { //Kind of change an entry records
+    JOURNAL_INSERT = 1,
+    JOURNAL_UPDATE = 2,
+    JOURNAL_DELETE = 3
+} JournalOp;
+
+typedef struct { //One change waiting to be appended
+    JournalOp op;
+    Student st;             // only st.id is used for JOURNAL_DELETE
+} JournalEntry;
+
+typedef struct { //Append-only log of changes made since the last SAVE
+    FILE* f;
+    char path[256];
+    char db_path[256];      // database file the entries apply to
+    JournalSync sync;
+    unsigned unsynced;      // entries written since the last fsync
+    uint64_t seq;           // sequence number of the next entry
+} Journal;
+
+typedef struct { //What journal_probe learnt from the header and the last entry
+    uint32_t version;       // the header's version, 0 if the file is not a journal
+    int valid;              // the file is a journal of this version
+    uint64_t entries;       // complete entries after the header
+    int torn;               // trailing bytes that don't form a valid entry
+    uint64_t base_size;     // fingerprint of the database file the journal started from
+    uint64_t base_hash;
+} JournalInfo;
+
+typedef struct { //Before-images collected while replaying
+    LinkedList before;      // touched IDs that existed: their records before replay
+    LinkedList fresh;       // touched IDs that did not exist before (ID only)
+} JournalChanges;
+
+int journal_open(Journal* j, const char* path, const char* dbFile, JournalSync sync);
+int journal_append(Journal* j, JournalOp op, const Student* st);
+int journal_append_batch(Journal* j, const JournalEntry* entries, size_t n);
+int journal_sync(Journal* j);
+int journal_checkpoint(Journal* j);
+void journal_close(Journal* j);
+
+int journal_probe(const char* path, JournalInfo* info);
+int journal_base_matches(const JournalInfo* info, const char* dbFile);
+int journal_replay(const char* path, LinkedList* list, JournalChanges* changes, size_t* applied);
+JournalSync journal_sync_from_env(void);
+
+#endif
@@ -1,50 +1,323 @@
+
 #include "linked_list.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "parallel.h"
+#include "sorted_view.h"
+
+#define BULK_PARALLEL_MIN 65536   // below this a second thread costs more than it saves
+
+#define NAMES_COMPACT_MIN 65536   // dead name bytes tolerated before the arena is repacked
+
+/*
+ * mark_fits:
+ * - Whether a Record can hold mark: NaN, or 0 to MARK_LIMIT. insert_node
+ *   and list_update refuse anything else instead of storing a different
+ *   number, and the loaders report such records and skip them.
+ */
+int mark_fits(float mark) {
+    return mark != mark || (mark >= 0.0f && (double)mark * 100.0 < 65534.5);
+}
+
+/*
+ * to_hundredths:
+ * - mark rounded to hundredths, the precision SAVE writes. The mark must
+ *   pass mark_fits.
+ */
+static uint16_t to_hundredths(float mark) {
+    if (mark != mark) {
+        return MARK_NAN;
+    }
+    return (uint16_t)floor((double)mark * 100.0 + 0.5);
+}
+
+/*
+ * record_mark:
+ * - The mark as a float, equal to what strtof gives for the "%.2f" text
+ *   SAVE writes, so a mark survives a save and reload unchanged.
+ */
+float record_mark(const Record* r) {
+    return r->hundredths == MARK_NAN ? NAN : (float)(r->hundredths / 100.0);
+}
+
+const char* record_programme(const Record* r) {
+    return programme_name(r->programme);
+}
+
+/*
+ * record_key:
+ * - Fills *r from *st for comparing against stored records (a sorted view
+ *   lookup, say) without storing anything: the name points into st.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if the programme could not be interned (out of memory), or the
+ *      mark does not fit (no stored record can have it)
+ */
+int record_key(Record* r, const Student* st) {
+    if (!mark_fits(st->mark)) {
+        return -1;
+    }
+    r->programme = programme_id(st->programme);
+    if (r->programme == PROGRAMME_NONE) {
+        return -1;
+    }
+    r->name = st->name;
+    r->id = st->id;
+    r->hundredths = to_hundredths(st->mark);
+    r->seq = 0;             // a Student has no place in the list; callers set it if they need it
+    return 0;
+}
+
+/*
+ * record_to_student:
+ * - The other way round: a standalone Student (for the journal, snapshots
+ *   and edits) from a stored Record. st->name points at the record's own
+ *   name, so it is only good until the list next deletes or renames a
+ *   record (either can move every name, see compact_names).
+ */
+void record_to_student(Student* st, const Record* r) {
+    st->id = r->id;
+    st->name = r->name;
+    strncpy(st->programme, programme_name(r->programme), MAX_PROGRAM - 1);
+    st->programme[MAX_PROGRAM - 1] = '\0';
+    st->mark = record_mark(r);
+}
+
+/*
+ * store_record:
+ * - record_key, but with the name copied into the list's name arena.
+ */
+static int store_record(LinkedList* L, Record* r, const Student* st) {
+    if (record_key(r, st) == -1 || !(r->name = arena_store(&L->names, st->name))) {
+        return -1;
+    }
+    return 0;
+}
 
 /*
  * create_node:
- * - Small helper that allocates a new Node on the heap.
- * - Copies the Student data from *st into the node.
- * - Sets next to NULL so the caller can link it properly.
+ * - Small helper that takes a new Node from the list's slab pool, and
+ *   makes sure both trees have a link for its slot.
+ * - Copies the Student data from *st into the node as a Record: the name
+ *   goes into the list's arena, the programme becomes its ProgrammeId and
+ *   the mark is kept in hundredths.
+ * - Sets next to POOL_NIL so the caller can link it properly.
  *
  * Returns:
  *   pointer to the new Node on success
- *   NULL if malloc fails
+ *   NULL if memory ran out
  */
-Node* create_node(const Student* st) {
-    Node* newNode = (Node*)malloc(sizeof * newNode);
-    if (!newNode) {
+Node* create_node(LinkedList* L, const Student* st) {
+    uint32_t slot = pool_alloc(&L->pool);
+    if (slot == POOL_NIL) {
         // If I can't allocate memory, I just return NULL and let the caller handle it
         return 0;
     }
 
-    newNode->s    = *st;   // copy the whole Student struct by value
-    newNode->next = NULL;  // new node is not linked to anything yet
+    Node* newNode = POOL_NODE(&L->pool, slot);
+    if (tree_reserve(&L->by_mark, slot) == -1 || tree_reserve(&L->by_name, slot) == -1 ||
+        store_record(L, &newNode->s, st) == -1) {
+        pool_free(&L->pool, slot);
+        return 0;
+    }
+    newNode->s.seq = L->next_seq++;
+    newNode->slot = slot;
+    newNode->next = POOL_NIL;  // new node is not linked to anything yet
+    newNode->prev = POOL_NIL;
+    newNode->group_next = newNode->group_prev = POOL_NIL;
 
     return newNode;
 }
 
+/*
+ * list_node:
+ * - The node in one of L's pool slots, as found in head, tail, the links
+ *   between nodes and the trees.
+ *
+ * Returns:
+ *   the node, or NULL for POOL_NIL
+ */
+Node* list_node(const LinkedList* L, uint32_t slot) {
+    return slot == POOL_NIL ? NULL : POOL_NODE(&L->pool, slot);
+}
+
+// Gives back a node that create_node made, name included
+static void destroy_node(LinkedList* L, Node* n) {
+    arena_release(&L->names, n->s.name);
+    pool_free(&L->pool, n->slot);
+}
+
+// The programme group n is a member of
+static ProgrammeGroup* group_of(const LinkedList* L, const Node* n) {
+    return programme_find(&L->programmes, programme_key(n->s.programme));
+}
+
+/*
+ * compact_names:
+ * - Once more bytes of the name arena belong to deleted or renamed
+ *   students than to current ones, copies the current names into one
+ *   fresh block and frees the old ones. Name pointers taken before this
+ *   are invalid afterwards, so it only runs at the end of a delete or an
+ *   update. If the new block can't be had, the old arena simply stays.
+ */
+static void compact_names(LinkedList* L) {
+    if (L->names.dead < NAMES_COMPACT_MIN || L->names.dead < L->names.live) {
+        return;
+    }
+    NameArena fresh;
+    arena_init(&fresh);
+    if (arena_reserve(&fresh, L->names.live) == -1) {
+        return;
+    }
+    for (Node* n = list_node(L, L->head); n; n = list_node(L, n->next)) {
+        n->s.name = arena_store(&fresh, n->s.name);    // cannot fail: reserved
+    }
+    arena_free(&L->names);
+    L->names = fresh;
+}
+
+/*
+ * mark_order:
+ * - Compares two marks like strcmp, with NaN after every number so the
+ *   mark index always has a total order.
+ */
+int mark_order(float a, float b) {
+    if (a != a || b != b) {
+        return (a != a) - (b != b);
+    }
+    return (a > b) - (a < b);
+}
+
+// (mark, id) order of the by_mark tree; the id makes every key unique
+static int by_mark_cmp(const void* ctx, uint32_t a, uint32_t b) {
+    const Record* x = &list_node(ctx, a)->s;
+    const Record* y = &list_node(ctx, b)->s;
+    if (x->hundredths != y->hundredths) {
+        return x->hundredths > y->hundredths ? 1 : -1;   // MARK_NAN sorts last, like mark_order
+    }
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+/*
+ * name_order:
+ * - Compares two names like strcmp but ignoring case, the order of the
+ *   name index.
+ */
+int name_order(const char* a, const char* b) {
+    for (;; a++, b++) {
+        int x = tolower((unsigned char)*a), y = tolower((unsigned char)*b);
+        if (x != y || x == 0) {
+            return (x > y) - (x < y);
+        }
+    }
+}
+
+// (name, id) order of the by_name tree
+static int record_name_cmp(const Record* x, const Record* y) {
+    int r = name_order(x->name, y->name);
+    return r ? r : (x->id > y->id) - (x->id < y->id);
+}
+
+static int by_name_cmp(const void* ctx, uint32_t a, uint32_t b) {
+    return record_name_cmp(&list_node(ctx, a)->s, &list_node(ctx, b)->s);
+}
+
+/*
+ * tally:
+ * - Adds (sign = 1) or takes back (sign = -1) one mark in the running
+ *   aggregates. A float converted to double is exact, and realistic marks
+ *   sum without rounding, so the total does not drift over many updates.
+ * - NaN marks are only counted: once in the sum they could never be taken
+ *   out again. (A Record can't hold an infinite mark; see mark_fits.)
+ */
+static void tally(LinkedList* L, float mark, int sign) {
+    if (mark == mark) {
+        L->mark_sum += sign * (double)mark;
+    } else if (sign > 0) {
+        L->odd_marks++;
+    } else {
+        L->odd_marks--;
+    }
+}
+
+/*
+ * renumber:
+ * - Gives the nodes fresh seq numbers 0, 1, ... in list order. Only needed
+ *   when L->next_seq is about to wrap; views ordered by seq are dropped.
+ */
+static void renumber(LinkedList* L) {
+    uint32_t seq = 0;
+    for (Node* n = list_node(L, L->head); n; n = list_node(L, n->next)) {
+        n->s.seq = seq++;
+    }
+    L->next_seq = seq;
+    views_free(L);
+}
+
 /*
  * insert_node:
  * - Inserts a new Student at the end of the linked list.
  * - Uses create_node() to allocate and set up the node.
+ * - Registers the node in the id index, so duplicate IDs are refused here
+ *   in O(1) instead of every caller scanning the list first.
+ * - Appends a row for it to the mark/id columns, adds it to its
+ *   programme's group, the mark and name trees and any cached sorted
+ *   views, and counts its mark in the running sum.
  * - Updates both head and tail pointers when needed.
  *
  * Returns:
  *   0  on success
  *  -1  if allocation failed
+ *  -2  if a student with the same ID is already in the list
+ *  -3  if the mark cannot be stored (see mark_fits)
  */
 int insert_node(LinkedList* L, const Student* st) {
-    Node* newNode = create_node(st);
+    if (!mark_fits(st->mark)) {
+        return -3;
+    }
+    if (L->next_seq == UINT32_MAX) {
+        renumber(L);
+    }
+    Node* newNode = create_node(L, st);
     if (!newNode) {
         return -1;                    // allocation failed
     }
 
-    if (!L->head) {                   // empty list: head and tail become newNode
-        L->head = L->tail = newNode;
+    ProgrammeGroup* group = programme_intern(&L->programmes, newNode->s.programme);
+    if (!group) {
+        destroy_node(L, newNode);
+        return -1;
+    }
+
+    int rc = index_insert(&L->index, &L->pool, newNode);
+    if (rc != 0) {
+        destroy_node(L, newNode);
+        return rc == 1 ? -2 : -1;     // duplicate ID / index could not grow
+    }
+
+    if (column_append(&L->cols, newNode) == -1) {
+        index_remove(&L->index, &L->pool, st->id);
+        destroy_node(L, newNode);
+        return -1;
+    }
+
+    if (L->head == POOL_NIL) {        // empty list: head and tail become newNode
+        L->head = L->tail = newNode->slot;
     } else {                          // non-empty list: append to current tail
-        L->tail->next = newNode;
-        L->tail       = newNode;
+        newNode->prev = L->tail;
+        POOL_NODE(&L->pool, L->tail)->next = newNode->slot;
+        L->tail = newNode->slot;
+    }
+    group_append(group, &L->pool, newNode);
+    tally(L, record_mark(&newNode->s), 1);
+    views_inserted(L, newNode);
+    if (!L->bulk) {
+        tree_insert(&L->by_mark, newNode->slot);
+        tree_insert(&L->by_name, newNode->slot);
     }
     return 0;                         // success
 }
@@ -52,81 +325,450 @@ int insert_node(LinkedList* L, const Student* st) {
 /*
  * list_init:
  * - Simple initialiser for a LinkedList.
- * - Sets both head and tail to NULL so the list starts off empty.
+ * - Sets both head and tail to POOL_NIL so the list starts off empty.
+ * - The trees keep a pointer to L for their comparisons, so the list must
+ *   not be copied or moved afterwards.
  */
 void list_init(LinkedList* L) {
-    L->head = L->tail = NULL;
+    L->head = L->tail = POOL_NIL;
+    index_init(&L->index);
+    pool_init(&L->pool);
+    column_init(&L->cols);
+    arena_init(&L->names);
+    programme_index_init(&L->programmes);
+    tree_init(&L->by_mark, by_mark_cmp, L);
+    tree_init(&L->by_name, by_name_cmp, L);
+    L->bulk = 0;
+    L->mark_sum = 0.0;
+    L->odd_marks = 0;
+    L->next_seq = 0;
+    L->views = NULL;
 }
 
 /*
  * list_clear:
- * - Walks through the entire list and frees every node.
- * - At the end, both head and tail are set to NULL.
+ * - Releases every node in one go by handing the pool's blocks back,
+ *   instead of freeing the nodes one at a time.
+ * - Drops the id index, the columns, the name arena, the programme groups,
+ *   the mark and name trees and the cached sorted views as well, and
+ *   zeroes the running sum.
+ * - At the end, both head and tail are set to POOL_NIL.
  *
  * I use this to clean up when the program exits or when switching files.
  */
 void list_clear(LinkedList* L) {
-    for (Node* p = L->head; p;) {
-        Node* n = p->next;  // remember next before freeing
-        free(p);
-        p = n;
-    }
-    L->head = L->tail = NULL;
+    views_free(L);
+    pool_release(&L->pool);
+    L->head = L->tail = POOL_NIL;
+    index_free(&L->index);
+    column_free(&L->cols);
+    arena_free(&L->names);
+    programme_index_free(&L->programmes);
+    tree_free(&L->by_mark);
+    tree_free(&L->by_name);
+    L->mark_sum = 0.0;
+    L->odd_marks = 0;
+    L->next_seq = 0;
 }
 
 /*
  * list_find_by_id:
- * - Linearly searches the list for the first node whose Student.id matches
- *   the given id.
+ * - Looks the id up in the hash index, so the cost does not depend on
+ *   how many students are in the list.
  *
  * Returns:
  *   pointer to the matching Node
  *   NULL if no such node exists
  */
 Node* list_find_by_id(LinkedList* L, int id) {
-    for (Node* p = L->head; p; p = p->next) {
-        if (p->s.id == id) {
-            return p;
-        }
-    }
-    return NULL;
+    return index_find(&L->index, &L->pool, id);
 }
 
 /*
  * list_delete_by_id:
- * - Removes the first node in the list whose Student.id matches id.
- * - Relinks the previous node to skip over the deleted one.
- * - If the deleted node was the head, updates head accordingly.
- * - Frees the memory of the deleted node.
+ * - Finds the node through the id index and unlinks it using its prev/next
+ *   pointers, so no walk from the head is needed.
+ * - Keeps head and tail correct when the first or last node is removed.
+ * - Takes it out of the id index, the columns, its programme group, the
+ *   trees and the sorted views.
+ * - Returns the node to the pool so the next insert can reuse it, and its
+ *   name to the arena.
  *
  * Returns:
  *   1  if a node was found and deleted
  *   0  if no node with that id exists in the list
  */
 int list_delete_by_id(LinkedList* L, int id) {
-    Node* prev = NULL;
-    Node* cur  = L->head;
-
-    while (cur) {
-        if (cur->s.id == id) {
-            // If we're not at the head, bypass the current node
-            if (prev) {
-                prev->next = cur->next;
-            }
-            else {
-                // If we are deleting the head, move head forward
-                L->head = cur->next;
-            }
-
-            // Note: In my current use cases, I don't rely heavily on tail here.
-            // If I delete the last node, tail might become stale, but it's not
-            // causing an issue for the way I'm iterating over the list.
-
-            free(cur);
-            return 1;
+    Node* cur = index_find(&L->index, &L->pool, id);
+    if (!cur) {
+        return 0;  // id is not in the list
+    }
+
+    if (cur->prev != POOL_NIL) {
+        POOL_NODE(&L->pool, cur->prev)->next = cur->next;
+    } else {
+        L->head = cur->next;   // deleting the head, move head forward
+    }
+
+    if (cur->next != POOL_NIL) {
+        POOL_NODE(&L->pool, cur->next)->prev = cur->prev;
+    } else {
+        L->tail = cur->prev;   // deleting the tail, move tail back
+    }
+
+    views_removing(L, cur);
+    index_remove(&L->index, &L->pool, id);
+    column_remove(&L->cols, &L->pool, cur->row);
+    group_unlink(group_of(L, cur), &L->pool, cur);
+    tally(L, record_mark(&cur->s), -1);
+    if (!L->bulk) {
+        tree_remove(&L->by_mark, cur->slot);
+        tree_remove(&L->by_name, cur->slot);
+    }
+    destroy_node(L, cur);
+    compact_names(L);
+    return 1;
+}
+
+/*
+ * list_update:
+ * - Overwrites the Student stored in n with *st.
+ * - The ID is the index key and must not change; name, programme and mark
+ *   may. Going through here keeps the columns, the programme groups, the
+ *   mark and name trees, the sorted views and the running sum in step
+ *   with the node.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if memory ran out (n is unchanged)
+ *  -3  if the mark cannot be stored (see mark_fits; n is unchanged)
+ */
+int list_update(LinkedList* L, Node* n, const Student* st) {
+    if (!mark_fits(st->mark)) {
+        return -3;
+    }
+    Record rec;
+    if (record_key(&rec, st) == -1) {
+        return -1;
+    }
+    rec.seq = n->s.seq;
+    ProgrammeGroup* old_group = group_of(L, n);
+    ProgrammeGroup* group = old_group;
+    if (rec.programme != n->s.programme) {
+        group = programme_intern(&L->programmes, rec.programme);
+        if (!group) {
+            return -1;
+        }
+    }
+    const char* old_name = n->s.name;
+    int renamed = strcmp(old_name, st->name) != 0;
+    rec.name = renamed ? arena_store(&L->names, st->name) : old_name;
+    if (!rec.name) {
+        return -1;
+    }
+
+    int mark_moved = !L->bulk && rec.hundredths != n->s.hundredths;
+    int name_moved = !L->bulk && name_order(old_name, rec.name) != 0;
+    if (mark_moved) {
+        tree_remove(&L->by_mark, n->slot);
+    }
+    if (name_moved) {
+        tree_remove(&L->by_name, n->slot);
+    }
+
+    tally(L, record_mark(&n->s), -1);
+    tally(L, record_mark(&rec), 1);
+    views_updating(L, n, &rec);
+    n->s = rec;
+    L->cols.marks[n->row] = record_mark(&rec);
+    if (mark_moved) {
+        tree_insert(&L->by_mark, n->slot);
+    }
+    if (name_moved) {
+        tree_insert(&L->by_name, n->slot);
+    }
+    if (group != old_group) {
+        group_unlink(old_group, &L->pool, n);
+        group_append(group, &L->pool, n);
+    }
+    if (renamed) {
+        arena_release(&L->names, old_name);
+        compact_names(L);
+    }
+    return 0;
+}
+
+/*
+ * list_programme:
+ * - Looks up the group of students taking programme (case is ignored), so
+ *   a per-programme scan only visits that programme's members.
+ *
+ * Returns:
+ *   the group, or NULL if no student has ever had that programme
+ */
+ProgrammeGroup* list_programme(LinkedList* L, const char* programme) {
+    ProgrammeId key = programme_lookup(programme);
+    return key == PROGRAMME_NONE ? NULL : programme_find(&L->programmes, key);
+}
+
+static int is_number(const void* ctx, uint32_t x, const void* key) {
+    (void)key;
+    return list_node(ctx, x)->s.hundredths != MARK_NAN;
+}
+
+static int mark_before(const void* ctx, uint32_t x, const void* key) {
+    return list_node(ctx, x)->s.hundredths < *(const uint16_t*)key;
+}
+
+/*
+ * list_numeric_marks:
+ * - How many students have a numeric mark. NaN marks sort last in the mark
+ *   tree, so these are its first positions.
+ * - Not valid between list_begin_bulk and list_end_bulk.
+ */
+size_t list_numeric_marks(const LinkedList* L) {
+    return tree_count_before(&L->by_mark, is_number, NULL);
+}
+
+/*
+ * list_lowest / list_highest:
+ * - The student with the lowest / highest mark, read off the ends of the
+ *   mark tree in O(log n), so deleting or lowering the current extreme
+ *   never needs a rescan. Ties go to the smallest ID; NaN marks are skipped.
+ * - Not valid between list_begin_bulk and list_end_bulk.
+ *
+ * Returns:
+ *   the node, or NULL if the list has no numeric mark
+ */
+Node* list_lowest(const LinkedList* L) {
+    uint32_t x = tree_at(&L->by_mark, 0);
+    return (x != TREE_NIL && is_number(L, x, NULL)) ? list_node(L, x) : NULL;
+}
+
+Node* list_highest(const LinkedList* L) {
+    size_t k = list_numeric_marks(L);
+    if (k == 0) {
+        return NULL;
+    }
+    uint16_t top = list_node(L, tree_at(&L->by_mark, k - 1))->s.hundredths;
+    return list_node(L, tree_lower_bound(&L->by_mark, mark_before, &top));
+}
+
+/* ----- Bulk loading ----- */
+
+typedef struct { //A node and a 64-bit key that sorts like the tree's order
+    uint64_t key;
+    const Node* node;
+} SortItem;
+
+/*
+ * mark_key:
+ * - Packs (mark, id) into one integer with the same order as by_mark_cmp:
+ *   the hundredths (NaN is already above every number), then the id with
+ *   its sign bit flipped so it compares as unsigned.
+ */
+static uint64_t mark_key(const Record* s) {
+    return ((uint64_t)s->hundredths << 32) | ((uint32_t)s->id ^ 0x80000000u);
+}
+
+/*
+ * name_key:
+ * - The first 8 characters of the name, lower-cased, big-endian. Equal
+ *   keys still need name_order and the id to break the tie.
+ */
+static uint64_t name_key(const Record* s) {
+    uint64_t k = 0;
+    int i = 0;
+    for (; i < 8 && s->name[i]; i++) {
+        k = (k << 8) | (unsigned char)tolower((unsigned char)s->name[i]);
+    }
+    return k << (8 * (8 - i));
+}
+
+static int cmp_mark_items(const void* a, const void* b) {
+    uint64_t x = ((const SortItem*)a)->key, y = ((const SortItem*)b)->key;
+    return (x > y) - (x < y);
+}
+
+static int cmp_name_items(const void* a, const void* b) {
+    const SortItem* x = a;
+    const SortItem* y = b;
+    if (x->key != y->key) {
+        return (x->key > y->key) - (x->key < y->key);
+    }
+    return record_name_cmp(&x->node->s, &y->node->s);
+}
+
+typedef struct { //One ordered index to rebuild in list_end_bulk
+    OrderTree* tree;
+    uint64_t (*key)(const Record*);
+    int (*order)(const void*, const void*);
+    const LinkedList* list;
+    size_t n;
+} BulkTree;
+
+/*
+ * rebuild_tree:
+ * - parallel_run worker: sorts every node on one tree's order and has
+ *   tree_build link them in one pass. If the sort buffers can't be
+ *   allocated the nodes are inserted one by one instead, so the tree
+ *   always ends up complete.
+ */
+static void rebuild_tree(void* ctx, int worker) {
+    BulkTree* b = (BulkTree*)ctx + worker;
+    const LinkedList* L = b->list;
+
+    SortItem* sorted = malloc((b->n ? b->n : 1) * sizeof *sorted);
+    uint32_t* slots = malloc((b->n ? b->n : 1) * sizeof *slots);
+    if (!sorted || !slots) {
+        free(sorted);
+        free(slots);
+        tree_clear(b->tree);
+        for (const Node* cur = list_node(L, L->head); cur; cur = list_node(L, cur->next)) {
+            tree_insert(b->tree, cur->slot);
+        }
+        return;
+    }
+
+    size_t i = 0;
+    for (const Node* cur = list_node(L, L->head); cur; cur = list_node(L, cur->next)) {
+        sorted[i].key  = b->key(&cur->s);
+        sorted[i].node = cur;
+        i++;
+    }
+    qsort(sorted, b->n, sizeof *sorted, b->order);
+    for (i = 0; i < b->n; i++) {
+        slots[i] = sorted[i].node->slot;
+    }
+    free(sorted);
+    tree_build(b->tree, slots, b->n);
+    free(slots);
+}
+
+/*
+ * list_begin_bulk:
+ * - For loaders that insert many nodes in a row: insert_node stops
+ *   maintaining the mark and name trees one node at a time, which would
+ *   cost a cache-missing O(log n) descent per row and tree.
+ */
+void list_begin_bulk(LinkedList* L) {
+    L->bulk = 1;
+}
+
+/*
+ * list_end_bulk:
+ * - Rebuilds both trees from every node: one sort each, then a linear
+ *   build. The two trees are independent, so they are rebuilt on two
+ *   threads.
+ *
+ * Returns:
+ *   0  (a failed allocation falls back to inserting one by one)
+ */
+int list_end_bulk(LinkedList* L) {
+    size_t n = L->cols.len;
+    L->bulk = 0;
+
+    BulkTree trees[2] = {
+        { &L->by_mark, mark_key, cmp_mark_items, L, n },
+        { &L->by_name, name_key, cmp_name_items, L, n },
+    };
+    parallel_run(n >= BULK_PARALLEL_MIN ? 2 : 1, rebuild_tree, trees);
+    if (n < BULK_PARALLEL_MIN) {
+        rebuild_tree(trees, 1);
+    }
+    return 0;
+}
+
+/* ----- Sorting ----- */
+
+static int cmp_id(const Record* a, const Record* b) {
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+static int cmp_name(const Record* a, const Record* b) {
+    return strcmp(a->name, b->name);
+}
+
+static int cmp_programme(const Record* a, const Record* b) {
+    if (a->programme == b->programme) {
+        return 0;       // same interned spelling: no need to look at the text
+    }
+    return strcmp(programme_name(a->programme), programme_name(b->programme));
+}
+
+static int cmp_mark(const Record* a, const Record* b) {
+    return (a->hundredths > b->hundredths) - (a->hundredths < b->hundredths);
+}
+
+static int cmp_seq(const Record* a, const Record* b) {
+    return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+/*
+ * comparator_init:
+ * - Looks up the key functions once, so comparisons don't switch on the
+ *   key every time.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if no keys, too many, or an unknown key was given
+ */
+int comparator_init(Comparator* c, const SortSpec* keys, size_t nkeys) {
+    static const RecordCmp by_key[] = { cmp_id, cmp_name, cmp_programme, cmp_mark, cmp_seq };
+
+    if (nkeys == 0 || nkeys > SORT_MAX_KEYS) {
+        return -1;
+    }
+    c->n = nkeys;
+    for (size_t k = 0; k < nkeys; k++) {
+        if ((unsigned)keys[k].key > SORT_BY_LIST_ORDER) {
+            return -1;
+        }
+        c->fn[k]   = by_key[keys[k].key];
+        c->sign[k] = keys[k].ascending ? 1 : -1;
+    }
+    return 0;
+}
+
+/*
+ * comparator_break_ties:
+ * - Adds the ID as a last key, in the direction of the last key given,
+ *   which makes the order total: no two students compare equal.
+ */
+void comparator_break_ties(Comparator* c) {
+    c->fn[c->n]   = cmp_id;
+    c->sign[c->n] = c->sign[c->n - 1];
+    c->n++;
+}
+
+int compare_records(const Comparator* c, const Record* a, const Record* b) {
+    for (size_t k = 0; k < c->n; k++) {
+        int r = c->fn[k](a, b);
+        if (r) {
+            return r * c->sign[k];
+        }
+    }
+    return 0;
+}
+
+/*
+ * list_footprint:
+ * - Bytes of memory the list holds: node pages, names, the id index, the
+ *   columns, the two trees' links, the programme groups and the cached
+ *   views. malloc's own bookkeeping is not counted.
+ */
+size_t list_footprint(const LinkedList* L) {
+    size_t bytes = pool_bytes(&L->pool) + L->names.reserved;
+    bytes += L->index.cap * sizeof *L->index.slots;
+    bytes += L->cols.cap * (sizeof *L->cols.marks + sizeof *L->cols.ids + sizeof *L->cols.slots);
+    bytes += tree_bytes(&L->by_mark) + tree_bytes(&L->by_name);
+    bytes += L->programmes.cap * sizeof *L->programmes.slots;
+    bytes += L->programmes.count * sizeof(ProgrammeGroup);
+    if (L->views) {
+        bytes += sizeof *L->views;
+        for (size_t i = 0; i < VIEW_CACHE_SIZE; i++) {
+            bytes += L->views->views[i].cap * sizeof(Node*);
         }
-        prev = cur;
-        cur  = cur->next;
     }
-    return 0;  // reached end of list without finding the id
+    return bytes;
 }
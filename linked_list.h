@@ -2,45 +2,114 @@
 #define LINKEDLIST_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include "hash_index.h"
+#include "node_pool.h"
+#include "mark_column.h"
+#include "programme_index.h"
+#include "order_tree.h"
+#include "programme_table.h"
+#include "name_arena.h"
+
+struct ViewCache;
 
 
-#define MAX_NAME 50
 #define MAX_PROGRAM 50
 #define MAX_STUDENTS 100
 
 typedef struct { //Student Structure
     int id;
-    char name[MAX_NAME];
+    const char* name;       // any length; not owned: whoever fills the Student keeps the text alive
     char programme[MAX_PROGRAM];
     float mark;
 } Student;
 
-typedef struct Node { //Student Node
-    Student s;
-    struct Node* next;
+#define MARK_NAN 0xFFFFu         // Record.hundredths of a NaN mark
+#define MARK_LIMIT 655.34f        // highest mark a Record can hold
+
+typedef struct { //A Student as a Node stores it: 24 bytes, the name in LinkedList.names
+    const char* name;           // in the list's name arena, any length
+    int id;
+    ProgrammeId programme;      // see programme_table.h; record_programme gives the text
+    uint16_t hundredths;        // mark * 100 (what SAVE's %.2f writes); read it with record_mark
+    uint32_t seq;               // when it was added: increases along the list, so it is the list order
+} Record;
+
+typedef struct Node { //Student Node: 48 bytes on 64-bit targets; links are pool slots, POOL_NIL for none
+    Record s;
+    uint32_t slot;                  // this node's own slot in LinkedList.pool, and its member number in the trees
+    uint32_t next;
+    uint32_t prev;      // lets list_delete_by_id unlink without walking from head
+    uint32_t group_next;            // next/previous member of the same programme (LinkedList.programmes)
+    uint32_t group_prev;
+    uint32_t row;                   // this node's row in LinkedList.cols
 } Node;
 
-typedef struct { //LinkedList structure
-    Node* head;
-    Node* tail;
+typedef struct { //LinkedList structure; must stay where list_init put it (the trees point back at it)
+    uint32_t head;      // pool slots; list_node turns them into nodes
+    uint32_t tail;
+    IdIndex index;      // id -> node, kept in sync by every list function below
+    NodePool pool;      // owns the memory of every node in the list
+    MarkColumn cols;    // contiguous ids/marks for scans such as SUMMARY
+    NameArena names;    // every node's name
+    ProgrammeIndex programmes;  // programme key -> member nodes, for QUERY PROGRAMME= and SUMMARY BY PROGRAMME
+    OrderTree by_mark;          // node slots ordered by (mark, id), for ranges, TOP/BOTTOM and RANK
+    OrderTree by_name;          // node slots ordered by (name ignoring case, id), for name prefix search
+    int bulk;                   // inside list_begin_bulk: the trees are rebuilt at the end
+    double mark_sum;            // running sum of every numeric mark, for SUMMARY
+    size_t odd_marks;           // NaN marks, left out of mark_sum
+    uint32_t next_seq;          // Record.seq of the next node added
+    struct ViewCache* views;    // cached sort orders for SHOW ALL (sorted_view.c), NULL until needed
 } LinkedList;
 
-//typedef enum { //Sorting Enumerate
-//    SORT_BY_ID,
-//    SORT_BY_NAME,
-//    SORT_BY_PROGRAMME,
-//    SORT_BY_MARK
-//} SortKey;
-//
-//int accending: 1 = ascending, 0 = descending
+typedef enum { //Sorting Enumerate
+    SORT_BY_ID,
+    SORT_BY_NAME,
+    SORT_BY_PROGRAMME,
+    SORT_BY_MARK,
+    SORT_BY_LIST_ORDER          // Record.seq: not a SORT= field, the order unsorted pages walk
+} SortKey;
+
+#define SORT_MAX_KEYS 4
+
+typedef struct { //One sort key and its direction
+    SortKey key;
+    int ascending;      // 1 = ascending, 0 = descending
+} SortSpec;
+
+typedef int (*RecordCmp)(const Record* a, const Record* b);
+
+typedef struct { //Comparator resolved once before sorting starts
+    RecordCmp fn[SORT_MAX_KEYS + 1];   // + 1 for the ID that comparator_break_ties adds
+    int sign[SORT_MAX_KEYS + 1];        // +1 ascending, -1 descending
+    size_t n;
+} Comparator;
 
-Node* create_node(const Student* st);
+int mark_fits(float mark);
+float record_mark(const Record* r);
+const char* record_programme(const Record* r);
+int record_key(Record* r, const Student* st);
+void record_to_student(Student* st, const Record* r);
+Node* create_node(LinkedList* L, const Student* st);
+Node* list_node(const LinkedList* L, uint32_t slot);
 void list_init(LinkedList* L);
 void list_clear(LinkedList* L);
 int insert_node(LinkedList* L, const Student* st);
 Node* list_find_by_id(LinkedList* L, int id);
 int list_delete_by_id(LinkedList* L, int id);
-//void list_sort(LinkedList* L, SortKey key, int ascending, const Student* st);
+int list_update(LinkedList* L, Node* n, const Student* st);
+ProgrammeGroup* list_programme(LinkedList* L, const char* programme);
+int mark_order(float a, float b);
+int name_order(const char* a, const char* b);
+void list_begin_bulk(LinkedList* L);
+int list_end_bulk(LinkedList* L);
+size_t list_numeric_marks(const LinkedList* L);
+Node* list_lowest(const LinkedList* L);
+Node* list_highest(const LinkedList* L);
+int comparator_init(Comparator* c, const SortSpec* keys, size_t nkeys);
+void comparator_break_ties(Comparator* c);
+int compare_records(const Comparator* c, const Record* a, const Record* b);
+size_t list_footprint(const LinkedList* L);
 
 #endif
 
@@ -1,316 +1,884 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include "commands.h"
 #include "operations.h"
 #include "linked_list.h"
-
-int main(void)
+#include "journal.h"
+#include "autosave.h"
+#include "stats.h"
+#include "shards.h"
+
+#define DB_FILE      "P3_1-CMS.txt"
+#define JOURNAL_FILE "autosave.journal"
+
+#define COMMANDS_HELP "Commands: OPEN [<name>=<file> ...] | SHOW ALL [SORT=<field> [ASC|DESC]] [LIMIT <n> [OFFSET <m>]] | NEXT | SUMMARY [BY PROGRAMME] | INSERT [<id>|<name>|<programme>|<mark>] | QUERY ID=<id> | QUERY NAME=<prefix>* | QUERY PROGRAMME=<name> | QUERY MARK>=<a> AND MARK<<b> | TOP <k> | BOTTOM <k> | RANK ID=<id> | UPDATE ID=<id> [NAME=..|PROGRAMME=..|MARK=..] | DELETE ID=<id> [FORCE] | IMPORT <file> | CONVERT <src> <dst> | STATS | EXIT | SAVE | HELP"
+
+/*
+ * prompt_sort_key:
+ * Asks which field to sort by (ID, NAME, PROGRAMME or MARK) and in which
+ * direction. When optional is set, an empty answer skips the key.
+ *
+ * Returns:
+ *   1  if *spec was filled in
+ *   0  if the user skipped the optional key
+ */
+static int prompt_sort_key(SortSpec *spec, int optional)
 {
-    // This linked list will store all the student records in memory
-    LinkedList studentData;
-    studentData.head = NULL;
-    studentData.tail = NULL;
-
-    char command[256];      // buffer to store user command input
-    int fileopened = 0;     // flag to track whether the main DB file has been opened
-
-    /*
-     * On startup, I check if there are any changes to recover by comparing
-     * the main DB file (P3_1-CMS.txt) with the autosave file (autosave.txt).
-     * If they differ, I give the user a chance to restore the autosaved state.
-     */
-    if (recoverChanges("P3_1-CMS.txt", "autosave.txt"))
-    {
-        char choice[10];
-
-        puts("CMS: There are changes to recover.");
-
-        // First, open and show the original DB file so the user can see the baseline
-        opendb(&studentData, "P3_1-CMS.txt", fileopened);
-        fileopened = 1;
-        puts("CMS: This is the current database state:");
-        show_all_cmd(&studentData, fileopened);
-
-        // Clear the list and then open the autosave version to show the "altered" state
-        list_clear(&studentData);
-        fileopened = 0;
-        opendb(&studentData, "autosave.txt", fileopened);
-        fileopened = 1;
-        puts("\nCMS: This is the altered database:");
-        show_all_cmd(&studentData, fileopened);
-
-        // Ask user if they want to recover the autosaved changes
-        printf("Would you like to recover the changes? (Y/N): ");
-
-        while (1)
-        {
-            if (!fgets(choice, sizeof(choice), stdin)) 
-                continue;
+    char choice[16];
 
-            choice[strcspn(choice, "\n")] = '\0';
+    while (1) {
+        if (optional)
+            printf("Secondary sort key? Enter ID, NAME, PROGRAMME or MARK (or press Enter to skip): ");
+        else
+            printf("Sort by ID, NAME, PROGRAMME or MARK? Enter the field: ");
+        if (!fgets(choice, sizeof(choice), stdin)) continue;
+        choice[strcspn(choice, "\r\n")] = '\0';
 
-            // Just look at the first character and normalise to uppercase
-            char c = toupper((unsigned char)choice[0]);
+        if (optional && choice[0] == '\0')
+            return 0;
+        if (parse_sort_key(choice, &spec->key))
+            break;
+        printf("CMS: Please enter ID, NAME, PROGRAMME or MARK.\n"); // invalid field input
+    }
 
-            if (c == 'Y' || c == 'N')
-            {
-                if (c == 'N') 
-                {
-                    // User chose NOT to keep autosave → reload original DB and overwrite autosave
-                    list_clear(&studentData);
-                    opendb(&studentData, "P3_1-CMS.txt", fileopened);
-                    autoSave(&studentData, fileopened);
-                    puts("CMS: Changes discarded.\n");
-                    break;
-                }
-                else if (c == 'Y')
-                {
-                    // User chose to recover autosave → save autosave content back to main DB file
-                    savedb(&studentData, "P3_1-CMS.txt");
-                    puts("CMS: Changes saved.\n");
-                    break;
-                }
-            }
-            else
-            {
-                puts("CMS: Please enter Y or N.");
-            }	
+    // Ask user for sort order (ascending/descending)
+    while (1) {
+        printf("Sort ascending or descending? (A/D): ");
+        if (!fgets(choice, sizeof(choice), stdin)) continue;
+
+        char o = toupper((unsigned char)choice[0]);
+        if (o == 'A' || o == 'D') {
+            spec->ascending = (o == 'A');
+            return 1;
         }
+        printf("CMS: Please enter A or D.\n");
     }
+}
+
+#define CMD_OK      0
+#define CMD_FAILED -1
+#define CMD_EXIT    1
+
+typedef struct { //Everything the command loop works on
+    LinkedList data;        // all the student records in memory
+    int fileopened;         // whether the main DB file has been opened
+    Journal journal;        // every change is appended here until the next SAVE
+    Autosave autosave;      // background thread that does the appending
+    int interactive;        // 0 when running a script: no prompts and no banners
+    PageCursor page;        // where the last SHOW ALL ... LIMIT stopped, for NEXT
+    ShardSet shards;        // files opened by OPEN <name>=<file> ...; data stays empty then
+} Session;
+
+typedef enum { //What to do with unsaved journal changes found at startup
+    RECOVER_ASK,            // ask (interactive); refuse to start in batch mode
+    RECOVER_KEEP,           // --recover=keep: replay them and save the file
+    RECOVER_DISCARD         // --recover=discard: drop them, leave the file as it is
+} RecoverMode;
+
+/*
+ * replay_failed:
+ * The journal could not be replayed in full: goes back to the DB file as
+ * it is on disk and keeps the journal, so nothing gets saved without it.
+ *
+ * Returns: 0, for recover_at_startup to pass on
+ */
+static int replay_failed(Session *s)
+{
+    printf("CMS: Warning: could not replay %s; it is kept and %s is left as it is.\n", JOURNAL_FILE, DB_FILE);
+    list_clear(&s->data);
+    if (opendb(&s->data, DB_FILE, s->fileopened) == -1)
+        s->fileopened = 0;
+    return 0;
+}
+
+/*
+ * recover_at_startup:
+ * Checks if the journal (autosave.journal) holds changes that were never
+ * SAVEd into the main DB file (P3_1-CMS.txt). If it does, the user gets a
+ * chance to replay them on top of the file. A script can't answer, so in
+ * batch mode --recover=keep or --recover=discard has to say what to do;
+ * without it both files are left untouched and the run is refused.
+ *
+ * Returns:
+ *   1  if the journal's changes were dealt with (saved or discarded)
+ *   0  if there was nothing to recover, or the recovered state could not
+ *      be saved and the journal must be kept
+ *  -1  if batch mode found changes and no --recover choice
+ */
+static int recover_at_startup(Session *s, RecoverMode mode)
+{
+    char choice[10];
+
+    if (recoverChanges(DB_FILE, JOURNAL_FILE) != 1)
+        return 0;
 
-    // Show basic help so the user knows what commands are available
-    puts("Commands: OPEN | SHOW ALL | SUMMARY | INSERT | QUERY ID=<id> | UPDATE ID=<id> | DELETE ID=<id> | EXIT | SAVE | HELP");
-    puts("Notes: Changes are automatically saved to 'autosave.txt' after each modification.");
+    if (mode == RECOVER_DISCARD)
+    {
+        printf("CMS: Discarded the unsaved changes in %s.\n", JOURNAL_FILE);
+        return 1;
+    }
+    if (mode == RECOVER_ASK && !s->interactive)
+    {
+        printf("CMS: %s holds changes that were never saved to %s. Run again with "
+               "--recover=keep or --recover=discard.\n", JOURNAL_FILE, DB_FILE);
+        return -1;
+    }
+
+    // Load the DB file, then replay the journal on top of it while keeping
+    // the before-image of every record it touches
+    if (opendb(&s->data, DB_FILE, s->fileopened) == -1)
+    {
+        printf("CMS: Warning: could not open %s to recover %s; both are left as they are.\n", DB_FILE, JOURNAL_FILE);
+        return 0;
+    }
+    s->fileopened = 1;
 
-    /*
-     * Main command loop:
-     * - Prompts the user for a command.
-     * - Parses it and dispatches to the corresponding function.
-     * - Loop terminates when user enters EXIT or EOF.
-     */
-    for (;;)
+    if (mode == RECOVER_KEEP)
     {
-        printf("Please input a command: ");
-        if (!fgets(command, sizeof(command), stdin))
+        size_t applied = 0;
+        if (journal_replay(JOURNAL_FILE, &s->data, NULL, &applied) == -1)
+            return replay_failed(s);
+        if (savedb(&s->data, DB_FILE) != 0)
         {
-            // On EOF or read error, just break out of the loop and exit
-            break;
+            printf("CMS: Warning: could not save the recovered changes to %s; keeping %s.\n", DB_FILE, JOURNAL_FILE);
+            return 0;
         }
+        printf("CMS: Recovered %zu journal entries into %s.\n", applied, DB_FILE);
+        return 1;
+    }
 
-        // Remove trailing newline from the command
-        command[strcspn(command, "\n")] = '\0';
+    puts("CMS: There are changes to recover.");
 
-        // Handle empty input
-        if (command[0] == '\0')
-        {
-            puts("No command entered.");
+    JournalChanges changes;
+    list_init(&changes.before);
+    list_init(&changes.fresh);
+
+    size_t applied = 0;
+    if (journal_replay(JOURNAL_FILE, &s->data, &changes, &applied) == -1)
+    {
+        list_clear(&changes.before);
+        list_clear(&changes.fresh);
+        return replay_failed(s);
+    }
+
+    // Show only the records that differ instead of both full tables
+    printf("CMS: These are the changes (%zu journal entries):\n", applied);
+    show_changes(&changes.before, &changes.fresh, &s->data);
+    list_clear(&changes.before);
+    list_clear(&changes.fresh);
+
+    // Ask user if they want to recover the journaled changes
+    printf("Would you like to recover the changes? (Y/N): ");
+
+    while (1)
+    {
+        if (!fgets(choice, sizeof(choice), stdin)) 
             continue;
-        }
 
-        /* ---------- OPEN ---------- */
-        if (strcmp(command, "OPEN") == 0)
+        choice[strcspn(choice, "\n")] = '\0';
+
+        // Just look at the first character and normalise to uppercase
+        char c = toupper((unsigned char)choice[0]);
+
+        if (c == 'Y' || c == 'N')
         {
-            if (fileopened == 1)
+            if (c == 'N') 
             {
-                printf("CMS: File has already been opened.\n");
+                // User chose NOT to keep the changes → reload original DB
+                list_clear(&s->data);
+                opendb(&s->data, DB_FILE, s->fileopened);
+                puts("CMS: Changes discarded.\n");
+                break;
             }
-            if (fileopened == 0)
+            else if (c == 'Y')
             {
-                // Try to open the main database file
-                if (opendb(&studentData, "P3_1-CMS.txt", fileopened) == -1)
+                // User chose to recover → save the replayed state back to main DB file
+                if (savedb(&s->data, DB_FILE) != 0)
                 {
-                    printf("Failed to open, please free up some memory and try again. \n");
-                    continue;
+                    printf("CMS: Warning: could not save the recovered changes to %s; keeping %s.\n", DB_FILE, JOURNAL_FILE);
+                    return 0;
                 }
+                puts("CMS: Changes saved.\n");
+                break;
             }
-            fileopened = 1;
         }
+        else
+        {
+            puts("CMS: Please enter Y or N.");
+        }	
+    }
+    return 1;
+}
 
-        /* ---------- SHOW ALL (with optional sorting) ---------- */
-        else if (strncmp(command, "SHOW ALL", 8) == 0) {
-            // Check if database file has been opened
-            if (!fileopened) {
-                printf("CMS: Please OPEN the database before displaying records.\n");
-                continue; // skip rest and prompt for a new command
-            }
+/*
+ * find_paging:
+ * Finds a LIMIT word in SHOW ALL's arguments.
+ *
+ * Returns:
+ *   pointer to "LIMIT", or NULL if the arguments have none
+ */
+static const char *find_paging(const char *args)
+{
+    for (const char *p = strstr(args, "LIMIT"); p; p = strstr(p + 1, "LIMIT"))
+    {
+        if ((p == args || p[-1] == ' ') && p[5] == ' ')
+            return p;
+    }
+    return NULL;
+}
 
-            // buffer to store user input
-            char choice[10];
+/*
+ * parse_paging:
+ * Reads "LIMIT <n> [OFFSET <m>]"; n must be at least 1.
+ *
+ * Returns:
+ *   1 if the text was valid, 0 otherwise
+ */
+static int parse_paging(const char *text, size_t *limit, size_t *offset)
+{
+    char *end;
+    const char *p = text + 5;
+
+    while (*p == ' ')
+        p++;
+    if (!isdigit((unsigned char)*p))
+        return 0;
+    *limit = strtoul(p, &end, 10);
+    if (*limit == 0)
+        return 0;
+
+    *offset = 0;
+    p = end;
+    while (*p == ' ')
+        p++;
+    if (strncmp(p, "OFFSET ", 7) == 0)
+    {
+        p += 7;
+        while (*p == ' ')
+            p++;
+        if (!isdigit((unsigned char)*p))
+            return 0;
+        *offset = strtoul(p, &end, 10);
+        p = end;
+        while (*p == ' ')
+            p++;
+    }
+    return *p == '\0';
+}
+
+/*
+ * display_all / display_sorted / display_page:
+ * SHOW ALL's three displays, over every shard when OPEN attached several
+ * files and over the single database otherwise.
+ */
+static void display_all(Session *s)
+{
+    if (s->shards.count > 0)
+        shards_show_all(&s->shards);
+    else
+        show_all_cmd(&s->data, s->fileopened);
+}
+
+static void display_sorted(Session *s, const SortSpec *keys, size_t nkeys)
+{
+    if (s->shards.count > 0)
+        shards_show_sorted(&s->shards, keys, nkeys);
+    else
+        show_sorted(&s->data, keys, nkeys);
+}
+
+static void display_page(Session *s, const SortSpec *keys, size_t nkeys, size_t limit, size_t offset)
+{
+    if (s->shards.count > 0)
+        shards_show_page(&s->shards, &s->page, keys, nkeys, limit, offset);
+    else
+        show_page(&s->data, &s->page, keys, nkeys, limit, offset);
+}
+
+/*
+ * show_all:
+ * SHOW ALL on its own asks whether and how to sort (interactive only);
+ * SHOW ALL SORT=<field> [ASC|DESC][,...] sorts without asking.
+ * A trailing LIMIT <n> [OFFSET <m>] prints one page and NEXT the ones after it.
+ */
+static int show_all(Session *s, const char *args)
+{
+    // Check if database file has been opened
+    if (!s->fileopened) {
+        printf("CMS: Please OPEN the database before displaying records.\n");
+        return CMD_FAILED;
+    }
+
+    while (*args == ' ')
+        args++;
+
+    // Split off LIMIT <n> [OFFSET <m>]; what comes before it is the sort spec
+    char spec[128];
+    size_t limit = 0, offset = 0;
+    const char *paging = find_paging(args);
+    if (paging) {
+        size_t len = (size_t)(paging - args);
+        if (!parse_paging(paging, &limit, &offset) || len >= sizeof spec) {
+            puts("Please do: SHOW ALL [SORT=<field> [ASC|DESC]] LIMIT <n> [OFFSET <m>] instead");
+            return CMD_FAILED;
+        }
+        while (len > 0 && args[len - 1] == ' ')
+            len--;
+        memcpy(spec, args, len);
+        spec[len] = '\0';
+        args = spec;
+    }
+
+    if (strncmp(args, "SORT=", 5) == 0) {
+        SortSpec keys[SORT_MAX_KEYS];
+        size_t nkeys = parse_sort_spec(args + 5, keys, SORT_MAX_KEYS);
+        if (nkeys == 0) {
+            puts("Please do: SHOW ALL SORT=<ID|NAME|PROGRAMME|MARK> [ASC|DESC][,...] instead");
+            return CMD_FAILED;
+        }
+        if (paging) {
+            display_page(s, keys, nkeys, limit, offset);
+            return CMD_OK;
+        }
+        display_sorted(s, keys, nkeys);
+        return CMD_OK;
+    }
+    if (*args != '\0') {
+        puts("Please do: SHOW ALL [SORT=<field> [ASC|DESC]] [LIMIT <n> [OFFSET <m>]] instead");
+        return CMD_FAILED;
+    }
+    if (paging) {
+        display_page(s, NULL, 0, limit, offset);
+        return CMD_OK;
+    }
+    if (!s->interactive) {
+        display_all(s);
+        return CMD_OK;
+    }
+
+    // buffer to store user input
+    char choice[10];
+    
+    // Ask user if they want to sort the records before displaying
+    while (1) {
+        printf("Do you want to sort the records? (Y/N): ");
+
+        // Read input and handle EOF
+        if (!fgets(choice, sizeof(choice), stdin)) continue;
+        
+        // Remove trailing newline
+        choice[strcspn(choice, "\n")] = '\0';
+
+        // Convert first character to uppercase for uniformity
+        char c = toupper((unsigned char)choice[0]);
+        
+        // valid input
+        if (c == 'Y' || c == 'N') {
+            if (c == 'N') {
+                // User chose not to sort, display list as-is
+                display_all(s);
+                return CMD_OK; // exit sorting loop
+            }
             
-            // Ask user if they want to sort the records before displaying
-            while (1) {
-                printf("Do you want to sort the records? (Y/N): ");
-
-                // Read input and handle EOF
-                if (!fgets(choice, sizeof(choice), stdin)) continue;
-                
-                // Remove trailing newline
-                choice[strcspn(choice, "\n")] = '\0';
-
-                // Convert first character to uppercase for uniformity
-                char c = toupper((unsigned char)choice[0]);
-                
-                // valid input
-                if (c == 'Y' || c == 'N') {
-                    if (c == 'N') {
-                        // User chose not to sort, display list as-is
-                        show_all_cmd(&studentData, fileopened);
-                        break; // exit sorting loop
-                    }
-                    
-                    // If user wants to sort, ask which field to sort by
-                    while (1) {
-                        printf("Sort by ID or MARK? Enter ID or MARK: ");
-                        if (!fgets(choice, sizeof(choice), stdin)) continue;
-                        
-                        choice[strcspn(choice, "\n")] = '\0';
-
-                         // Convert entire word to uppercase for comparison
-                        for (int i = 0; choice[i]; i++)
-                            choice[i] = toupper((unsigned char)choice[i]);
-
-                        // Validate input: must be ID or MARK
-                        if (strcmp(choice, "ID") == 0 || strcmp(choice, "MARK") == 0) {
-                            char order[10];
-                            int ascending = 1; // default ascending order
-                            
-                            // Ask user for sort order (ascending/descending)
-                            while (1) {
-                                printf("Sort ascending or descending? (A/D): ");
-                                
-                                if (!fgets(order, sizeof(order), stdin)) continue;
-                                order[strcspn(order, "\n")] = '\0';
-
-                                char o = toupper((unsigned char)order[0]);
-                                
-                                if (o == 'A') { 
-                                    ascending = 1; 
-                                    break; // valid order
-                                }
-                                else if (o == 'D') { 
-                                    ascending = 0; 
-                                    break; // valid order
-                                }
-                                else { 
-                                    printf("CMS: Please enter A or D.\n"); 
-                                }
-                            }
-                            
-                            // Perform bubble sort on the linked list based on chosen field and order
-                            bubbleSortLinkedList(&studentData, choice, ascending);
-                            
-                            // Display the sorted list
-                            show_all_cmd(&studentData, fileopened);
-                            break; // exit sort field loop
-                        } else {
-                            printf("CMS: Please enter either ID or MARK.\n"); // invalid field input
-                        }
-                    }
-                    break; // exit main SHOW ALL loop
-                } else {
-                    printf("CMS: Please enter Y or N.\n");
-                }
+            // If user wants to sort, ask for the primary key and optionally a secondary one
+            SortSpec keys[2];
+            size_t nkeys = 0;
+
+            prompt_sort_key(&keys[nkeys++], 0);
+            if (prompt_sort_key(&keys[nkeys], 1))
+                nkeys++;
+
+            // Display through a sorted view; the list itself keeps its order
+            display_sorted(s, keys, nkeys);
+            return CMD_OK; // exit main SHOW ALL loop
+        } else {
+            printf("CMS: Please enter Y or N.\n");
+        }
+    }
+}
+
+/*
+ * single_db_only:
+ * Commands that change, save or rank one database. Shards are opened
+ * read-only, so these are refused while they are open.
+ *
+ * Returns:
+ *   1 if command is one of them, 0 otherwise
+ */
+static int single_db_only(const char *command)
+{
+    static const char *const words[] = {
+        "INSERT", "UPDATE", "DELETE", "IMPORT", "SAVE", "TOP", "BOTTOM", "RANK"
+    };
+    size_t word = strcspn(command, " ");
+
+    for (size_t i = 0; i < sizeof words / sizeof words[0]; i++)
+    {
+        if (strlen(words[i]) == word && strncmp(command, words[i], word) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * run_command:
+ * Parses one command line and dispatches to the corresponding function.
+ * Used by both the interactive prompt and script mode, so a script goes
+ * through exactly the same code paths as a user.
+ *
+ * Returns:
+ *   CMD_OK, CMD_FAILED, or CMD_EXIT when the command was EXIT
+ */
+static int run_command(Session *s, const char *command)
+{
+    if (s->shards.count > 0 && single_db_only(command))
+    {
+        printf("CMS: %.*s works on a single database; shards are opened read-only.\n",
+               (int)strcspn(command, " "), command);
+        return CMD_FAILED;
+    }
+
+    /* ---------- OPEN ---------- */
+    if (strcmp(command, "OPEN") == 0)
+    {
+        if (s->fileopened == 1)
+        {
+            printf("CMS: File has already been opened.\n");
+        }
+        if (s->fileopened == 0)
+        {
+            // Try to open the main database file
+            if (opendb(&s->data, DB_FILE, s->fileopened) == -1)
+            {
+                printf("Failed to open %s, see the message above. \n", DB_FILE);
+                return CMD_FAILED;
             }
         }
+        s->fileopened = 1;
+    }
+
+    /* ---------- OPEN <name>=<file> ... (read-only shards) ---------- */
+    else if (strncmp(command, "OPEN ", 5) == 0)
+    {
+        if (s->fileopened == 1)
+        {
+            printf("CMS: File has already been opened.\n");
+            return CMD_FAILED;
+        }
+        // Every file is loaded at the same time, on a thread of its own
+        if (shards_open(&s->shards, command + 5) == -1)
+            return CMD_FAILED;
+        s->fileopened = 1;
+    }
+
+    /* ---------- SHOW ALL (with optional sorting) ---------- */
+    else if (strncmp(command, "SHOW ALL", 8) == 0)
+    {
+        return show_all(s, command + 8);
+    }
 
-        /* ---------- INSERT ---------- */
-        else if (strcmp(command, "INSERT") == 0)
+    /* ---------- INSERT / INSERT <id>|<name>|<programme>|<mark> ---------- */
+    else if (strcmp(command, "INSERT") == 0 || strncmp(command, "INSERT ", 7) == 0)
+    {
+        int id;
+        if (command[6] == ' ')
+            id = insertInline(&s->data, command + 7, s->fileopened);
+        else if (s->interactive)
+            id = insertStudentRecords(&s->data, s->fileopened);
+        else
         {
-            insertStudentRecords(&studentData, fileopened);
-            // After modifying the list, auto-save to autosave.txt
-            autoSave(&studentData, fileopened);
+            puts("Please do: INSERT <id>|<name>|<programme>|<mark> instead");
+            return CMD_FAILED;
         }
+
+        // After modifying the list, append the new record to the journal
+        if (id == -1)
+            return CMD_FAILED;
+        Student st;
+        record_to_student(&st, &list_find_by_id(&s->data, id)->s);
+        autoSave(&s->autosave, JOURNAL_INSERT, &st, s->fileopened);
+    }
 		
-        /* ---------- EXIT ---------- */
-        else if (strcmp(command, "EXIT") == 0)
+    /* ---------- NEXT (page after SHOW ALL ... LIMIT) ---------- */
+    else if (strcmp(command, "NEXT") == 0)
+    {
+        if (!s->fileopened)
         {
-            // Just break out of the main loop and end the program
-            break;
+            printf("CMS: Please OPEN the database before displaying records.\n");
+            return CMD_FAILED;
         }
+        if (s->shards.count > 0 ? shards_next(&s->shards, &s->page) == -1
+                                : show_next(&s->data, &s->page) == -1)
+            return CMD_FAILED;
+    }
+
+    /* ---------- EXIT ---------- */
+    else if (strcmp(command, "EXIT") == 0)
+    {
+        // Just break out of the main loop and end the program
+        return CMD_EXIT;
+    }
+
+    /* ---------- QUERY ID= / NAME= / PROGRAMME= / MARK ---------- */
+    else if (strncmp(command, "QUERY ", 6) == 0)
+    {
+        // Pass arguments after "QUERY " to the query function
+        if (s->shards.count > 0)
+            shards_query(&s->shards, command + 6);
+        else
+            query(&s->data, command + 6);
+    }
+    else if (strcmp(command, "QUERY") == 0)
+    {
+        // User forgot to specify ID, give a friendly hint
+        puts("Please do: QUERY ID=<id> instead");
+        return CMD_FAILED;
+    }
+
+    /* ---------- TOP <k> / BOTTOM <k> / RANK ID=<id> ---------- */
+    else if (strncmp(command, "TOP ", 4) == 0 || strncmp(command, "BOTTOM ", 7) == 0)
+    {
+        int highest = command[0] == 'T';
+        show_top(&s->data, command + (highest ? 4 : 7), highest);
+    }
+    else if (strncmp(command, "RANK ", 5) == 0)
+    {
+        show_rank(&s->data, command + 5);
+    }
+
+    /* ---------- UPDATE ID=<id> [NAME=..|PROGRAMME=..|MARK=..] ---------- */
+    else if (strncmp(command, "UPDATE ", 7) == 0)
+    {
+        int id = updateStudentRecord(&s->data, command + 7, s->interactive);
+        if (id == -1)
+            return CMD_FAILED;
+        Student st;
+        record_to_student(&st, &list_find_by_id(&s->data, id)->s);
+        autoSave(&s->autosave, JOURNAL_UPDATE, &st, s->fileopened);
+    }
+    else if (strcmp(command, "UPDATE") == 0)
+    {
+        puts("Please do: UPDATE ID=<id> instead");
+        return CMD_FAILED;
+    }
 
-        /* ---------- QUERY ID=<id> ---------- */
-        else if (strncmp(command, "QUERY ", 6) == 0)
+    /* ---------- DELETE ID=<id> [FORCE] ---------- */
+    else if (strncmp(command, "DELETE ", 7) == 0)
+    {
+        int id = delete(&s->data, command + 7, s->interactive);
+        if (id == -1)
+            return CMD_FAILED;
+        Student gone = { .id = id };
+        autoSave(&s->autosave, JOURNAL_DELETE, &gone, s->fileopened);
+    }
+    else if (strcmp(command, "DELETE") == 0)
+    {
+        puts("Please do: DELETE ID=<id> instead");
+        return CMD_FAILED;
+    }
+
+    /* ---------- IMPORT <file> ---------- */
+    else if (strncmp(command, "IMPORT ", 7) == 0)
+    {
+        if (!s->fileopened)
         {
-            // Pass arguments after "QUERY " to the query function
-            query(&studentData, command + 6);
+            puts("CMS: Please OPEN the database before importing records.");
+            return CMD_FAILED;
         }
-        else if (strcmp(command, "QUERY") == 0)
+
+        char file[256];
+        size_t imported;
+        if (sscanf(command + 7, "%255s", file) != 1)
         {
-            // User forgot to specify ID, give a friendly hint
-            puts("Please do: QUERY ID=<id> instead");
+            puts("Please do: IMPORT <file> instead");
+            return CMD_FAILED;
         }
+        if (importdb(&s->data, file, &s->autosave, &imported) == -1)
+            return CMD_FAILED;
+    }
+    else if (strcmp(command, "IMPORT") == 0)
+    {
+        puts("Please do: IMPORT <file> instead");
+        return CMD_FAILED;
+    }
 
-        /* ---------- UPDATE ID=<id> ---------- */
-        else if (strncmp(command, "UPDATE ", 7) == 0)
+    /* ---------- SAVE ---------- */
+    else if (strcmp(command, "SAVE") == 0)
+    {
+        if (s->fileopened == 0)
         {
-            updateStudentRecord(&studentData, command + 7);
-            autoSave(&studentData, fileopened);
+            puts("Please OPEN the file first");
+            return CMD_FAILED;
         }
-        else if (strcmp(command, "UPDATE") == 0)
+
+        // Save the in-memory list back to the main DB file, once the
+        // worker has written everything queued before the SAVE
+        autosave_flush(&s->autosave);
+        if (savedb(&s->data, DB_FILE) == -1)
         {
-            puts("Please do: UPDATE ID=<id> instead");
+            printf("Failed to open, please free up some memory and try again.\n");
+            return CMD_FAILED;
         }
+        // Everything in the journal is in the file now
+        journal_checkpoint(&s->journal);
+        puts("File successfully saved.");
+    }
 
-        /* ---------- DELETE ID=<id> ---------- */
-        else if (strncmp(command, "DELETE ", 7) == 0)
+    /* ---------- CONVERT <src> <dst> ---------- */
+    else if (strncmp(command, "CONVERT ", 8) == 0)
+    {
+        char src[256], dst[256];
+        if (sscanf(command + 8, "%255s %255s", src, dst) != 2)
         {
-            delete(&studentData, command + 7);
-            autoSave(&studentData, fileopened);
+            puts("Please do: CONVERT <source file> <destination file> instead");
+            return CMD_FAILED;
         }
-        else if (strcmp(command, "DELETE") == 0)
+        else if (convertdb(src, dst) == -1)
         {
-            puts("Please do: DELETE ID=<id> instead");
+            printf("CMS: Failed to convert %s to %s.\n", src, dst);
+            return CMD_FAILED;
         }
+        else
+        {
+            printf("CMS: Converted %s to %s (%s).\n", src, dst,
+                   format_for_new_file(dst) == DB_FORMAT_BINARY ? "binary snapshot" : "TSV");
+        }
+    }
+    else if (strcmp(command, "CONVERT") == 0)
+    {
+        puts("Please do: CONVERT <source file> <destination file> instead");
+        return CMD_FAILED;
+    }
+
+    /* ---------- HELP ---------- */
+    else if (strcmp(command, "HELP") == 0)
+    {
+        // Re-print the list of available commands
+        puts(COMMANDS_HELP);
+    }
 
-        /* ---------- SAVE ---------- */
-        else if (strcmp(command, "SAVE") == 0)
+    /* ---------- SUMMARY [BY PROGRAMME] ---------- */
+    else if (strcmp(command, "SUMMARY") == 0 || strcmp(command, "SUMMARY BY PROGRAMME") == 0)
+    {
+        if (!s->fileopened)
         {
-            if (fileopened == 0)
-            {
-                puts("Please OPEN the file first");
-            }
+            puts("CMS: Please OPEN the database before displaying summary.");
+            return CMD_FAILED;
+        }
+        else if (s->shards.count > 0)
+        {
+            // Each shard's partials are computed on its own thread and merged
+            if (command[7] == '\0')
+                shards_summary(&s->shards);
             else
-            {
-                // Save the in-memory list back to the main DB file
-                if (savedb(&studentData, "P3_1-CMS.txt") == -1)
-                {
-                    printf("Failed to open, please free up some memory and try again.\n");
-                    continue;
-                }
-                puts("File successfully saved.");
-            }
+                shards_summary_by_programme(&s->shards);
+        }
+        else if (command[7] == '\0')
+        {
+            show_summary(&s->data);
+        }
+        else
+        {
+            show_summary_by_programme(&s->data);
+        }
+    }
+
+    /* ---------- STATS ---------- */
+    else if (strcmp(command, "STATS") == 0)
+    {
+        // Counts and latencies so far; the STATS call itself is not in them yet
+        stats_print(stdout);
+
+        size_t records = s->data.cols.len + shards_records(&s->shards);
+        size_t bytes = list_footprint(&s->data) + shards_footprint(&s->shards);
+        printf("\nCMS: %zu record(s) in %zu bytes of memory", records, bytes);
+        if (records)
+            printf(", %.1f bytes per record", (double)bytes / (double)records);
+        puts(".");
+    }
+
+    /* ---------- Unknown command ---------- */
+    else
+    {
+        // Interactively this stays quiet, but a script should hear about typos
+        if (!s->interactive)
+            printf("CMS: Unknown command: %s\n", command);
+        return CMD_FAILED;
+    }
+    return CMD_OK;
+}
+
+/*
+ * timed_command:
+ * Runs one command through run_command and records its latency and
+ * outcome for STATS.
+ */
+static int timed_command(Session *s, const char *command)
+{
+    STATS_START(started);
+    int rc = run_command(s, command);
+    STATS_COMMAND(command, started, rc == CMD_FAILED);
+    return rc;
+}
+
+/*
+ * run_script:
+ * Batch mode: runs every line of in as a command, with arguments inline.
+ * Blank lines and lines starting with '#' are skipped. Changes are only
+ * queued for the autosave worker while the script runs, so the whole
+ * script ends up as one autosave.
+ *
+ * Returns:
+ *   number of commands that failed
+ */
+static size_t run_script(Session *s, FILE *in)
+{
+    char command[512];
+    size_t line = 0, commands = 0, failed = 0;
+
+    autosave_hold(&s->autosave, 1);
+
+    while (fgets(command, sizeof(command), in))
+    {
+        line++;
+        command[strcspn(command, "\r\n")] = '\0';
+        if (command[0] == '\0' || command[0] == '#')
+            continue;
+
+        commands++;
+        int rc = timed_command(s, command);
+        if (rc == CMD_EXIT)
+            break;
+        if (rc == CMD_FAILED)
+        {
+            printf("CMS: Line %zu: command failed.\n", line);
+            failed++;
+        }
+    }
+
+    autosave_hold(&s->autosave, 0);
+    printf("CMS: Script finished: %zu command(s), %zu failed.\n", commands, failed);
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    Session s;
+    list_init(&s.data);
+    s.fileopened = 0;
+    s.interactive = 1;
+    s.page.active = 0;
+    shards_init(&s.shards);
+
+    // --batch [script] runs commands from a file (or stdin) without prompting;
+    // --recover=keep|discard answers the recovery question up front
+    RecoverMode mode = RECOVER_ASK;
+    const char *script_name = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--recover=keep") == 0 && mode == RECOVER_ASK)
+            mode = RECOVER_KEEP;
+        else if (strcmp(argv[i], "--recover=discard") == 0 && mode == RECOVER_ASK)
+            mode = RECOVER_DISCARD;
+        else if (strcmp(argv[i], "--batch") == 0 && s.interactive)
+            s.interactive = 0;
+        else if (!s.interactive && !script_name && strncmp(argv[i], "--", 2) != 0)
+            script_name = argv[i];
+        else
+        {
+            fprintf(stderr, "Usage: %s [--recover=keep|discard] [--batch [script]]\n", argv[0]);
+            return 1;
         }
+    }
 
-        /* ---------- HELP ---------- */
-        else if (strcmp(command, "HELP") == 0)
+    FILE *script = NULL;
+    if (!s.interactive)
+    {
+        script = stdin;
+        if (script_name && strcmp(script_name, "-") != 0 && !(script = fopen(script_name, "r")))
         {
-            // Re-print the list of available commands
-            puts("Commands: OPEN | SHOW ALL | SUMMARY | INSERT | QUERY ID=<id> | UPDATE ID=<id> | DELETE ID=<id> | EXIT | SAVE | HELP");
+            perror(script_name);
+            return 1;
         }
+    }
+
+    int recovered = recover_at_startup(&s, mode);
+    if (recovered == -1)
+    {
+        if (script != stdin)
+            fclose(script);
+        return 1;
+    }
+
+    // Once the journal's entries are saved or discarded, start it afresh;
+    // if saving them failed they stay in it for the next run
+    if (journal_open(&s.journal, JOURNAL_FILE, DB_FILE, journal_sync_from_env()) == -1)
+    {
+        puts("CMS: Warning: could not open the journal, changes will not be autosaved.");
+    }
+    else if (recovered)
+    {
+        journal_checkpoint(&s.journal);
+    }
+    autosave_start(&s.autosave, &s.journal);
 
-        /* ---------- SUMMARY ---------- */
-        else if (strcmp(command, "SUMMARY") == 0)  
+    size_t failed = 0;
+    if (script)
+    {
+        failed = run_script(&s, script);
+        if (script != stdin)
+            fclose(script);
+    }
+    else
+    {
+        char command[256];      // buffer to store user command input
+
+        // Show basic help so the user knows what commands are available
+        puts(COMMANDS_HELP);
+        puts("Notes: Each modification is recorded in '" JOURNAL_FILE "' until the next SAVE.");
+
+        /*
+         * Main command loop:
+         * - Prompts the user for a command and hands it to run_command.
+         * - Loop terminates when user enters EXIT or EOF.
+         */
+        for (;;)
         {
-            if (!fileopened)
+            // Print whatever the autosave worker finished since the last prompt
+            autosave_report(&s.autosave);
+
+            printf("Please input a command: ");
+            if (!fgets(command, sizeof(command), stdin))
             {
-                puts("CMS: Please OPEN the database before displaying summary.");
-                continue;
+                // On EOF or read error, just break out of the loop and exit
+                break;
             }
-            else
+
+            // Remove trailing newline from the command
+            command[strcspn(command, "\n")] = '\0';
+
+            // Handle empty input
+            if (command[0] == '\0')
             {
-                show_summary(&studentData);
+                puts("No command entered.");
+                continue;
             }
-        }
 
-        /* ---------- Unknown command ---------- */
-        else
-        {
-            // Optional: you could add an error here, but your assignment might not need it
-            // puts("CMS: Unknown command. Type HELP for a list of commands.");
+            if (timed_command(&s, command) == CMD_EXIT)
+                break;
         }
     }
 
-    // (Optional cleanup could go here: list_clear(&studentData);)
+    // Make sure every journaled change is on disk before leaving
+    autosave_flush(&s.autosave);
+    autosave_report(&s.autosave);
+    autosave_stop(&s.autosave);
+    journal_close(&s.journal);
+    stats_dump_at_exit();
+
+    // (Optional cleanup could go here: list_clear(&s.data);)
     // For now I just let the OS reclaim memory on exit.
+    return failed ? 1 : 0;
 }
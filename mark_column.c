@@ -0,0 +1,104 @@
+
+#include "mark_column.h"
+#include "linked_list.h"
+#include <stdlib.h>
+
+#define COLUMN_MIN_CAP 256
+
+/*
+ * column_init:
+ * - Starts with empty columns; storage is allocated on the first append.
+ */
+void column_init(MarkColumn* c)
+{
+    c->marks = NULL;
+    c->ids   = NULL;
+    c->slots = NULL;
+    c->len = c->cap = 0;
+}
+
+/*
+ * column_free:
+ * - Releases the column arrays. The nodes belong to the list.
+ */
+void column_free(MarkColumn* c)
+{
+    free(c->marks);
+    free(c->ids);
+    free(c->slots);
+    column_init(c);
+}
+
+/*
+ * reserve:
+ * - Makes sure there is room for one more row, doubling all three arrays
+ *   together when needed.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if any realloc failed (the columns that did grow are kept, so the
+ *      existing rows stay valid either way)
+ */
+static int reserve(MarkColumn* c)
+{
+    if (c->len < c->cap) {
+        return 0;
+    }
+
+    size_t cap = c->cap ? c->cap * 2 : COLUMN_MIN_CAP;
+
+    float* marks = realloc(c->marks, cap * sizeof *marks);
+    if (!marks) return -1;
+    c->marks = marks;
+
+    int* ids = realloc(c->ids, cap * sizeof *ids);
+    if (!ids) return -1;
+    c->ids = ids;
+
+    uint32_t* slots = realloc(c->slots, cap * sizeof *slots);
+    if (!slots) return -1;
+    c->slots = slots;
+
+    c->cap = cap;
+    return 0;
+}
+
+/*
+ * column_append:
+ * - Adds a row for n at the end of the columns and remembers the row
+ *   number in n->row.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if the columns could not grow
+ */
+int column_append(MarkColumn* c, Node* n)
+{
+    if (reserve(c) == -1) {
+        return -1;
+    }
+
+    size_t row = c->len++;
+    c->marks[row] = record_mark(&n->s);
+    c->ids[row]   = n->s.id;
+    c->slots[row] = n->slot;
+    n->row = row;
+    return 0;
+}
+
+/*
+ * column_remove:
+ * - Drops a row in O(1) by moving the last row into its place.
+ * - The row order therefore does not follow the list order; nothing that
+ *   scans the columns (sums, min/max) depends on it.
+ */
+void column_remove(MarkColumn* c, NodePool* pool, size_t row)
+{
+    size_t last = --c->len;
+    if (row != last) {
+        c->marks[row] = c->marks[last];
+        c->ids[row]   = c->ids[last];
+        c->slots[row] = c->slots[last];
+        POOL_NODE(pool, c->slots[row])->row = row;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef MARK_COLUMN_H
+#define MARK_COLUMN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "node_pool.h"
+
+struct Node;
+
+typedef struct { //Contiguous columns mirroring the list, one row per node
+    float* marks;
+    int* ids;
+    uint32_t* slots;      // row -> the node's pool slot, to get back to the name and programme
+    size_t len;
+    size_t cap;
+} MarkColumn;
+
+void column_init(MarkColumn* c);
+void column_free(MarkColumn* c);
+int column_append(MarkColumn* c, struct Node* n);
+void column_remove(MarkColumn* c, NodePool* pool, size_t row);
+
+#endif
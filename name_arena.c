@@ -0,0 +1,100 @@
+
+#include "name_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK 65536         // bytes per block; longer names get a block of their own
+
+typedef struct NameBlock {
+    struct NameBlock* next;
+    size_t cap;
+    size_t used;
+    char data[];
+} NameBlock;
+
+/*
+ * arena_init:
+ * - Starts the arena empty; the first block comes with the first name.
+ */
+void arena_init(NameArena* a)
+{
+    a->blocks   = NULL;
+    a->live     = 0;
+    a->dead     = 0;
+    a->reserved = 0;
+}
+
+/*
+ * arena_free:
+ * - Frees every block. Every name handed out becomes invalid.
+ */
+void arena_free(NameArena* a)
+{
+    for (NameBlock* b = a->blocks; b;) {
+        NameBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+    arena_init(a);
+}
+
+/*
+ * arena_reserve:
+ * - Makes sure the next bytes worth of names fit in the newest block, so
+ *   storing them cannot fail.
+ *
+ * Returns:
+ *   0  on success, -1 if the block could not be allocated
+ */
+int arena_reserve(NameArena* a, size_t bytes)
+{
+    NameBlock* b = a->blocks;
+    if (b && b->cap - b->used >= bytes) {
+        return 0;
+    }
+
+    size_t cap = bytes > ARENA_BLOCK ? bytes : ARENA_BLOCK;
+    NameBlock* nb = malloc(sizeof *nb + cap);
+    if (!nb) {
+        return -1;
+    }
+    nb->next = a->blocks;
+    nb->cap  = cap;
+    nb->used = 0;
+    a->blocks = nb;
+    a->reserved += cap;
+    return 0;
+}
+
+/*
+ * arena_store:
+ * - Copies name into the arena, using only its length plus the NUL.
+ *
+ * Returns:
+ *   the stored copy, valid until arena_free
+ *   NULL if memory ran out
+ */
+const char* arena_store(NameArena* a, const char* name)
+{
+    size_t n = strlen(name) + 1;
+    if (arena_reserve(a, n) == -1) {
+        return NULL;
+    }
+    char* p = a->blocks->data + a->blocks->used;
+    memcpy(p, name, n);
+    a->blocks->used += n;
+    a->live += n;
+    return p;
+}
+
+/*
+ * arena_release:
+ * - Marks a stored name as no longer used. The bytes are only given back
+ *   when the owner copies the live names into a fresh arena.
+ */
+void arena_release(NameArena* a, const char* name)
+{
+    size_t n = strlen(name) + 1;
+    a->live -= n;
+    a->dead += n;
+}
@@ -0,0 +1,21 @@
+#ifndef NAME_ARENA_H
+#define NAME_ARENA_H
+
+#include <stddef.h>
+
+struct NameBlock;
+
+typedef struct { //Per-list storage for student names, packed end to end
+    struct NameBlock* blocks;   // newest block first; blocks never move
+    size_t live;                // bytes (NUL included) of names still in use
+    size_t dead;                // bytes of names that were replaced or deleted
+    size_t reserved;            // bytes allocated for blocks
+} NameArena;
+
+void arena_init(NameArena* a);
+void arena_free(NameArena* a);
+int arena_reserve(NameArena* a, size_t bytes);
+const char* arena_store(NameArena* a, const char* name);
+void arena_release(NameArena* a, const char* name);
+
+#endif
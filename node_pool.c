@@ -0,0 +1,103 @@
+#include "node_pool.h"
+#include "linked_list.h"
+#include "stats.h"
+#include <stdlib.h>
+
+#define POOL_MIN_PAGES 16         // first size of the page table
+
+/*
+ * pool_init:
+ * - Starts the pool with no pages. The first page is only allocated when
+ *   the first node is requested.
+ */
+void pool_init(NodePool* pool)
+{
+    pool->pages     = NULL;
+    pool->npages    = pool->page_cap = 0;
+    pool->free_list = POOL_NIL;
+    pool->used      = 0;
+}
+
+/*
+ * pool_alloc:
+ * - Hands out the slot of one uninitialised Node; POOL_NODE turns it into
+ *   the node. Links between nodes are slots rather than pointers, which
+ *   halves them.
+ * - Reuses a previously freed node if there is one, otherwise takes the
+ *   next slot, so nodes inserted one after another end up next to each
+ *   other in memory.
+ * - Pages are a fixed POOL_PAGE nodes, so a slot finds its page with a
+ *   shift and a list wastes at most one page. Only the page table is
+ *   reallocated as it grows; the nodes stay where they are.
+ *
+ * Returns:
+ *   the slot
+ *   POOL_NIL if a new page could not be allocated or the slots ran out
+ */
+uint32_t pool_alloc(NodePool* pool)
+{
+    STATS_ADD(STAT_NODES_ALLOCATED, 1);
+    if (pool->free_list != POOL_NIL) {
+        uint32_t slot = pool->free_list;
+        pool->free_list = POOL_NODE(pool, slot)->next;
+        return slot;
+    }
+    if (pool->used == POOL_NIL) {
+        return POOL_NIL;
+    }
+
+    if ((pool->used >> POOL_PAGE_SHIFT) == pool->npages) {
+        if (pool->npages == pool->page_cap) {
+            size_t cap = pool->page_cap ? pool->page_cap * 2 : POOL_MIN_PAGES;
+            Node** pages = realloc(pool->pages, cap * sizeof *pages);
+            if (!pages) {
+                return POOL_NIL;
+            }
+            pool->pages = pages;
+            pool->page_cap = cap;
+        }
+
+        Node* page = malloc(POOL_PAGE * sizeof *page);
+        if (!page) {
+            return POOL_NIL;
+        }
+        STATS_ADD(STAT_NODE_BLOCKS, 1);
+        pool->pages[pool->npages++] = page;
+    }
+
+    return pool->used++;
+}
+
+/*
+ * pool_free:
+ * - Gives a node back to the pool. The memory stays in its page and the
+ *   slot is put on the free list for the next pool_alloc.
+ */
+void pool_free(NodePool* pool, uint32_t slot)
+{
+    POOL_NODE(pool, slot)->next = pool->free_list;
+    pool->free_list = slot;
+}
+
+/*
+ * pool_release:
+ * - Frees every page at once. All nodes handed out by the pool become
+ *   invalid, so this is only for tearing the whole list down.
+ */
+void pool_release(NodePool* pool)
+{
+    for (size_t i = 0; i < pool->npages; i++) {
+        free(pool->pages[i]);
+    }
+    free(pool->pages);
+    pool_init(pool);
+}
+
+/*
+ * pool_bytes:
+ * - Memory held by the pool's pages, used or not, and the page table.
+ */
+size_t pool_bytes(const NodePool* pool)
+{
+    return pool->npages * POOL_PAGE * sizeof(Node) + pool->page_cap * sizeof *pool->pages;
+}
@@ -0,0 +1,30 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define POOL_NIL UINT32_MAX             // no node: the end of a list, an empty link
+#define POOL_PAGE_SHIFT 10
+#define POOL_PAGE (1u << POOL_PAGE_SHIFT)   // nodes per page
+
+struct Node;
+
+typedef struct { //Slab allocator for list nodes, which it numbers with 32-bit slots
+    struct Node** pages;        // page i holds slots i*POOL_PAGE and up; pages never move
+    size_t npages, page_cap;
+    uint32_t free_list;         // deleted nodes waiting to be reused (linked through next)
+    uint32_t used;              // slots handed out so far, freed ones included
+} NodePool;
+
+// The node in a slot pool_alloc handed out (needs the full Node type)
+#define POOL_NODE(pool, slot) \
+    (&(pool)->pages[(slot) >> POOL_PAGE_SHIFT][(slot) & (POOL_PAGE - 1)])
+
+void pool_init(NodePool* pool);
+uint32_t pool_alloc(NodePool* pool);
+void pool_free(NodePool* pool, uint32_t slot);
+void pool_release(NodePool* pool);
+size_t pool_bytes(const NodePool* pool);
+
+#endif
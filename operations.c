@@ -2,24 +2,27 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include "commands.h"
 #include "operations.h"
+#include "file_map.h"
+#include "parallel.h"
+#include "fast_parse.h"
+#include "snapshot.h"
+#include "stats.h"
 
-#define FIELD_MAX 50
-#define LINE_MAX  512
+#define NUM_MAX   64   // longest ID / Mark field handed to strtol / strtof
 
-/*
- * rstrip:
- * Simple helper to strip trailing '\n' and '\r' from a string read by fgets.
- * I use this to clean up lines from the file before I start parsing them.
- */
-static void rstrip(char *s)
+/* Reasons parse_row can reject a line; report_row_error prints the message for each */
+enum
 {
-	size_t n = strlen(s);
-	while (n && (s[n - 1] == '\n' || s[n - 1] == '\r'))
-	{
-		s[--n] = '\0';
-	}
-}
+	ROW_OK = 0,
+	ROW_NO_TAB1,
+	ROW_NO_TAB2,
+	ROW_NO_TAB3,
+	ROW_BAD_ID,
+	ROW_BAD_MARK,
+	ROW_MARK_RANGE
+};
 
 /*
  * sanitize_field:
@@ -53,151 +56,550 @@ static void sanitize_field(char *dst, size_t cap, const char *src)
 }
 
 /*
- * opendb:
- * - Opens the given filename as a TSV ("ID<TAB>Name<TAB>Programme<TAB>Mark").
- * - Reads and parses each line into a Student struct.
- * - Inserts each student into the linked list using insert_node().
- * - Skips malformed lines and prints an error to stderr.
+ * write_sanitized:
+ * sanitize_field for a field of any length: writes src to f with the same
+ * characters replaced, a run at a time.
+ *
+ * Returns: 0 on success, -1 if the write failed
+ */
+static int write_sanitized(FILE *f, const char *src)
+{
+	while (*src)
+	{
+		size_t run = strcspn(src, "\t\n\r");
+		if (run && fwrite(src, 1, run, f) != run)
+			return -1;
+		src += run;
+		if (*src)
+		{
+			if (fputc(' ', f) == EOF)
+				return -1;
+			src++;
+		}
+	}
+	return 0;
+}
+
+/*
+ * copy_field:
+ * Copies a field that lives inside the file mapping (so it is not
+ * NUL-terminated) into dst, truncating to cap-1 characters.
+ */
+static void copy_field(char *dst, size_t cap, const char *src, size_t len)
+{
+	if (len > cap - 1)
+		len = cap - 1;
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+/*
+ * parse_row:
+ * Splits one data line "ID<TAB>Name<TAB>Programme<TAB>Mark" in place with
+ * memchr and fills *st. The line is not NUL-terminated and has already had
+ * its trailing '\r' / '\n' characters removed.
+ *
+ * ID and Mark are parsed in place by fast_parse_id / fast_parse_mark when
+ * they have the usual shape. Otherwise they are copied into a small local
+ * buffer for strtol / strtof, which need a terminator. Programme goes
+ * straight into *st; Name, which can be any length, into name (room for
+ * len + 1 bytes), which st->name then points at.
  *
  * Returns:
- *   -1  on fatal error (e.g. fopen or insert_node failure)
- *    0  on success
+ *   ROW_OK or one of the ROW_* reasons the line was rejected
  */
-int opendb(LinkedList *store, const char *filename, int fileOpened)
+static int parse_row(const char *line, size_t len, Student *st, char *name)
 {
-	FILE *f = fopen(filename, "r");
+	const char *end = line + len;
 
-	if (!f)
+	const char *f1 = line;                                   // field 1: ID
+	const char *t1 = memchr(f1, '\t', (size_t)(end - f1));   // find 1st TAB
+	if (!t1)
+		return ROW_NO_TAB1;
+
+	const char *f2 = t1 + 1;                                 // field 2: Name
+	const char *t2 = memchr(f2, '\t', (size_t)(end - f2));   // find 2nd TAB
+	if (!t2)
+		return ROW_NO_TAB2;
+
+	const char *f3 = t2 + 1;                                 // field 3: Programme
+	const char *t3 = memchr(f3, '\t', (size_t)(end - f3));   // find 3rd TAB
+	if (!t3)
+		return ROW_NO_TAB3;
+
+	const char *f4 = t3 + 1;                                 // field 4: Mark
+
+	char num[NUM_MAX];
+	char *endp = NULL;
+
+	/* ----- Parse ID (field 1) ----- */
+	// 7 plain digits take the SWAR fast path; anything else goes through strtol
+	if (!fast_parse_id(f1, (size_t)(t1 - f1), &st->id))
 	{
-		// If the file fails to open, I let perror show the system error.
-		perror("opendb failed");
-		return -1;
+		copy_field(num, sizeof num, f1, (size_t)(t1 - f1));
+		st->id = (int)strtol(num, &endp, 10);
+		if (endp == num)
+			return ROW_BAD_ID;    // no digits were read
 	}
 
-	char line[LINE_MAX];
+	/* ----- Copy Name (field 2) and Programme (field 3) ----- */
+	copy_field(name, len + 1, f2, (size_t)(t2 - f2));
+	st->name = name;
+	copy_field(st->programme, MAX_PROGRAM, f3, (size_t)(t3 - f3));
 
-	// Try to read the header line (e.g. "ID\tName\tProgramme\tMark")
-	if (!fgets(line, sizeof line, f))
+	/* ----- Parse Mark (field 4) ----- */
+	// "%.2f" marks as written by savedb take the fast path; anything else goes through strtof
+	if (!fast_parse_mark(f4, (size_t)(end - f4), &st->mark))
 	{
-		// If even the header can't be read, treat it as an empty file.
-		fclose(f);
-		puts("Empty File");
-		return 0;
+		copy_field(num, sizeof num, f4, (size_t)(end - f4));
+		st->mark = strtof(num, &endp);
+		if (endp == num)
+			return ROW_BAD_MARK;  // strtof didn't consume anything
 	}
+	if (!mark_fits(st->mark))
+		return ROW_MARK_RANGE;    // records keep marks in hundredths up to MARK_LIMIT
 
-	size_t line_no = 1;
-	size_t loaded  = 0;
+	return ROW_OK;
+}
 
-	// Read the file line by line starting from line 2 (actual data rows)
-	while (fgets(line, sizeof line, f))
+/*
+ * report_row_error:
+ * Prints the diagnostic for a line parse_row rejected.
+ */
+static void report_row_error(size_t line_no, int err)
+{
+	switch (err)
+	{
+	case ROW_NO_TAB1:
+		fprintf(stderr, "Line %zu: need 4 fields (no 1st TAB). Skipping.\n", line_no);
+		break;
+	case ROW_NO_TAB2:
+		fprintf(stderr, "Line %zu: need 4 fields (no 2nd TAB). Skipping.\n", line_no);
+		break;
+	case ROW_NO_TAB3:
+		fprintf(stderr, "Line %zu: need 4 fields (no 3rd TAB). Skipping.\n", line_no);
+		break;
+	case ROW_BAD_ID:
+		fprintf(stderr, "Line %zu: bad ID. Skipping.\n", line_no);
+		break;
+	case ROW_BAD_MARK:
+		fprintf(stderr, "Line %zu error Mark\n", line_no);
+		break;
+	}
+}
+
+/*
+ * RowSink:
+ * Callback that walk_lines hands every non-empty line to, already parsed.
+ * err is ROW_OK when *st is valid. Returning -1 stops the walk.
+ */
+typedef int (*RowSink)(void *ctx, size_t line, const Student *st, int err);
+
+/*
+ * walk_lines:
+ * Walks the lines in [p, end) with memchr, strips trailing '\r', skips empty
+ * lines and passes each parsed row to sink. Lines are numbered from 1
+ * relative to p. The number of lines seen is stored in *lines.
+ * The row's name lives in a buffer the walk reuses for every line, so a
+ * sink that keeps the row must copy the name.
+ *
+ * Returns:
+ *    0  when the whole range was walked
+ *   -1  if the sink asked to stop or memory ran out
+ */
+static int walk_lines(const char *p, const char *end, RowSink sink, void *ctx, size_t *lines)
+{
+	size_t line_no = 0;
+	char *name = NULL;  // big enough for the longest line so far
+	size_t name_cap = 0;
+	int rc = 0;
+
+	while (p < end)
 	{
+		const char *nl = memchr(p, '\n', (size_t)(end - p));
+		const char *line = p;
+		size_t len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+		p = nl ? nl + 1 : end;
 		line_no++;
-		rstrip(line);     // strip newline characters at the end
+
+		// strip '\r' characters at the end (files saved on Windows)
+		while (len && line[len - 1] == '\r')
+			len--;
 
 		// Skip completely empty lines
-		if (!*line)
+		if (len == 0)
 			continue;
 
-		// Now I split the line manually based on TABs into 4 fields: f1..f4
+		if (len >= name_cap)
+		{
+			size_t cap = name_cap ? name_cap : 64;
+			while (cap <= len)
+				cap *= 2;
+			char *grown = realloc(name, cap);
+			if (!grown)
+			{
+				rc = -1;
+				break;
+			}
+			name = grown;
+			name_cap = cap;
+		}
 
-		char *f1 = line;               // field 1: ID
-		char *t1 = strchr(f1, '\t');   // find 1st TAB
-		if (!t1)
+		Student st;
+		int err = parse_row(line, len, &st, name);
+		if (sink(ctx, line_no, &st, err) == -1)
 		{
-			fprintf(stderr, "Line %zu: need 4 fields (no 1st TAB). Skipping.\n", line_no);
-			continue;
+			rc = -1;
+			break;
 		}
-		*t1 = '\0';                    // terminate field 1
-		char *f2 = t1 + 1;             // field 2: Name
+	}
+
+	free(name);
+	*lines = line_no;
+	return rc;
+}
+
+typedef struct
+{
+	LinkedList *store;
+	size_t base;        // line number of the line before the range being walked
+	size_t loaded;
+} InsertCtx;
+
+/*
+ * insert_row:
+ * RowSink that reports bad rows and inserts good ones straight into the list.
+ */
+static int insert_row(void *ctx, size_t line, const Student *st, int err)
+{
+	InsertCtx *ic = ctx;
+	size_t line_no = ic->base + line;
 
-		char *t2 = strchr(f2, '\t');   // find 2nd TAB
-		if (!t2)
+	if (err == ROW_MARK_RANGE)
+	{
+		// Skipping it would lose the row for good at the next SAVE
+		fprintf(stderr, "Line %zu: mark %g of ID %d is outside 0 to %.2f, which a record can't hold. "
+		        "The file was not opened; fix or remove that row first.\n", line_no, st->mark, st->id, MARK_LIMIT);
+		return -1;
+	}
+	if (err != ROW_OK)
+	{
+		report_row_error(line_no, err);
+		STATS_ADD(STAT_RECORDS_REJECTED, 1);
+		return 0;
+	}
+
+	// Insert the parsed student into the linked list
+	int rc = insert_node(ic->store, st);
+	if (rc == -2)
+	{
+		// The id index refuses a second record with the same ID
+		fprintf(stderr, "Line %zu: duplicate ID %d. Skipping.\n", line_no, st->id);
+		STATS_ADD(STAT_RECORDS_REJECTED, 1);
+		return 0;
+	}
+	if (rc == -1)
+	{
+		// If insert_node fails, I treat it as fatal and stop reading further
+		return -1;
+	}
+	ic->loaded++;
+	return 0;
+}
+
+/* ---------- Parallel loading ---------- */
+
+#define PARALLEL_MIN_CHUNK (1u << 20)  // don't bother with threads below 1 MiB per chunk
+#define PARALLEL_MAX_CHUNKS 64
+
+static int load_threads = 0;           // 0 = decide from CMS_LOAD_THREADS / CPU count
+
+/*
+ * opendb_set_threads:
+ * Sets how many worker threads opendb may use to parse a file.
+ * 0 restores the default (CMS_LOAD_THREADS if set, otherwise one per CPU);
+ * 1 forces the serial loader.
+ */
+void opendb_set_threads(int threads)
+{
+	load_threads = threads < 0 ? 0 : threads;
+}
+
+static int effective_threads(void)
+{
+	if (load_threads > 0)
+		return load_threads;
+
+	const char *env = getenv("CMS_LOAD_THREADS");
+	if (env && atoi(env) > 0)
+		return atoi(env);
+	return cpu_count();
+}
+
+typedef struct
+{
+	Student st;
+	size_t line;        // line number relative to the chunk
+	int err;            // ROW_OK, or why the line was rejected (st only kept for ROW_MARK_RANGE)
+} ParsedRow;
+
+typedef struct
+{
+	const char *begin;  // newline-aligned slice of the file
+	const char *end;
+	ParsedRow *rows;    // every non-empty line, good or bad, in file order
+	size_t nrows;
+	size_t cap;
+	size_t lines;       // number of lines in the chunk
+	NameArena names;    // the kept rows' names, freed once they are in the list
+	int failed;         // ran out of memory
+} ParseBatch;
+
+/*
+ * batch_row:
+ * RowSink for the workers: keeps every row (and every rejection) in the
+ * batch so the main thread can replay them in file order.
+ */
+static int batch_row(void *ctx, size_t line, const Student *st, int err)
+{
+	ParseBatch *b = ctx;
+
+	if (b->nrows == b->cap)
+	{
+		size_t cap = b->cap ? b->cap * 2 : 1024;
+		ParsedRow *rows = realloc(b->rows, cap * sizeof *rows);
+		if (!rows)
 		{
-			fprintf(stderr, "Line %zu: need 4 fields (no 2nd TAB). Skipping.\n", line_no);
-			continue;
+			b->failed = 1;
+			return -1;
 		}
-		*t2 = '\0';                    // terminate field 2
-		char *f3 = t2 + 1;             // field 3: Programme
+		b->rows = rows;
+		b->cap  = cap;
+	}
 
-		char *t3 = strchr(f3, '\t');   // find 3rd TAB
-		if (!t3)
+	ParsedRow *r = &b->rows[b->nrows];
+	if (err == ROW_OK || err == ROW_MARK_RANGE)
+	{
+		r->st = *st;
+		if (!(r->st.name = arena_store(&b->names, st->name)))
 		{
-			fprintf(stderr, "Line %zu: need 4 fields (no 3rd TAB). Skipping.\n", line_no);
-			continue;
+			b->failed = 1;
+			return -1;
 		}
-		*t3 = '\0';                    // terminate field 3
-		char *f4 = t3 + 1;             // field 4: Mark
+	}
+	b->nrows++;
+	r->line = line;
+	r->err  = err;
+	return 0;
+}
 
-		Student st;
+static void parse_worker(void *ctx, int worker)
+{
+	ParseBatch *b = (ParseBatch *)ctx + worker;
+	if (walk_lines(b->begin, b->end, batch_row, b, &b->lines) == -1)
+		b->failed = 1;
+}
+
+/*
+ * load_parallel:
+ * Splits [p, end) into nchunks newline-aligned slices, parses them on
+ * worker threads into per-chunk batches, then splices the batches into the
+ * list in file order. Because rows and rejections are replayed in order
+ * with their line numbers, the list and the diagnostics come out exactly
+ * as the serial loader would produce them.
+ *
+ * Returns:
+ *   0 on success, -1 on allocation failure
+ */
+static int load_parallel(InsertCtx *ic, const char *p, const char *end, int nchunks)
+{
+	ParseBatch batches[PARALLEL_MAX_CHUNKS];
+	size_t total = (size_t)(end - p);
+	const char *cut = p;
 
-		/* ----- Parse ID (field 1) ----- */
-		char *endp = NULL;
-		st.id = (int)strtol(f1, &endp, 10);
-		if (endp == f1)
+	for (int i = 0; i < nchunks; i++)
+	{
+		ParseBatch *b = &batches[i];
+		memset(b, 0, sizeof *b);
+		arena_init(&b->names);
+		b->begin = cut;
+
+		if (i == nchunks - 1)
 		{
-			// If no digits were read, the ID is invalid
-			fprintf(stderr, "Line %zu: bad ID. Skipping.\n", line_no);
-			continue;
+			cut = end;
 		}
+		else
+		{
+			// aim for an even split, then move forward to the next line start
+			const char *aim = p + total / (size_t)nchunks * (size_t)(i + 1);
+			if (aim < cut)
+				aim = cut;
+			const char *nl = memchr(aim, '\n', (size_t)(end - aim));
+			cut = nl ? nl + 1 : end;
+		}
+		b->end = cut;
+	}
 
-		/* ----- Copy Name (field 2) ----- */
-		strncpy(st.name, f2, MAX_NAME - 1);
-		st.name[MAX_NAME - 1] = '\0';
+	parallel_run(nchunks, parse_worker, batches);
+
+	int rc = 0;
+	for (int i = 0; i < nchunks; i++)
+	{
+		ParseBatch *b = &batches[i];
 
-		/* ----- Copy Programme (field 3) ----- */
-		strncpy(st.programme, f3, MAX_PROGRAM - 1);
-		st.programme[MAX_PROGRAM - 1] = '\0';
+		if (rc == 0 && b->failed)
+			rc = -1;
 
-		/* ----- Parse Mark (field 4) ----- */
-		endp = NULL;
-		st.mark = (float)strtof(f4, &endp);
-		if (endp == f4)
+		for (size_t r = 0; rc == 0 && r < b->nrows; r++)
 		{
-			// If strtof doesn't consume anything, the mark is invalid
-			fprintf(stderr, "Line %zu error Mark\n", line_no);
-			continue;
+			if (insert_row(ic, b->rows[r].line, &b->rows[r].st, b->rows[r].err) == -1)
+				rc = -1;
 		}
 
-		// Insert the parsed student into the linked list
-		if (insert_node(store, &st) == -1)
-		{
-			// If insert_node fails, I treat it as fatal and stop reading further
-			fclose(f);
+		ic->base += b->lines;
+		free(b->rows);
+		arena_free(&b->names);
+	}
+	return rc;
+}
+
+/*
+ * load_db:
+ * - Opens the given filename as a TSV ("ID<TAB>Name<TAB>Programme<TAB>Mark").
+ * - Maps the whole file into memory (map_file) and walks it with memchr,
+ *   so there is no per-line stdio call and no limit on line length.
+ * - Large files are parsed on several threads (see load_parallel); the
+ *   result is the same as parsing them line by line.
+ * - Files starting with the "CMSB" magic are binary snapshots and are handed
+ *   to snapshot_load instead.
+ * - Parses each data line into a Student and inserts it with insert_node().
+ * - Skips malformed lines and prints an error to stderr. A mark outside
+ *   what a record can hold (see mark_fits) is fatal instead: skipping it
+ *   would silently drop the row from the file at the next SAVE.
+ *
+ * Returns:
+ *   -1  on fatal error (e.g. the file can't be opened or insert_node fails)
+ *    0  on success
+ */
+static int load_db(LinkedList *store, const char *filename, int fileOpened)
+{
+	FileMap fm;
+
+	if (map_file(&fm, filename) == -1)
+	{
+		// If the file fails to open, I let perror show the system error.
+		perror("opendb failed");
+		return -1;
+	}
+	STATS_ADD(STAT_BYTES_READ, fm.size);
+
+	if (fm.size == 0)
+	{
+		// Not even a header line: treat it as an empty file.
+		unmap_file(&fm);
+		puts("Empty File");
+		return 0;
+	}
+
+	// Binary snapshots are recognised by their magic bytes, whatever the file is called
+	if (snapshot_is_binary(fm.data, fm.size))
+	{
+		size_t loaded;
+		int rc = snapshot_load(store, fm.data, fm.size, &loaded);
+		unmap_file(&fm);
+		if (rc == -1)
 			return -1;
-		}
-		loaded++;
+		STATS_ADD(STAT_RECORDS_LOADED, loaded);
+		if (fileOpened == 0)
+			printf("File has been successfully opened and read. Loaded %zu record(s).\n", loaded);
+		return 0;
 	}
 
-	fclose(f);
+	const char *p   = fm.data;
+	const char *end = fm.data + fm.size;
+
+	// Skip the header line (e.g. "ID\tName\tProgramme\tMark")
+	const char *nl = memchr(p, '\n', fm.size);
+	p = nl ? nl + 1 : end;
+
+	// Data rows start on line 2
+	InsertCtx ic = { store, 1, 0 };
+
+	size_t chunks = (size_t)(end - p) / PARALLEL_MIN_CHUNK;
+	size_t threads = (size_t)effective_threads();
+	if (chunks > threads)
+		chunks = threads;
+	if (chunks > PARALLEL_MAX_CHUNKS)
+		chunks = PARALLEL_MAX_CHUNKS;
+
+	int rc;
+	if (chunks > 1)
+	{
+		rc = load_parallel(&ic, p, end, (int)chunks);
+	}
+	else
+	{
+		size_t lines;
+		rc = walk_lines(p, end, insert_row, &ic, &lines);
+	}
+
+	unmap_file(&fm);
+	STATS_ADD(STAT_RECORDS_LOADED, ic.loaded);
+	if (rc == -1)
+		return -1;
 
 	// Only print this message when the file is first opened
 	if (fileOpened == 0)
 	{
-		printf("File has been successfully opened and read. Loaded %zu record(s).\n", loaded);
+		printf("File has been successfully opened and read. Loaded %zu record(s).\n", ic.loaded);
 	}
 	return 0;
 }
 
 /*
- * savedb:
+ * opendb:
+ * - Loads filename into store (see load_db). The ordered indexes are
+ *   built once after the last row instead of being updated row by row.
+ * - On a fatal error the rows read so far are dropped again, so store is
+ *   never left holding part of a file.
+ *
+ * Returns:
+ *   -1  on fatal error (store left empty)
+ *    0  on success
+ */
+int opendb(LinkedList *store, const char *filename, int fileOpened)
+{
+	list_begin_bulk(store);
+	int rc = load_db(store, filename, fileOpened);
+	list_end_bulk(store);
+	if (rc == -1)
+		list_clear(store);
+	return rc;
+}
+
+/*
+ * save_tsv:
  * - Saves the current linked list into a TSV file.
  * - Writes a header row, then one line per student:
  *       ID<TAB>Name<TAB>Programme<TAB>Mark
  * - Uses sanitize_field() to make sure Name and Programme don't contain
  *   any tabs or newlines which might corrupt the TSV format.
+ * - Writes to "<filename>.tmp" and only renames it over filename once it is
+ *   fsynced (replace_commit), so a failed save leaves the old file intact.
  *
  * Returns:
  *   -1  on failure
  *    0  on success
  */
-int savedb(LinkedList *store, const char *filename)
+static int save_tsv(LinkedList *store, const char *filename)
 {
-	FILE *f = fopen(filename, "w");
+	FileReplace out;
+	FILE *f = replace_open(&out, filename, "w");
 
 	if (!f)
 	{
 		// Include filename in the error to make debugging easier
-		fprintf(stderr, "savedb: fopen(\"%s\") failed: ", filename);
+		fprintf(stderr, "savedb: fopen(\"%s.tmp\") failed: ", filename);
 		perror("");
 		return -1;
 	}
@@ -206,121 +608,427 @@ int savedb(LinkedList *store, const char *filename)
 	if (fprintf(f, "ID\tName\tProgramme\tMark\n") < 0)
 	{
 		perror("savedb:fprintf(header)");
-		fclose(f);
+		replace_abort(&out);
 		return -1;
 	}
 
 	// Write each student as a single line
 	// (The ternary handles the case where store might be NULL)
-	for (Node *p = store ? store->head : NULL; p; p = p->next)
+	for (Node *p = store ? list_node(store, store->head) : NULL; p; p = list_node(store, p->next))
 	{
-		// Make sure we treat the struct fields as NUL-terminated,
-		// even if they are "full".
-		char name_src[MAX_NAME + 1];
+		// Make sure we treat the programme as NUL-terminated,
+		// even if it is "full".
 		char prog_src[MAX_PROGRAM + 1];
 
-		memcpy(name_src, p->s.name, MAX_NAME);
-		name_src[MAX_NAME] = '\0';
-
-		memcpy(prog_src, p->s.programme, MAX_PROGRAM);
+		strncpy(prog_src, record_programme(&p->s), MAX_PROGRAM);
 		prog_src[MAX_PROGRAM] = '\0';
 
 		// Sanitize in order to remove any tabs/newlines which will break the TSV file
-		char name_san[MAX_NAME + 1], prog_san[MAX_PROGRAM + 1];
-		sanitize_field(name_san, sizeof name_san, name_src);
+		// (the name has no length limit, so it is cleaned as it is written)
+		char prog_san[MAX_PROGRAM + 1];
 		sanitize_field(prog_san, sizeof prog_san, prog_src);
 
 		// Actually write the four fields into one TSV line
-		if (fprintf(f, "%d\t%s\t%s\t%.2f\n", p->s.id, name_san, prog_san, p->s.mark) < 0)
+		if (fprintf(f, "%d\t", p->s.id) < 0 || write_sanitized(f, p->s.name) == -1 ||
+		    fprintf(f, "\t%s\t%.2f\n", prog_san, record_mark(&p->s)) < 0)
 		{
 			perror("savedb:fprintf");
-			fclose(f);
+			replace_abort(&out);
 			return -1;
 		}
 	}
 
-	// Always check fclose to make sure the buffer actually flushed to disk
-	if (fclose(f) != 0)
+	long bytes = ftell(f);
+
+	// Flush, fsync and rename over the old file; only then is it saved
+	if (replace_commit(&out) != 0)
 	{
-		perror("savedb:fclose");
+		perror("savedb:commit");
 		return -1;
 	}
+	STATS_ADD(STAT_BYTES_SAVED, bytes);
 	return 0;
 }
 
 /*
- * autoSave:
- * - Convenience wrapper that autosaves the current list to "autosave.txt".
- * - Only runs if a file is already opened (based on fileOpened flag).
- * - Uses savedb() internally.
+ * format_for_new_file:
+ * Picks the format for a file that is about to be created: binary for the
+ * ".cmsb" extension, TSV for anything else.
+ */
+DbFormat format_for_new_file(const char *filename)
+{
+	size_t n = strlen(filename), e = strlen(SNAPSHOT_EXT);
+	if (n >= e && strcmp(filename + n - e, SNAPSHOT_EXT) == 0)
+		return DB_FORMAT_BINARY;
+	return DB_FORMAT_TSV;
+}
+
+/*
+ * detect_format:
+ * Looks at the magic bytes of an existing file so that SAVE writes back in
+ * the format the file already has. Files that don't exist yet fall back to
+ * format_for_new_file().
+ */
+static DbFormat detect_format(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f)
+		return format_for_new_file(filename);
+
+	char magic[SNAPSHOT_MAGIC_LEN];
+	size_t got = fread(magic, 1, sizeof magic, f);
+	fclose(f);
+	return snapshot_is_binary(magic, got) ? DB_FORMAT_BINARY : DB_FORMAT_TSV;
+}
+
+/*
+ * savedb_as:
+ * - Saves the list in an explicit format: TSV (save_tsv) or a binary
+ *   snapshot written with a single write (snapshot_save).
+ *
+ * Returns:
+ *   -1  on failure
+ *    0  on success
+ */
+int savedb_as(LinkedList *store, const char *filename, DbFormat format)
+{
+	if (format == DB_FORMAT_BINARY)
+		return snapshot_save(store, filename);
+	return save_tsv(store, filename);
+}
+
+/*
+ * savedb:
+ * - Saves the list back in the format the file on disk already uses, so a
+ *   database opened from a snapshot stays a snapshot.
  *
  * Returns:
- *   -1  if autosave failed
- *    0  if autosave succeeded
- *   (no explicit return if fileOpened == 0; I currently only autosave when open)
+ *   -1  on failure
+ *    0  on success
  */
-int autoSave(LinkedList *list, int fileOpened)
+int savedb(LinkedList *store, const char *filename)
 {
-	if (fileOpened)
+	return savedb_as(store, filename, detect_format(filename));
+}
+
+/*
+ * convertdb:
+ * - Loads src (TSV or snapshot, detected by magic bytes) into a scratch list
+ *   and writes it to dst in the format given by dst's extension
+ *   (".cmsb" = binary snapshot, anything else = TSV).
+ * - The open database is not touched.
+ *
+ * Returns:
+ *   -1  on failure
+ *    0  on success
+ */
+int convertdb(const char *src, const char *dst)
+{
+	LinkedList tmp;
+	list_init(&tmp);
+
+	int rc = opendb(&tmp, src, 1);
+	if (rc == 0)
+		rc = savedb_as(&tmp, dst, format_for_new_file(dst));
+
+	list_clear(&tmp);
+	return rc;
+}
+
+/* ---------- IMPORT ---------- */
+
+typedef struct
+{
+	Student st;         // st.name is name (set again before use: rows move as they grow)
+	char name[NAME_LIMIT + 1];
+	size_t line;
+	const char *err;    // NULL if the row is accepted
+	size_t first;       // for a repeated ID: the line it first appeared on
+} ImportRow;
+
+/*
+ * split_import_row:
+ * Splits one TSV or CSV line into exactly four fields, dropping surrounding
+ * spaces and double quotes, and checks them with the same rules INSERT uses.
+ *
+ * Returns:
+ *   NULL if *st was filled in, otherwise the reason the row was rejected
+ */
+static const char *split_import_row(const char *line, size_t len, char delim, Student *st,
+                                    char name[NAME_LIMIT + 1])
+{
+	const char *field[4];
+	size_t flen[4];
+	const char *end = line + len;
+	const char *f = line;
+
+	for (int i = 0; i < 4; i++)
 	{
-		int result = savedb(list, "autosave.txt");
-		if (result == -1)
+		const char *d = memchr(f, delim, (size_t)(end - f));
+		if ((i < 3 && !d) || (i == 3 && d))
+			return "need exactly 4 fields.";
+		const char *fe = d ? d : end;
+
+		const char *b = f, *e = fe;
+		while (b < e && (*b == ' ' || *b == '\t'))
+			b++;
+		while (e > b && (e[-1] == ' ' || e[-1] == '\t'))
+			e--;
+		if (e - b >= 2 && *b == '"' && e[-1] == '"')
 		{
-			printf("Error: Autosave failed.\n");
-			return -1;
+			b++;
+			e--;
 		}
-		printf("CMS: Autosave completed. (autosave.txt updated) \n");
-		return 0;
+		field[i] = b;
+		flen[i] = (size_t)(e - b);
+		f = fe + 1;
 	}
 
-	// If file is not opened, I silently do nothing here.
-	// (Could be extended to print a message or return a specific code.)
+	return check_record(field, flen, st, name);
+}
+
+// qsort order for duplicate detection: by ID, then by line
+static int by_id_then_line(const void *a, const void *b)
+{
+	const ImportRow *x = *(const ImportRow *const *)a;
+	const ImportRow *y = *(const ImportRow *const *)b;
+	if (x->st.id != y->st.id)
+		return x->st.id < y->st.id ? -1 : 1;
+	return x->line < y->line ? -1 : (x->line > y->line);
 }
 
 /*
- * recoverChanges:
- * - Compares the contents of the main DB file (dbFile) and the autosave file
- *   (asFile) character by character.
- * - This helps me detect if the autosave version has diverged from the
- *   original file on disk.
+ * importdb:
+ * - Adds the records in a TSV or CSV file (delimiter taken from the first
+ *   line, which is skipped if it is a header) to the open database.
+ * - Every row is checked with the INSERT rules first. Duplicate IDs are
+ *   then found for the whole file at once: one sort catches IDs repeated
+ *   inside the file (the first occurrence wins) and one index lookup per
+ *   row catches IDs that already exist.
+ * - Accepted rows are inserted in file order after reserving room in the
+ *   id index, and are journaled under a single autosave.
+ * - Rejected rows are listed with their line numbers.
  *
  * Returns:
- *    0  if files are identical
- *    1  if there's at least one differing character
- *   -1  if opening either file fails
+ *   -1  if the file can't be read or memory runs out
+ *    0  otherwise (*imported = number of records added)
  */
-int recoverChanges(const char *dbFile, const char *asFile)
+int importdb(LinkedList *store, const char *filename, Autosave *autosave, size_t *imported)
 {
-	FILE *fdb, *fas;
-	int char1, char2;
-	int result = 0;  // assume equal until we find a mismatch
+	FileMap fm;
+	*imported = 0;
+
+	if (map_file(&fm, filename) == -1)
+	{
+		perror("importdb failed");
+		return -1;
+	}
+	STATS_ADD(STAT_BYTES_READ, fm.size);
+	if (snapshot_is_binary(fm.data, fm.size))
+	{
+		unmap_file(&fm);
+		printf("CMS: %s is a binary snapshot, IMPORT reads TSV or CSV files.\n", filename);
+		return -1;
+	}
 
-	fdb = fopen(dbFile, "r");
-	fas = fopen(asFile, "r");
+	const char *p   = fm.data;
+	const char *end = fm.data + fm.size;
 
-	if (fdb == NULL || fas == NULL)
+	// The first line decides the delimiter and whether there is a header
+	const char *nl = memchr(p, '\n', fm.size);
+	const char *first_end = nl ? nl : end;
+	char delim = memchr(p, '\t', (size_t)(first_end - p)) ? '\t' : ',';
+	const char *q = p;
+	while (q < first_end && (*q == ' ' || *q == '"'))
+		q++;
+	size_t line_no = 0;
+	if (q < first_end && !isdigit((unsigned char)*q))
 	{
-		// If either file can't be opened, I treat that as an error
-		perror("Error opening files.\n");
+		p = nl ? nl + 1 : end;
+		line_no = 1;
+	}
+
+	// Pass 1: split and validate every row
+	ImportRow *rows = NULL;
+	size_t nrows = 0, cap = 0;
+	while (p < end)
+	{
+		nl = memchr(p, '\n', (size_t)(end - p));
+		const char *line = p;
+		size_t len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+		p = nl ? nl + 1 : end;
+		line_no++;
+
+		while (len && line[len - 1] == '\r')
+			len--;
+		if (len == 0)
+			continue;
+
+		if (nrows == cap)
+		{
+			cap = cap ? cap * 2 : 1024;
+			ImportRow *grown = realloc(rows, cap * sizeof *rows);
+			if (!grown)
+			{
+				free(rows);
+				unmap_file(&fm);
+				puts("CMS: Memory allocation failed.");
+				return -1;
+			}
+			rows = grown;
+		}
+		ImportRow *r = &rows[nrows++];
+		r->line = line_no;
+		r->first = 0;
+		r->err = split_import_row(line, len, delim, &r->st, r->name);
+	}
+	unmap_file(&fm);
+
+	// Pass 2: duplicate IDs, for the whole file at once
+	ImportRow **order = malloc((nrows ? nrows : 1) * sizeof *order);
+	if (!order)
+	{
+		free(rows);
+		puts("CMS: Memory allocation failed.");
 		return -1;
 	}
+	size_t valid = 0;
+	for (size_t i = 0; i < nrows; i++)
+	{
+		if (!rows[i].err)
+			order[valid++] = &rows[i];
+	}
+	qsort(order, valid, sizeof *order, by_id_then_line);
 
-	// Read both files one character at a time and compare
-	do
+	size_t accepted = 0;
+	for (size_t i = 0; i < valid; i++)
 	{
-		char1 = fgetc(fdb);
-		char2 = fgetc(fas);
+		ImportRow *r = order[i];
+		if (i > 0 && order[i - 1]->st.id == r->st.id)
+		{
+			r->err = "duplicate ID in the file";
+			r->first = order[i - 1]->first;
+		}
+		else
+		{
+			r->first = r->line;
+			if (list_find_by_id(store, r->st.id))
+				r->err = "ID already exists in the database.";
+			else
+				accepted++;
+		}
+	}
+	free(order);
 
-		if (char1 != char2)
+	// Pass 3: insert in file order, journaled as one autosave
+	if (index_reserve(&store->index, &store->pool, store->index.count + accepted) == -1)
+	{
+		free(rows);
+		puts("CMS: Memory allocation failed.");
+		return -1;
+	}
+
+	int rc = 0;
+	size_t rejected = 0;
+	autosave_hold(autosave, 1);
+	for (size_t i = 0; i < nrows; i++)
+	{
+		ImportRow *r = &rows[i];
+		if (r->err == NULL)
 		{
-			// As soon as we detect a mismatch, we mark result as different
-			result = 1;
-			break;
+			r->st.name = r->name;
+			if (insert_node(store, &r->st) != 0)
+			{
+				puts("CMS: Memory allocation failed.");
+				rc = -1;
+				break;
+			}
+			autoSave(autosave, JOURNAL_INSERT, &r->st, 1);
+			(*imported)++;
 		}
-	} while (char1 != EOF && char2 != EOF);
-	
+		else if (r->first && r->first != r->line)
+		{
+			printf("Line %zu: %s (first on line %zu). Skipping.\n", r->line, r->err, r->first);
+			rejected++;
+		}
+		else
+		{
+			printf("Line %zu: %s Skipping.\n", r->line, r->err);
+			rejected++;
+		}
+	}
+	autosave_hold(autosave, 0);
+	free(rows);
+	STATS_ADD(STAT_RECORDS_LOADED, *imported);
+	STATS_ADD(STAT_RECORDS_REJECTED, rejected);
+
+	printf("CMS: Imported %zu record(s) from %s, %zu rejected.\n", *imported, filename, rejected);
+	return rc;
+}
+
+/*
+ * autoSave:
+ * - Records one change in the write-ahead journal instead of rewriting the
+ *   whole database: an INSERT/UPDATE carries the record as it now is, a
+ *   DELETE just its ID.
+ * - The change is copied and handed to the autosave worker, which appends
+ *   and syncs it in the background, so the command loop never waits for the
+ *   disk. Completion or failure is printed by autosave_report.
+ * - Only runs if a file is already opened (based on fileOpened flag).
+ *
+ * Returns:
+ *   -1  if the change could not be queued
+ *    0  if it was queued or no file is open
+ */
+int autoSave(Autosave *autosave, JournalOp op, const Student *st, int fileOpened)
+{
+	if (!fileOpened)
+	{
+		// If file is not opened, I silently do nothing here.
+		return 0;
+	}
+
+	if (autosave_submit(autosave, op, st) == -1)
+	{
+		printf("Error: Autosave failed.\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * recoverChanges:
+ * - Checks whether the journal holds changes that were never SAVEd into
+ *   the main DB file (dbFile), e.g. because the program was closed or
+ *   crashed without SAVE.
+ * - Only the journal's header and first entry are read, so when nothing
+ *   changed this takes the same time whatever the size of the database.
+ * - When there are changes, the DB file's size and then content hash are
+ *   compared with the fingerprint stored in the journal header, and a
+ *   warning is printed if the file was changed behind the journal's back.
+ *
+ * Returns:
+ *    0  if there is nothing to recover
+ *    1  if the journal has at least one entry to replay
+ *   -1  if the DB file can't be opened
+ */
+int recoverChanges(const char *dbFile, const char *journalFile)
+{
+	FILE *fdb = fopen(dbFile, "r");
+	if (fdb == NULL)
+	{
+		perror("Error opening files.\n");
+		return -1;
+	}
 	fclose(fdb);
-	fclose(fas);
 
-	return result;
+	JournalInfo info;
+	if (journal_probe(journalFile, &info) == -1 || info.entries == 0)
+		return 0;
+
+	if (!journal_base_matches(&info, dbFile))
+	{
+		printf("CMS: Warning: %s was modified outside the CMS after these changes were recorded.\n", dbFile);
+	}
+	return 1;
 }
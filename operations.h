@@ -2,13 +2,30 @@
 #define OPERATIONS_H
 
 #include "linked_list.h"
+#include "journal.h"
+#include "autosave.h"
 
 int opendb(LinkedList* store, const char* filename, int fileOpened);
 
+void opendb_set_threads(int threads);
+
+typedef enum {
+    DB_FORMAT_TSV,      // tab-separated text, the interchange format
+    DB_FORMAT_BINARY    // .cmsb snapshot (see snapshot.c)
+} DbFormat;
+
 int savedb(LinkedList *store, const char *filename);
 
-int autoSave(LinkedList *list, int fileOpened);
+int savedb_as(LinkedList *store, const char *filename, DbFormat format);
+
+DbFormat format_for_new_file(const char *filename);
+
+int convertdb(const char *src, const char *dst);
+
+int importdb(LinkedList *store, const char *filename, Autosave *autosave, size_t *imported);
+
+int autoSave(Autosave *autosave, JournalOp op, const Student *st, int fileOpened);
 
-int recoverChanges(const char *dbFile, const char *autoSaveFile);
+int recoverChanges(const char *dbFile, const char *journalFile);
 
 #endif
\ No newline at end of file
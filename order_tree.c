@@ -0,0 +1,388 @@
+#include "order_tree.h"
+#include <stdlib.h>
+
+/*
+ * A treap: a binary search tree on cmp that is also a min-heap on random
+ * priorities, which keeps it balanced in expectation without any
+ * rebalancing bookkeeping. Every link also stores the size of its subtree,
+ * which turns "k-th smallest" and "how many are smaller" into one descent.
+ *
+ * Members are numbers rather than pointers: a list's pool slots. Their
+ * links live in pages the tree owns, so a member costs the list nothing
+ * but 16 bytes per tree, and the priority is a hash of the member's number
+ * instead of being stored.
+ */
+
+static TreeLink* link_of(const OrderTree* t, uint32_t x)
+{
+    return &t->pages[x >> TREE_PAGE_SHIFT][x & (TREE_PAGE - 1)];
+}
+
+static size_t sz(const OrderTree* t, uint32_t x)
+{
+    return x != TREE_NIL ? link_of(t, x)->size : 0;
+}
+
+static void resize(const OrderTree* t, uint32_t x)
+{
+    TreeLink* l = link_of(t, x);
+    l->size = 1 + sz(t, l->left) + sz(t, l->right);
+}
+
+// A bijective 32-bit mix (murmur3's finaliser), so no two members share a priority
+static uint32_t prio(const OrderTree* t, uint32_t x)
+{
+    uint32_t h = x ^ t->seed;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/*
+ * tree_init:
+ * - Starts an empty tree ordered by cmp, which is handed ctx along with
+ *   the two members it compares. No pages are allocated yet.
+ */
+void tree_init(OrderTree* t, TreeCmp cmp, const void* ctx)
+{
+    t->pages = NULL;
+    t->npages = t->page_cap = 0;
+    t->root = TREE_NIL;
+    t->cmp  = cmp;
+    t->ctx  = ctx;
+    t->seed = 2463534242u;
+}
+
+/*
+ * tree_free:
+ * - Frees the link pages and leaves an empty tree with the same order.
+ */
+void tree_free(OrderTree* t)
+{
+    for (size_t i = 0; i < t->npages; i++) {
+        free(t->pages[i]);
+    }
+    free(t->pages);
+    tree_init(t, t->cmp, t->ctx);
+}
+
+/*
+ * tree_reserve:
+ * - Makes sure member x has a link, allocating pages up to its own. Call
+ *   it when the member number is handed out, so inserting never fails.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if memory ran out
+ */
+int tree_reserve(OrderTree* t, uint32_t x)
+{
+    size_t page = x >> TREE_PAGE_SHIFT;
+    while (t->npages <= page) {
+        if (t->npages == t->page_cap) {
+            size_t cap = t->page_cap ? t->page_cap * 2 : 16;
+            TreeLink** pages = realloc(t->pages, cap * sizeof *pages);
+            if (!pages) {
+                return -1;
+            }
+            t->pages = pages;
+            t->page_cap = cap;
+        }
+        if (!(t->pages[t->npages] = malloc(TREE_PAGE * sizeof(TreeLink)))) {
+            return -1;
+        }
+        t->npages++;
+    }
+    return 0;
+}
+
+/*
+ * tree_clear:
+ * - Empties the tree but keeps its pages for the members to come back.
+ */
+void tree_clear(OrderTree* t)
+{
+    t->root = TREE_NIL;
+}
+
+size_t tree_size(const OrderTree* t)
+{
+    return sz(t, t->root);
+}
+
+/*
+ * replace_child:
+ * - Points whatever referred to old (its parent, or the root) at x instead.
+ */
+static void replace_child(OrderTree* t, uint32_t parent, uint32_t old, uint32_t x)
+{
+    if (parent == TREE_NIL) {
+        t->root = x;
+    } else if (link_of(t, parent)->left == old) {
+        link_of(t, parent)->left = x;
+    } else {
+        link_of(t, parent)->right = x;
+    }
+    if (x != TREE_NIL) {
+        link_of(t, x)->parent = parent;
+    }
+}
+
+/*
+ * rotate_up:
+ * - Rotates x above its parent, keeping the BST order and both sizes right.
+ */
+static void rotate_up(OrderTree* t, uint32_t x)
+{
+    TreeLink* lx = link_of(t, x);
+    uint32_t p = lx->parent;
+    TreeLink* lp = link_of(t, p);
+
+    replace_child(t, lp->parent, p, x);
+    if (lp->left == x) {
+        lp->left = lx->right;
+        if (lx->right != TREE_NIL) {
+            link_of(t, lx->right)->parent = p;
+        }
+        lx->right = p;
+    } else {
+        lp->right = lx->left;
+        if (lx->left != TREE_NIL) {
+            link_of(t, lx->left)->parent = p;
+        }
+        lx->left = p;
+    }
+    lp->parent = x;
+
+    resize(t, p);
+    resize(t, x);
+}
+
+/*
+ * tree_insert:
+ * - Adds x (already reserved) as a leaf in BST position, then rotates it
+ *   up while its priority beats its parent's. Expected O(log n).
+ */
+void tree_insert(OrderTree* t, uint32_t x)
+{
+    TreeLink* lx = link_of(t, x);
+    lx->left = lx->right = TREE_NIL;
+    lx->size = 1;
+
+    uint32_t parent = TREE_NIL;
+    uint32_t* link = &t->root;
+    while (*link != TREE_NIL) {
+        parent = *link;
+        TreeLink* lp = link_of(t, parent);
+        lp->size++;
+        link = (t->cmp(t->ctx, x, parent) < 0) ? &lp->left : &lp->right;
+    }
+    *link = x;
+    lx->parent = parent;
+
+    uint32_t px = prio(t, x);
+    while (lx->parent != TREE_NIL && prio(t, lx->parent) > px) {
+        rotate_up(t, x);
+    }
+}
+
+/*
+ * tree_remove:
+ * - Rotates x down (always lifting the child with the smaller priority)
+ *   until it has at most one child, then splices it out. Expected O(log n).
+ */
+void tree_remove(OrderTree* t, uint32_t x)
+{
+    TreeLink* lx = link_of(t, x);
+    while (lx->left != TREE_NIL && lx->right != TREE_NIL) {
+        rotate_up(t, prio(t, lx->left) < prio(t, lx->right) ? lx->left : lx->right);
+    }
+
+    uint32_t parent = lx->parent;
+    replace_child(t, parent, x, lx->left != TREE_NIL ? lx->left : lx->right);
+
+    for (uint32_t p = parent; p != TREE_NIL; p = link_of(t, p)->parent) {
+        link_of(t, p)->size--;
+    }
+    lx->left = lx->right = lx->parent = TREE_NIL;
+}
+
+/*
+ * tree_build:
+ * - Replaces the tree with the n members of sorted, which are in cmp
+ *   order and already reserved. This is the treap's Cartesian tree, built
+ *   left to right with a stack of the rightmost path in O(n): a member
+ *   pops every member of higher priority and takes them as its left
+ *   subtree. A member's subtree is final once it is popped, so its size is
+ *   set then.
+ * - If the stack can't be allocated the members are inserted one by one.
+ */
+void tree_build(OrderTree* t, const uint32_t* sorted, size_t n)
+{
+    t->root = TREE_NIL;
+    uint32_t* stack = malloc((n ? n : 1) * sizeof *stack);
+    if (!stack) {
+        for (size_t i = 0; i < n; i++) {
+            tree_insert(t, sorted[i]);
+        }
+        return;
+    }
+
+    size_t top = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = sorted[i], last = TREE_NIL, px = prio(t, x);
+        TreeLink* lx = link_of(t, x);
+        while (top && prio(t, stack[top - 1]) > px) {
+            last = stack[--top];
+            resize(t, last);
+        }
+        lx->left = last;
+        lx->right = TREE_NIL;
+        if (last != TREE_NIL) {
+            link_of(t, last)->parent = x;
+        }
+        lx->parent = top ? stack[top - 1] : TREE_NIL;
+        if (top) {
+            link_of(t, stack[top - 1])->right = x;
+        }
+        stack[top++] = x;
+    }
+    if (top) {
+        t->root = stack[0];
+    }
+    while (top) {
+        resize(t, stack[--top]);
+    }
+    free(stack);
+}
+
+/*
+ * tree_at:
+ * - Finds the k-th smallest member (k counts from 0).
+ *
+ * Returns:
+ *   the member, or TREE_NIL if k >= size
+ */
+uint32_t tree_at(const OrderTree* t, size_t k)
+{
+    uint32_t x = t->root;
+    while (x != TREE_NIL) {
+        const TreeLink* lx = link_of(t, x);
+        size_t left = sz(t, lx->left);
+        if (k < left) {
+            x = lx->left;
+        } else if (k == left) {
+            return x;
+        } else {
+            k -= left + 1;
+            x = lx->right;
+        }
+    }
+    return TREE_NIL;
+}
+
+/*
+ * tree_rank:
+ * - Number of members that sort before x, found by walking from x to the root.
+ */
+size_t tree_rank(const OrderTree* t, uint32_t x)
+{
+    size_t r = sz(t, link_of(t, x)->left);
+    for (uint32_t p; (p = link_of(t, x)->parent) != TREE_NIL; x = p) {
+        if (link_of(t, p)->right == x) {
+            r += sz(t, link_of(t, p)->left) + 1;
+        }
+    }
+    return r;
+}
+
+/*
+ * tree_lower_bound:
+ * - First member that does not sort before key.
+ *
+ * Returns:
+ *   the member, or TREE_NIL if every member sorts before key
+ */
+uint32_t tree_lower_bound(const OrderTree* t, TreeBefore before, const void* key)
+{
+    uint32_t best = TREE_NIL;
+    for (uint32_t x = t->root; x != TREE_NIL; ) {
+        if (before(t->ctx, x, key)) {
+            x = link_of(t, x)->right;
+        } else {
+            best = x;
+            x = link_of(t, x)->left;
+        }
+    }
+    return best;
+}
+
+/*
+ * tree_count_before:
+ * - Number of members that sort before key, in one descent.
+ */
+size_t tree_count_before(const OrderTree* t, TreeBefore before, const void* key)
+{
+    size_t n = 0;
+    for (uint32_t x = t->root; x != TREE_NIL; ) {
+        const TreeLink* lx = link_of(t, x);
+        if (before(t->ctx, x, key)) {
+            n += sz(t, lx->left) + 1;
+            x = lx->right;
+        } else {
+            x = lx->left;
+        }
+    }
+    return n;
+}
+
+/*
+ * tree_next / tree_prev:
+ * - In-order successor / predecessor, or TREE_NIL at either end. Walking
+ *   k members this way costs O(k) amortised.
+ */
+uint32_t tree_next(const OrderTree* t, uint32_t x)
+{
+    const TreeLink* lx = link_of(t, x);
+    if (lx->right != TREE_NIL) {
+        x = lx->right;
+        while (link_of(t, x)->left != TREE_NIL) {
+            x = link_of(t, x)->left;
+        }
+        return x;
+    }
+    uint32_t p;
+    while ((p = link_of(t, x)->parent) != TREE_NIL && link_of(t, p)->right == x) {
+        x = p;
+    }
+    return p;
+}
+
+uint32_t tree_prev(const OrderTree* t, uint32_t x)
+{
+    const TreeLink* lx = link_of(t, x);
+    if (lx->left != TREE_NIL) {
+        x = lx->left;
+        while (link_of(t, x)->right != TREE_NIL) {
+            x = link_of(t, x)->right;
+        }
+        return x;
+    }
+    uint32_t p;
+    while ((p = link_of(t, x)->parent) != TREE_NIL && link_of(t, p)->left == x) {
+        x = p;
+    }
+    return p;
+}
+
+/*
+ * tree_bytes:
+ * - Memory held by the link pages and the page table.
+ */
+size_t tree_bytes(const OrderTree* t)
+{
+    return t->npages * TREE_PAGE * sizeof(TreeLink) + t->page_cap * sizeof *t->pages;
+}
@@ -0,0 +1,49 @@
+#ifndef ORDER_TREE_H
+#define ORDER_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TREE_NIL UINT32_MAX         // no member (the same value as POOL_NIL)
+#define TREE_PAGE_SHIFT 10
+#define TREE_PAGE (1u << TREE_PAGE_SHIFT)   // links per page
+
+typedef struct { //One member's place in a tree: 16 bytes, kept in the tree's own pages
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;
+    uint32_t size;          // members in this subtree, itself included
+} TreeLink;
+
+// Orders two members: <0, 0 or >0 like strcmp. Must be a total order.
+typedef int (*TreeCmp)(const void* ctx, uint32_t a, uint32_t b);
+
+// Nonzero if member x sorts before the search key (used by the lookups below)
+typedef int (*TreeBefore)(const void* ctx, uint32_t x, const void* key);
+
+typedef struct { //Order-statistic treap over 32-bit member numbers (a list's pool slots)
+    TreeLink** pages;       // page i holds the links of members i*TREE_PAGE and up
+    size_t npages, page_cap;
+    uint32_t root;
+    TreeCmp cmp;
+    const void* ctx;        // passed to cmp and to the lookups' before functions
+    uint32_t seed;          // mixed into every member's priority
+} OrderTree;
+
+void tree_init(OrderTree* t, TreeCmp cmp, const void* ctx);
+void tree_free(OrderTree* t);
+int tree_reserve(OrderTree* t, uint32_t x);
+void tree_clear(OrderTree* t);
+size_t tree_size(const OrderTree* t);
+void tree_insert(OrderTree* t, uint32_t x);
+void tree_remove(OrderTree* t, uint32_t x);
+void tree_build(OrderTree* t, const uint32_t* sorted, size_t n);
+uint32_t tree_at(const OrderTree* t, size_t k);
+size_t tree_rank(const OrderTree* t, uint32_t x);
+uint32_t tree_lower_bound(const OrderTree* t, TreeBefore before, const void* key);
+size_t tree_count_before(const OrderTree* t, TreeBefore before, const void* key);
+uint32_t tree_next(const OrderTree* t, uint32_t x);
+uint32_t tree_prev(const OrderTree* t, uint32_t x);
+size_t tree_bytes(const OrderTree* t);
+
+#endif
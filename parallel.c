@@ -0,0 +1,79 @@
+
+#include "parallel.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define MAX_WORKERS 64
+
+/*
+ * cpu_count:
+ * - Number of processors the OS reports as online (at least 1).
+ */
+int cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+typedef struct {
+    ParallelFn fn;
+    void* ctx;
+    int worker;
+} WorkerArg;
+
+static void* worker_main(void* p)
+{
+    WorkerArg* a = p;
+    a->fn(a->ctx, a->worker);
+    return NULL;
+}
+
+/*
+ * parallel_run:
+ * - Calls fn(ctx, 0) .. fn(ctx, workers - 1), each on its own thread, and
+ *   returns once all of them have finished.
+ * - Worker 0 runs on the calling thread. If a thread cannot be started its
+ *   share is run inline afterwards, so every worker index always runs once.
+ */
+void parallel_run(int workers, ParallelFn fn, void* ctx)
+{
+    if (workers < 1) {
+        workers = 1;
+    }
+    if (workers > MAX_WORKERS) {
+        workers = MAX_WORKERS;
+    }
+
+    pthread_t tids[MAX_WORKERS];
+    WorkerArg args[MAX_WORKERS];
+    int started[MAX_WORKERS] = { 0 };
+
+    for (int w = 1; w < workers; w++) {
+        args[w].fn = fn;
+        args[w].ctx = ctx;
+        args[w].worker = w;
+        started[w] = pthread_create(&tids[w], NULL, worker_main, &args[w]) == 0;
+    }
+
+    fn(ctx, 0);
+
+    for (int w = 1; w < workers; w++) {
+        if (started[w]) {
+            pthread_join(tids[w], NULL);
+        } else {
+            fn(ctx, w);
+        }
+    }
+}
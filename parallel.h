@@ -0,0 +1,9 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+typedef void (*ParallelFn)(void* ctx, int worker);
+
+int cpu_count(void);
+void parallel_run(int workers, ParallelFn fn, void* ctx);
+
+#endif
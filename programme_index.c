@@ -0,0 +1,178 @@
+
+#include "programme_index.h"
+#include "linked_list.h"
+#include <stdlib.h>
+
+#define PROGRAMME_MIN_CAP 16
+
+// Fibonacci hashing: keys are small consecutive ids, so spread them out
+static uint32_t key_hash(ProgrammeId key)
+{
+    return key * 2654435769u;
+}
+
+/*
+ * programme_index_init:
+ * - Starts the index off empty; slots are allocated on the first intern.
+ */
+void programme_index_init(ProgrammeIndex* ix)
+{
+    ix->slots = NULL;
+    ix->cap   = 0;
+    ix->count = 0;
+}
+
+/*
+ * programme_index_free:
+ * - Frees every group and the slot array. The member nodes belong to the list.
+ */
+void programme_index_free(ProgrammeIndex* ix)
+{
+    for (size_t i = 0; i < ix->cap; i++) {
+        free(ix->slots[i]);
+    }
+    free(ix->slots);
+    programme_index_init(ix);
+}
+
+/*
+ * grow:
+ * - Re-inserts every group into a slot array of new_cap entries.
+ *
+ * Returns:
+ *   0  on success, -1 if the allocation failed (the old table is kept)
+ */
+static int grow(ProgrammeIndex* ix, size_t new_cap)
+{
+    ProgrammeGroup** slots = calloc(new_cap, sizeof *slots);
+    if (!slots) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < ix->cap; i++) {
+        ProgrammeGroup* g = ix->slots[i];
+        if (!g) {
+            continue;
+        }
+        size_t j = key_hash(g->key) & (new_cap - 1);
+        while (slots[j]) {
+            j = (j + 1) & (new_cap - 1);
+        }
+        slots[j] = g;
+    }
+
+    free(ix->slots);
+    ix->slots = slots;
+    ix->cap   = new_cap;
+    return 0;
+}
+
+/*
+ * probe:
+ * - Linear probing from the key's home slot.
+ *
+ * Returns:
+ *   the slot holding the key's group, or the empty slot where it would go
+ */
+static ProgrammeGroup** probe(const ProgrammeIndex* ix, ProgrammeId key)
+{
+    size_t mask = ix->cap - 1;
+    for (size_t i = key_hash(key) & mask;; i = (i + 1) & mask) {
+        ProgrammeGroup* g = ix->slots[i];
+        if (!g || g->key == key) {
+            return &ix->slots[i];
+        }
+    }
+}
+
+/*
+ * programme_find:
+ * - Looks a programme up by key (programme_key, or programme_lookup for
+ *   text), so spellings that differ only in case find the same group.
+ *
+ * Returns:
+ *   the group (possibly with no members left), or NULL if it was never seen
+ */
+ProgrammeGroup* programme_find(const ProgrammeIndex* ix, ProgrammeId key)
+{
+    if (ix->cap == 0) {
+        return NULL;
+    }
+    return *probe(ix, key);
+}
+
+/*
+ * programme_intern:
+ * - Returns the group for programme's key, creating an empty one the first
+ *   time the key is seen. Groups are only dropped by programme_index_free,
+ *   so a pointer to one stays valid for the life of the list.
+ *
+ * Returns:
+ *   the group, or NULL if an allocation failed
+ */
+ProgrammeGroup* programme_intern(ProgrammeIndex* ix, ProgrammeId programme)
+{
+    if ((ix->count + 1) * 10 > ix->cap * 7) {
+        if (grow(ix, ix->cap ? ix->cap * 2 : PROGRAMME_MIN_CAP) == -1) {
+            return NULL;
+        }
+    }
+
+    ProgrammeId key = programme_key(programme);
+    ProgrammeGroup** slot = probe(ix, key);
+    if (*slot) {
+        return *slot;
+    }
+
+    ProgrammeGroup* g = malloc(sizeof *g);
+    if (!g) {
+        return NULL;
+    }
+    g->head  = g->tail = POOL_NIL;
+    g->count = 0;
+    g->ordinal = ix->count;
+    g->key = key;
+    g->spelling = programme;
+
+    *slot = g;
+    ix->count++;
+    return g;
+}
+
+/*
+ * group_append:
+ * - Adds n at the end of g's member list.
+ */
+void group_append(ProgrammeGroup* g, NodePool* pool, Node* n)
+{
+    n->group_next = POOL_NIL;
+    n->group_prev = g->tail;
+    if (g->tail != POOL_NIL) {
+        POOL_NODE(pool, g->tail)->group_next = n->slot;
+    } else {
+        g->head = n->slot;
+    }
+    g->tail = n->slot;
+    g->count++;
+}
+
+/*
+ * group_unlink:
+ * - Takes n out of g, the group it is in, in O(1).
+ */
+void group_unlink(ProgrammeGroup* g, NodePool* pool, Node* n)
+{
+    if (n->group_prev != POOL_NIL) {
+        POOL_NODE(pool, n->group_prev)->group_next = n->group_next;
+    } else {
+        g->head = n->group_next;
+    }
+    if (n->group_next != POOL_NIL) {
+        POOL_NODE(pool, n->group_next)->group_prev = n->group_prev;
+    } else {
+        g->tail = n->group_prev;
+    }
+
+    g->count--;
+    n->group_next = n->group_prev = POOL_NIL;
+}
@@ -0,0 +1,33 @@
+#ifndef PROGRAMME_INDEX_H
+#define PROGRAMME_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "programme_table.h"
+#include "node_pool.h"
+
+struct Node;
+
+typedef struct ProgrammeGroup { //Every node that shares one programme
+    uint32_t head;          // members in insertion order (pool slots), linked through Node.group_next/group_prev
+    uint32_t tail;
+    size_t count;
+    size_t ordinal;         // 0, 1, 2, ... in the order the groups were created
+    ProgrammeId key;        // programme_key of every member's programme
+    ProgrammeId spelling;   // programme of the first member, for display
+} ProgrammeGroup;
+
+typedef struct { //Open-addressing map: programme key (see programme_table.h) -> group
+    ProgrammeGroup** slots; // NULL marks an empty slot
+    size_t cap;             // always a power of two (0 = not allocated yet)
+    size_t count;           // number of groups, empty ones included
+} ProgrammeIndex;
+
+void programme_index_init(ProgrammeIndex* ix);
+void programme_index_free(ProgrammeIndex* ix);
+ProgrammeGroup* programme_find(const ProgrammeIndex* ix, ProgrammeId key);
+ProgrammeGroup* programme_intern(ProgrammeIndex* ix, ProgrammeId programme);
+void group_append(ProgrammeGroup* g, NodePool* pool, struct Node* n);
+void group_unlink(ProgrammeGroup* g, NodePool* pool, struct Node* n);
+
+#endif
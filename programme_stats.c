@@ -0,0 +1,487 @@
+
+#include "programme_stats.h"
+#include "parallel.h"
+#include "summary_kernels.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Below this many rows per worker, starting another thread costs more than it saves
+#define STATS_ROWS_PER_WORKER 65536
+#define STATS_MAX_WORKERS 64
+
+typedef struct { //Totals for one programme: counts from pass 1, the rest from its slice
+    size_t count;
+    double mean;
+    double m2;              // sum of squared differences from the mean
+    float min, max;
+    size_t bands[GRADE_BANDS];
+} Partial;
+
+typedef struct { //The rows of one list that one worker folds
+    const LinkedList* list;
+    const MarkColumn* cols;
+    size_t lo, hi;
+    const size_t* row_of;   // programme key of a member of that list -> programme of the report
+} Slice;
+
+typedef struct { //Shared by the workers of one programme_stats call
+    Slice* slices;          // one per worker
+    size_t groups;          // programmes of the report, merged across the lists
+    int workers;
+    Partial* partials;      // workers x groups, counts and bands from pass 1
+    Partial* totals;        // groups, the partials merged, then the slice's moments
+    size_t* cursor;         // workers x groups, next free slot in marks for pass 2
+    float* marks;           // numeric marks, one contiguous slice per programme
+    size_t* start;          // groups + 1 slice boundaries in marks
+    ProgrammeStats* stats;  // groups, filled by the per-programme stage
+} StatsJob;
+
+static int grade_band(float m)
+{
+    return m >= 80 ? 0 : m >= 70 ? 1 : m >= 60 ? 2 : m >= 50 ? 3 : 4;
+}
+
+/*
+ * accumulate:
+ * - Pass 1: counts the worker's slice of a mark column into its own
+ *   per-programme partials (count and grade bands), so no two threads ever
+ *   write the same memory. The moments wait until each programme's marks
+ *   are contiguous.
+ */
+static void accumulate(void* ctx, int worker)
+{
+    StatsJob* job = ctx;
+    Partial* part = job->partials + (size_t)worker * job->groups;
+    const Slice* sl = &job->slices[worker];
+
+    for (size_t i = sl->lo; i < sl->hi; i++) {
+        float m = sl->cols->marks[i];
+        if (m != m) {
+            continue;
+        }
+        ProgrammeId key = programme_key(list_node(sl->list, sl->cols->slots[i])->s.programme);
+        Partial* p = &part[sl->row_of[key]];
+        p->count++;
+        p->bands[grade_band(m)]++;
+    }
+}
+
+/*
+ * scatter:
+ * - Pass 2: copies the worker's numeric marks into their programme's slice.
+ *   Each worker owns a disjoint range of every slice (see programme_stats).
+ */
+static void scatter(void* ctx, int worker)
+{
+    StatsJob* job = ctx;
+    size_t* cursor = job->cursor + (size_t)worker * job->groups;
+    const Slice* sl = &job->slices[worker];
+
+    for (size_t i = sl->lo; i < sl->hi; i++) {
+        float m = sl->cols->marks[i];
+        if (m == m) {
+            ProgrammeId key = programme_key(list_node(sl->list, sl->cols->slots[i])->s.programme);
+            job->marks[cursor[sl->row_of[key]]++] = m;
+        }
+    }
+}
+
+/*
+ * merge:
+ * - Combines two partials (Chan et al.), which is exact for count, min,
+ *   max and bands and keeps the variance stable without a second pass.
+ */
+static void merge(Partial* into, const Partial* p)
+{
+    if (p->count == 0) {
+        return;
+    }
+    if (into->count == 0) {
+        *into = *p;
+        return;
+    }
+
+    size_t n = into->count + p->count;
+    double d = p->mean - into->mean;
+    into->m2 += p->m2 + d * d * ((double)into->count * p->count / n);
+    into->mean += d * p->count / n;
+    if (p->min < into->min) {
+        into->min = p->min;
+    }
+    if (p->max > into->max) {
+        into->max = p->max;
+    }
+    for (int b = 0; b < GRADE_BANDS; b++) {
+        into->bands[b] += p->bands[b];
+    }
+    into->count = n;
+}
+
+/*
+ * select_kth:
+ * - Quickselect: rearranges a[0, n) so a[k] holds the k-th smallest value,
+ *   nothing larger sits before it and nothing smaller after it. Expected
+ *   O(n); the median-of-three pivot and Hoare partitioning keep the many
+ *   equal marks of a real class from degrading it.
+ */
+static float select_kth(float* a, size_t n, size_t k)
+{
+    ptrdiff_t lo = 0, hi = (ptrdiff_t)n - 1, want = (ptrdiff_t)k;
+
+    while (lo < hi) {
+        ptrdiff_t mid = lo + (hi - lo) / 2;
+        float x = a[lo], y = a[mid], z = a[hi];
+        float pivot = (x < y) ? ((y < z) ? y : (x < z) ? z : x)
+                              : ((x < z) ? x : (y < z) ? z : y);
+
+        ptrdiff_t i = lo, j = hi;
+        while (i <= j) {
+            while (a[i] < pivot) {
+                i++;
+            }
+            while (a[j] > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                float t = a[i];
+                a[i++] = a[j];
+                a[j--] = t;
+            }
+        }
+
+        if (want <= j) {
+            hi = j;
+        } else if (want >= i) {
+            lo = i;
+        } else {
+            break;          // a[j+1 .. i-1] all equal the pivot
+        }
+    }
+    return a[want];
+}
+
+/*
+ * quantile:
+ * - The p-quantile of a[0, n) (n > 0), interpolating linearly between the
+ *   two nearest ranks. One selection plus a scan of the upper part.
+ */
+static float quantile(float* a, size_t n, double p)
+{
+    double pos = p * (double)(n - 1);
+    size_t k = (size_t)pos;
+    float below = select_kth(a, n, k);
+    if (k + 1 >= n || pos == (double)k) {
+        return below;
+    }
+
+    float above = a[k + 1];
+    for (size_t i = k + 2; i < n; i++) {
+        if (a[i] < above) {
+            above = a[i];
+        }
+    }
+    return below + (float)((pos - (double)k) * (above - below));
+}
+
+/*
+ * slice_moments:
+ * - Mean, spread, min and max of one programme's marks a[0, n). mark_stats
+ *   gets the sum and the extremes in one SIMD pass over the slice; a second
+ *   pass adds up the squared differences from that mean.
+ */
+static void slice_moments(Partial* p, const float* a, size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    MarkStats ms;
+    mark_stats(a, n, &ms);
+    p->mean = ms.sum / (double)n;
+    p->min = ms.min;
+    p->max = ms.max;
+
+    double m2 = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double d = a[i] - p->mean;
+        m2 += d * d;
+    }
+    p->m2 = m2;
+}
+
+static void fill_quantiles(ProgrammeStats* st, float* a, size_t n)
+{
+    if (n == 0) {
+        st->q1 = st->median = st->q3 = 0.0f;
+        return;
+    }
+    st->q1 = quantile(a, n, 0.25);
+    st->median = quantile(a, n, 0.5);
+    st->q3 = quantile(a, n, 0.75);
+}
+
+/*
+ * finish_programmes:
+ * - Per-programme stage: worker w takes programmes w, w + workers, ... and
+ *   works out the moments, then the quartiles, of each one's slice. Every
+ *   slice is separate, so the workers never touch the same marks.
+ */
+static void finish_programmes(void* ctx, int worker)
+{
+    StatsJob* job = ctx;
+    for (size_t g = (size_t)worker; g < job->groups; g += (size_t)job->workers) {
+        float* a = job->marks + job->start[g];
+        size_t n = job->start[g + 1] - job->start[g];
+        slice_moments(&job->totals[g], a, n);
+        fill_quantiles(&job->stats[g], a, n);
+    }
+}
+
+static void fill_moments(ProgrammeStats* st, const Partial* p)
+{
+    st->count = p->count;
+    st->mean = p->count ? p->mean : 0.0;
+    st->stddev = p->count ? sqrt(p->m2 / p->count) : 0.0;
+    st->min = p->count ? p->min : 0.0f;
+    st->max = p->count ? p->max : 0.0f;
+    memcpy(st->bands, p->bands, sizeof st->bands);
+}
+
+// Worker slices of at most chunk rows each, cut from every list in turn
+static size_t count_slices(const LinkedList* const* lists, size_t nlists, size_t chunk)
+{
+    size_t n = 0;
+    for (size_t l = 0; l < nlists; l++) {
+        n += (lists[l]->cols.len + chunk - 1) / chunk;
+    }
+    return n;
+}
+
+/*
+ * map_programmes:
+ * - Gives every programme of the report a row: the groups of the first list
+ *   in the order they were created, then each group of a later list that no
+ *   earlier list has (looked up by programme key, so case is ignored as
+ *   inside one list). row_of[base[l] + ordinal] is the row of group
+ *   ordinal of list l; byrow[row] is the first group seen for that row and
+ *   members[row] the students it has over every list.
+ *
+ * Returns:
+ *   the number of rows
+ */
+static size_t map_programmes(const LinkedList* const* lists, size_t nlists, const size_t* base,
+                             ProgrammeGroup** scratch, size_t* row_of,
+                             const ProgrammeGroup** byrow, size_t* members)
+{
+    size_t rows = 0;
+    for (size_t l = 0; l < nlists; l++) {
+        const ProgrammeIndex* ix = &lists[l]->programmes;
+        for (size_t i = 0; i < ix->cap; i++) {
+            if (ix->slots[i]) {
+                scratch[ix->slots[i]->ordinal] = ix->slots[i];
+            }
+        }
+
+        for (size_t o = 0; o < ix->count; o++) {
+            const ProgrammeGroup* g = scratch[o];
+            size_t row = rows;
+            for (size_t t = 0; t < l && row == rows; t++) {
+                const ProgrammeGroup* same = programme_find(&lists[t]->programmes, g->key);
+                if (same) {
+                    row = row_of[base[t] + same->ordinal];
+                }
+            }
+            if (row == rows) {
+                byrow[rows] = g;
+                members[rows++] = 0;
+            }
+            row_of[base[l] + o] = row;
+            members[row] += g->count;
+        }
+    }
+    return rows;
+}
+
+/*
+ * programme_stats:
+ * - Count, mean, standard deviation, min, max, quartiles, median and grade
+ *   bands for every programme that has students in any of the nlists lists
+ *   (at most 64 of them), plus one row for all of them together.
+ *   Programmes are matched across lists ignoring case, like inside one.
+ * - Pass 1 splits the mark columns across worker threads, each counting
+ *   its rows per programme. Pass 2 scatters the marks into one slice per
+ *   programme (every worker already knows where its share of each slice
+ *   starts). Then each slice gets its sum, min and max from the SIMD
+ *   kernels, and quickselect finds its quartiles without sorting it. The
+ *   all-programmes row merges the programmes' moments. Several lists only
+ *   mean more slices, so the result is exact, quartiles included.
+ * - *out holds the programme rows in the order the programmes were first
+ *   seen, then the all-programmes row (group == NULL). The caller frees it.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if memory ran out (*out is left alone)
+ */
+int programme_stats(const LinkedList* const* lists, size_t nlists, ProgrammeStats** out, size_t* n)
+{
+    StatsJob job;
+    size_t rows = 0, groups = 0, largest = 0;
+    for (size_t l = 0; l < nlists; l++) {
+        rows += lists[l]->cols.len;
+        groups += lists[l]->programmes.count;
+        if (lists[l]->programmes.count > largest) {
+            largest = lists[l]->programmes.count;
+        }
+    }
+
+    size_t want = rows / STATS_ROWS_PER_WORKER + 1;
+    size_t cpus = (size_t)cpu_count();
+    size_t target = want < cpus ? want : cpus;
+    if (target > STATS_MAX_WORKERS) {
+        target = STATS_MAX_WORKERS;
+    }
+    size_t chunk = rows ? (rows + target - 1) / target : 1;
+    while (count_slices(lists, nlists, chunk) > STATS_MAX_WORKERS && chunk < rows) {
+        chunk *= 2;
+    }
+    size_t nslices = count_slices(lists, nlists, chunk);
+    job.workers = nslices ? (int)nslices : 1;
+
+    size_t* base = malloc(nlists * sizeof *base);
+    ProgrammeGroup** scratch = malloc((largest ? largest : 1) * sizeof *scratch);
+    size_t* row_of = malloc((groups ? groups : 1) * sizeof *row_of);
+    const ProgrammeGroup** byrow = malloc((groups ? groups : 1) * sizeof *byrow);
+    size_t* members = malloc((groups ? groups : 1) * sizeof *members);
+    size_t keys = programme_count();
+    size_t* key_row = malloc((nlists * keys + 1) * sizeof *key_row);
+    job.slices = malloc((size_t)job.workers * sizeof *job.slices);
+    if (!base || !scratch || !row_of || !byrow || !members || !key_row || !job.slices) {
+        free(base);
+        free(scratch);
+        free(row_of);
+        free(key_row);
+        free(byrow);
+        free(members);
+        free(job.slices);
+        return -1;
+    }
+
+    for (size_t l = 0, at = 0; l < nlists; l++) {
+        base[l] = at;
+        at += lists[l]->programmes.count;
+    }
+    job.groups = map_programmes(lists, nlists, base, scratch, row_of, byrow, members);
+    free(scratch);
+
+    // Nodes only know their programme, so each list gets a key -> row table
+    for (size_t l = 0; l < nlists; l++) {
+        const ProgrammeIndex* ix = &lists[l]->programmes;
+        for (size_t i = 0; i < ix->cap; i++) {
+            if (ix->slots[i]) {
+                key_row[l * keys + ix->slots[i]->key] = row_of[base[l] + ix->slots[i]->ordinal];
+            }
+        }
+    }
+
+    size_t used = 0;
+    for (size_t l = 0; l < nlists; l++) {
+        const MarkColumn* cols = &lists[l]->cols;
+        for (size_t lo = 0; lo < cols->len; lo += chunk) {
+            Slice* sl = &job.slices[used++];
+            sl->list = lists[l];
+            sl->cols = cols;
+            sl->lo = lo;
+            sl->hi = cols->len - lo < chunk ? cols->len : lo + chunk;
+            sl->row_of = key_row + l * keys;
+        }
+    }
+    if (used == 0) {
+        job.slices[0].list = lists[0];
+        job.slices[0].cols = &lists[0]->cols;
+        job.slices[0].lo = job.slices[0].hi = 0;
+        job.slices[0].row_of = key_row;
+    }
+
+    size_t cells = (size_t)job.workers * job.groups;
+    job.partials = calloc(cells ? cells : 1, sizeof *job.partials);
+    job.totals = calloc(job.groups ? job.groups : 1, sizeof *job.totals);
+    job.cursor = malloc((cells ? cells : 1) * sizeof *job.cursor);
+    job.start = malloc((job.groups + 1) * sizeof *job.start);
+    job.stats = calloc(job.groups + 1, sizeof *job.stats);
+    job.marks = malloc((rows ? rows : 1) * sizeof *job.marks);
+    if (!job.partials || !job.totals || !job.cursor || !job.start || !job.stats || !job.marks) {
+        free(base);
+        free(row_of);
+        free(key_row);
+        free(byrow);
+        free(members);
+        free(job.slices);
+        free(job.partials);
+        free(job.totals);
+        free(job.cursor);
+        free(job.start);
+        free(job.stats);
+        free(job.marks);
+        return -1;
+    }
+
+    parallel_run(job.workers, accumulate, &job);
+
+    // Add up the counts and lay the slices out: programme g's slice starts
+    // at start[g], and inside it worker w writes after workers 0 .. w-1.
+    size_t at = 0;
+    for (size_t g = 0; g < job.groups; g++) {
+        Partial* total = &job.totals[g];
+        job.start[g] = at;
+        for (int w = 0; w < job.workers; w++) {
+            const Partial* p = &job.partials[(size_t)w * job.groups + g];
+            job.cursor[(size_t)w * job.groups + g] = at;
+            at += p->count;
+            total->count += p->count;
+            for (int b = 0; b < GRADE_BANDS; b++) {
+                total->bands[b] += p->bands[b];
+            }
+        }
+    }
+    job.start[job.groups] = at;
+
+    parallel_run(job.workers, scatter, &job);
+    parallel_run(job.workers, finish_programmes, &job);
+
+    Partial all = { 0 };
+    for (size_t g = 0; g < job.groups; g++) {
+        fill_moments(&job.stats[g], &job.totals[g]);
+        job.stats[g].group = byrow[g];
+        merge(&all, &job.totals[g]);
+    }
+
+    // The slices were only rearranged, so together they are still every mark
+    ProgrammeStats* total = &job.stats[job.groups];
+    fill_moments(total, &all);
+    total->group = NULL;
+    fill_quantiles(total, job.marks, at);
+
+    // Programmes whose members have all left are not reported
+    size_t kept = 0;
+    for (size_t g = 0; g < job.groups; g++) {
+        if (members[g] > 0) {
+            job.stats[kept++] = job.stats[g];
+        }
+    }
+    job.stats[kept++] = *total;
+
+    free(base);
+    free(row_of);
+    free(key_row);
+    free(byrow);
+    free(members);
+    free(job.slices);
+    free(job.partials);
+    free(job.totals);
+    free(job.cursor);
+    free(job.start);
+    free(job.marks);
+    *out = job.stats;
+    *n = kept;
+    return 0;
+}
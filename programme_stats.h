@@ -0,0 +1,22 @@
+#ifndef PROGRAMME_STATS_H
+#define PROGRAMME_STATS_H
+
+#include <stddef.h>
+#include "linked_list.h"
+
+// Grade bands, best first: A >= 80, B >= 70, C >= 60, D >= 50, F below 50
+#define GRADE_BANDS 5
+
+typedef struct { //Statistics over the numeric marks of one programme
+    const ProgrammeGroup* group;    // NULL for the row covering every programme
+    size_t count;                   // NaN marks are left out
+    double mean;
+    double stddev;                  // population standard deviation
+    float min, max;
+    float q1, median, q3;           // linear interpolation between ranks
+    size_t bands[GRADE_BANDS];
+} ProgrammeStats;
+
+int programme_stats(const LinkedList* const* lists, size_t nlists, ProgrammeStats** out, size_t* n);
+
+#endif
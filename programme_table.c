@@ -0,0 +1,234 @@
+#include "programme_table.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLE_PAGE   1024       // names per page
+#define TABLE_PAGES  1024       // so at most about a million distinct programmes
+#define MAP_MIN_CAP  64
+
+typedef struct { //One interned spelling
+    const char* name;
+    ProgrammeId key;            // id of the first spelling equal to this one ignoring case
+} Entry;
+
+typedef struct Slots { //One generation of a map's slot array
+    size_t cap;                 // a power of two
+    struct Slots* older;        // the generation this one replaced
+    _Atomic uint32_t id[];      // id + 1 per slot, 0 = empty
+} Slots;
+
+typedef struct { //Open-addressing set of ids, hashed by their spelling
+    _Atomic(Slots*) slots;      // current generation, NULL before the first id
+    size_t count;
+    int fold;                   // compare ignoring case (and hold only keys)
+} IdMap;
+
+/*
+ * The table is shared by every list. Looking up a spelling that is already
+ * there takes no lock, so parallel loaders don't queue on it: a reader
+ * probes whatever slot array is current, and an id only lands in a slot
+ * (release) after its entry is stored. Adding a spelling takes the lock,
+ * and a reader that missed just retries under it. When a map grows, the
+ * old slot array may still be in a reader's hands, so it is kept on the
+ * older chain instead of freed; the generations add up to less than the
+ * current one. Entries live in fixed pages that never move, which is what
+ * lets programme_name and programme_key skip the lock as well.
+ */
+static Entry* pages[TABLE_PAGES];
+static uint32_t count;
+
+static IdMap exact;             // every spelling
+static IdMap folded = { NULL, 0, 1 };   // one key per spelling ignoring case
+
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1a over the bytes, lower-cased first when the map ignores case
+static uint32_t name_hash(const IdMap* m, const char* s)
+{
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        h ^= m->fold ? (uint32_t)tolower((unsigned char)*s) : (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int same_name(const IdMap* m, const char* a, const char* b)
+{
+    if (!m->fold) {
+        return strcmp(a, b) == 0;
+    }
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return *a == '\0' && *b == '\0';
+}
+
+static Entry* entry(ProgrammeId id)
+{
+    return &pages[id / TABLE_PAGE][id % TABLE_PAGE];
+}
+
+/*
+ * programme_name:
+ * - The spelling behind id. The string stays valid until the process exits.
+ */
+const char* programme_name(ProgrammeId id)
+{
+    return entry(id)->name;
+}
+
+/*
+ * programme_key:
+ * - The key of id's spelling: equal for spellings that differ only in case.
+ */
+ProgrammeId programme_key(ProgrammeId id)
+{
+    return entry(id)->key;
+}
+
+/*
+ * programme_count:
+ * - Number of distinct spellings interned so far.
+ */
+size_t programme_count(void)
+{
+    pthread_mutex_lock(&table_lock);
+    size_t n = count;
+    pthread_mutex_unlock(&table_lock);
+    return n;
+}
+
+// Slot of name in t: where its id is, or the empty slot where it would go
+static size_t probe(const IdMap* m, const Slots* t, const char* name, uint32_t h)
+{
+    size_t mask = t->cap - 1;
+    size_t i = h & mask;
+    uint32_t id;
+    while ((id = atomic_load_explicit(&t->id[i], memory_order_acquire)) &&
+           !same_name(m, programme_name(id - 1), name)) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// The id stored for name in m, or PROGRAMME_NONE; safe without the lock
+static ProgrammeId find(const IdMap* m, const char* name)
+{
+    const Slots* t = atomic_load_explicit(&m->slots, memory_order_acquire);
+    if (!t) {
+        return PROGRAMME_NONE;
+    }
+    uint32_t id = atomic_load_explicit(&t->id[probe(m, t, name, name_hash(m, name))],
+                                       memory_order_acquire);
+    return id ? id - 1 : PROGRAMME_NONE;
+}
+
+// Makes room for one more id in m (lock held)
+static int reserve(IdMap* m)
+{
+    Slots* old = atomic_load_explicit(&m->slots, memory_order_relaxed);
+    if (old && (m->count + 1) * 10 <= old->cap * 7) {
+        return 0;
+    }
+    size_t cap = old ? old->cap * 2 : MAP_MIN_CAP;
+    Slots* t = calloc(1, sizeof *t + cap * sizeof t->id[0]);
+    if (!t) {
+        return -1;
+    }
+    t->cap = cap;
+    t->older = old;
+
+    for (size_t i = 0; old && i < old->cap; i++) {
+        uint32_t id = atomic_load_explicit(&old->id[i], memory_order_relaxed);
+        if (id) {
+            const char* name = programme_name(id - 1);
+            atomic_store_explicit(&t->id[probe(m, t, name, name_hash(m, name))], id,
+                                  memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&m->slots, t, memory_order_release);
+    return 0;
+}
+
+// Stores id in m's slot for name (lock held, name not in m yet)
+static void publish(IdMap* m, const char* name, ProgrammeId id)
+{
+    Slots* t = atomic_load_explicit(&m->slots, memory_order_relaxed);
+    atomic_store_explicit(&t->id[probe(m, t, name, name_hash(m, name))], id + 1,
+                          memory_order_release);
+    m->count++;
+}
+
+// programme_id with the lock held
+static ProgrammeId intern(const char* name)
+{
+    ProgrammeId id = find(&exact, name);
+    if (id != PROGRAMME_NONE) {
+        return id;
+    }
+    if (count == (uint32_t)TABLE_PAGE * TABLE_PAGES ||
+        reserve(&exact) == -1 || reserve(&folded) == -1) {
+        return PROGRAMME_NONE;
+    }
+
+    Entry** page = &pages[count / TABLE_PAGE];
+    if (!*page && !(*page = malloc(TABLE_PAGE * sizeof **page))) {
+        return PROGRAMME_NONE;
+    }
+    size_t len = strlen(name);
+    char* copy = malloc(len + 1);
+    if (!copy) {
+        return PROGRAMME_NONE;
+    }
+    memcpy(copy, name, len + 1);
+
+    // The entry is complete before either map can hand out its id
+    ProgrammeId key = find(&folded, name);
+    Entry* e = &(*page)[count % TABLE_PAGE];
+    e->name = copy;
+    e->key = key != PROGRAMME_NONE ? key : count;
+    if (key == PROGRAMME_NONE) {
+        publish(&folded, name, count);
+    }
+    publish(&exact, name, count);
+    return count++;
+}
+
+/*
+ * programme_id:
+ * - Interns name: returns the id of an identical spelling seen before, or
+ *   stores a copy of name under the next id.
+ * - Only a spelling that is not there yet takes the lock.
+ *
+ * Returns:
+ *   the id, or PROGRAMME_NONE if memory ran out or the table is full
+ */
+ProgrammeId programme_id(const char* name)
+{
+    ProgrammeId id = find(&exact, name);
+    if (id != PROGRAMME_NONE) {
+        return id;
+    }
+    pthread_mutex_lock(&table_lock);
+    id = intern(name);
+    pthread_mutex_unlock(&table_lock);
+    return id;
+}
+
+/*
+ * programme_lookup:
+ * - The key of name, ignoring case, without interning anything: for
+ *   queries, which must not grow the table.
+ *
+ * Returns:
+ *   the key, or PROGRAMME_NONE if no record ever had that programme
+ */
+ProgrammeId programme_lookup(const char* name)
+{
+    return find(&folded, name);
+}
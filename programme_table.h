@@ -0,0 +1,28 @@
+#ifndef PROGRAMME_TABLE_H
+#define PROGRAMME_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Every distinct programme spelling is stored once for the whole process
+ * and records hold its ProgrammeId. Two records have the same spelling
+ * exactly when their ids are equal, in any list.
+ *
+ * Spellings that differ only in case share a key: the id of the first of
+ * them to be interned. Programme groups, QUERY PROGRAMME= and SUMMARY BY
+ * PROGRAMME work on keys, so they ignore case without comparing text.
+ */
+
+typedef uint32_t ProgrammeId;
+
+#define PROGRAMME_NONE UINT32_MAX    // returned by programme_id when memory runs out
+                                     // and by programme_lookup for an unknown name
+
+ProgrammeId programme_id(const char* name);
+const char* programme_name(ProgrammeId id);
+ProgrammeId programme_key(ProgrammeId id);
+ProgrammeId programme_lookup(const char* name);
+size_t programme_count(void);
+
+#endif
@@ -0,0 +1,708 @@
+
+#include "shards.h"
+#include "operations.h"
+#include "parallel.h"
+#include "sorted_view.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each shard is a whole database in a list of its own, so everything a
+ * single list can answer quickly (indexes, cached views, running sums) is
+ * still there per shard. A command fans out with one thread per shard and
+ * the partial answers are combined on the calling thread: sorted output
+ * by a k-way merge of the shards' sorted runs, summaries by merging their
+ * partial aggregates.
+ *
+ * The shards are opened read-only. Nothing moves while they are open, so
+ * a paged SHOW ALL can resume by position, and the journal (which belongs
+ * to the single database) is left alone.
+ */
+
+/*
+ * shards_init:
+ * - Starts with no shards attached.
+ */
+void shards_init(ShardSet* set)
+{
+    set->count = 0;
+}
+
+/*
+ * shards_close:
+ * - Frees every shard's list and detaches them all.
+ */
+void shards_close(ShardSet* set)
+{
+    for (size_t i = 0; i < set->count; i++) {
+        list_clear(&set->shards[i].data);
+    }
+    set->count = 0;
+}
+
+/*
+ * shards_records:
+ * - Number of records over every shard.
+ */
+size_t shards_records(const ShardSet* set)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        n += set->shards[i].data.cols.len;
+    }
+    return n;
+}
+
+/*
+ * shards_footprint:
+ * - Bytes held by every shard's list (see list_footprint).
+ */
+size_t shards_footprint(const ShardSet* set)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        n += list_footprint(&set->shards[i].data);
+    }
+    return n;
+}
+
+/* ---------- OPEN <name>=<file> ... ---------- */
+
+/*
+ * add_shard:
+ * - Reads one "<name>=<file>" (or a bare "<file>", named after the file
+ *   without its directory and extension) of length len into the next shard.
+ *
+ * Returns:
+ *   0 on success, -1 (after saying why) if it can't be used
+ */
+static int add_shard(ShardSet* set, const char* word, size_t len)
+{
+    const char* eq = memchr(word, '=', len);
+    const char* file = eq ? eq + 1 : word;
+    size_t file_len = len - (size_t)(file - word);
+
+    const char* name = word;
+    size_t name_len = eq ? (size_t)(eq - word) : len;
+    if (!eq) {
+        for (const char* p = word; p < word + len; p++) {
+            if (*p == '/' || *p == '\\') {
+                name = p + 1;
+            }
+        }
+        const char* dot = NULL;
+        for (const char* p = name; p < word + len; p++) {
+            if (*p == '.') {
+                dot = p;
+            }
+        }
+        name_len = (size_t)((dot && dot > name ? dot : word + len) - name);
+    }
+
+    if (name_len == 0 || file_len == 0) {
+        puts("Please do: OPEN <name>=<file> [<name>=<file> ...] instead");
+        return -1;
+    }
+    if (set->count == MAX_SHARDS) {
+        printf("CMS: At most %d shards can be opened at once.\n", MAX_SHARDS);
+        return -1;
+    }
+    if (name_len >= SHARD_NAME) {
+        printf("CMS: Shard name %.*s is too long (at most %d characters).\n",
+               (int)name_len, name, SHARD_NAME - 1);
+        return -1;
+    }
+    if (file_len >= sizeof set->shards[0].file) {
+        printf("CMS: File name %.*s is too long.\n", (int)file_len, file);
+        return -1;
+    }
+
+    Shard* sh = &set->shards[set->count];
+    memcpy(sh->name, name, name_len);
+    sh->name[name_len] = '\0';
+    memcpy(sh->file, file, file_len);
+    sh->file[file_len] = '\0';
+
+    for (size_t i = 0; i < set->count; i++) {
+        if (strcmp(set->shards[i].name, sh->name) == 0) {
+            printf("CMS: Two shards are named %s.\n", sh->name);
+            return -1;
+        }
+    }
+    set->count++;
+    return 0;
+}
+
+static void load_shard(void* ctx, int worker)
+{
+    Shard* sh = &((ShardSet*)ctx)->shards[worker];
+    sh->status = opendb(&sh->data, sh->file, 1);
+}
+
+/*
+ * shards_open:
+ * - OPEN <name>=<file> [<name>=<file> ...]: loads every file into a list
+ *   of its own, all of them at once on one thread per file (each file is
+ *   still split across threads by opendb when it is large).
+ * - Either every shard opens or none stays open.
+ *
+ * Returns:
+ *   0 on success, -1 (after saying why) otherwise
+ */
+int shards_open(ShardSet* set, const char* args)
+{
+    set->count = 0;
+    for (const char* p = args;;) {
+        p += strspn(p, " \t");
+        if (*p == '\0') {
+            break;
+        }
+        size_t len = strcspn(p, " \t");
+        if (add_shard(set, p, len) == -1) {
+            set->count = 0;
+            return -1;
+        }
+        p += len;
+    }
+    if (set->count == 0) {
+        puts("Please do: OPEN <name>=<file> [<name>=<file> ...] instead");
+        return -1;
+    }
+
+    for (size_t i = 0; i < set->count; i++) {
+        list_init(&set->shards[i].data);
+    }
+    parallel_run((int)set->count, load_shard, set);
+
+    int failed = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->shards[i].status == -1) {
+            printf("CMS: Could not open shard %s (%s).\n", set->shards[i].name, set->shards[i].file);
+            failed = 1;
+        }
+    }
+    if (failed) {
+        shards_close(set);
+        return -1;
+    }
+
+    for (size_t i = 0; i < set->count; i++) {
+        printf("CMS: Shard %s: %zu record(s) from %s.\n", set->shards[i].name,
+               set->shards[i].data.cols.len, set->shards[i].file);
+    }
+    printf("CMS: Opened %zu shard(s), %zu record(s) in total. They are read-only; "
+           "QUERY, SUMMARY and SHOW ALL read all of them.\n", set->count, shards_records(set));
+    return 0;
+}
+
+/* ---------- k-way merge ---------- */
+
+typedef int (*RowOrder)(const void* ctx, const Record* a, const Record* b);
+
+typedef struct { //Merges one sorted run per shard through a binary heap of the runs
+    const Node* const* rows[MAX_SHARDS];
+    size_t len[MAX_SHARDS];
+    size_t pos[MAX_SHARDS];
+    size_t heap[MAX_SHARDS];    // runs with rows left, the one holding the next row first
+    size_t n;
+    RowOrder order;
+    const void* ctx;
+} Merge;
+
+// Does run a's next row come before run b's? Ties go to the earlier shard
+static int run_before(const Merge* m, size_t a, size_t b)
+{
+    int c = m->order(m->ctx, &m->rows[a][m->pos[a]]->s, &m->rows[b][m->pos[b]]->s);
+    return c < 0 || (c == 0 && a < b);
+}
+
+static void sift_down(Merge* m, size_t i)
+{
+    for (;;) {
+        size_t first = i, l = 2 * i + 1, r = l + 1;
+        if (l < m->n && run_before(m, m->heap[l], m->heap[first])) {
+            first = l;
+        }
+        if (r < m->n && run_before(m, m->heap[r], m->heap[first])) {
+            first = r;
+        }
+        if (first == i) {
+            return;
+        }
+        size_t t = m->heap[i];
+        m->heap[i] = m->heap[first];
+        m->heap[first] = t;
+        i = first;
+    }
+}
+
+/*
+ * merge_start:
+ * - Starts merging runs 0 .. runs - 1, whose rows and len the caller has
+ *   filled in, each already sorted by order.
+ */
+static void merge_start(Merge* m, size_t runs, RowOrder order, const void* ctx)
+{
+    m->order = order;
+    m->ctx = ctx;
+    m->n = 0;
+    for (size_t r = 0; r < runs; r++) {
+        m->pos[r] = 0;
+        if (m->len[r] > 0) {
+            m->heap[m->n++] = r;
+        }
+    }
+    for (size_t i = m->n / 2; i-- > 0;) {
+        sift_down(m, i);
+    }
+}
+
+/*
+ * merge_next:
+ * - Takes the next row of the merged order in O(log runs).
+ *
+ * Returns:
+ *   the row's node (and its run in *run), or NULL once every run is used up
+ */
+static const Node* merge_next(Merge* m, size_t* run)
+{
+    if (m->n == 0) {
+        return NULL;
+    }
+    size_t r = m->heap[0];
+    const Node* n = m->rows[r][m->pos[r]++];
+    if (m->pos[r] == m->len[r]) {
+        m->heap[0] = m->heap[--m->n];
+    }
+    sift_down(m, 0);
+    *run = r;
+    return n;
+}
+
+// Rows of run t that come before row x of run r in the merged order
+static size_t rows_before(const Merge* m, size_t t, const Node* x, size_t r)
+{
+    size_t lo = 0, hi = m->len[t];
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = m->order(m->ctx, &m->rows[t][mid]->s, &x->s);
+        if (c < 0 || (c == 0 && t < r)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * merge_skip:
+ * - Moves a merge that has just started past its first k rows without
+ *   taking them one by one. Run t's split point lies in [lo[t], hi[t]];
+ *   each round takes the middle row of the widest range, counts the rows
+ *   before it in every run by binary search, and so halves that range.
+ *   That is O(runs^2 log^2 n) comparisons however large k is, and needs
+ *   every run to be strictly ordered (a view is: the ID breaks ties).
+ */
+static void merge_skip(Merge* m, size_t k, size_t runs)
+{
+    size_t lo[MAX_SHARDS], hi[MAX_SHARDS];
+    for (size_t t = 0; t < runs; t++) {
+        lo[t] = 0;
+        hi[t] = m->len[t];
+    }
+
+    for (;;) {
+        size_t r = runs;
+        for (size_t t = 0; t < runs; t++) {
+            if (hi[t] > lo[t] && (r == runs || hi[t] - lo[t] > hi[r] - lo[r])) {
+                r = t;
+            }
+        }
+        if (r == runs) {
+            break;
+        }
+
+        size_t mid = lo[r] + (hi[r] - lo[r]) / 2;
+        const Node* x = m->rows[r][mid];
+        size_t before[MAX_SHARDS], rank = 0;
+        for (size_t t = 0; t < runs; t++) {
+            before[t] = t == r ? mid : rows_before(m, t, x, r);
+            rank += before[t];
+        }
+
+        // x is among the first k rows exactly when fewer than k come before it
+        for (size_t t = 0; t < runs; t++) {
+            size_t cut = before[t] + (t == r && rank < k);
+            if (rank < k && cut > lo[t]) {
+                lo[t] = cut;
+            } else if (rank >= k && cut < hi[t]) {
+                hi[t] = cut;
+            }
+        }
+    }
+
+    for (size_t t = 0; t < runs; t++) {
+        m->pos[t] = lo[t];
+    }
+    m->n = 0;
+    for (size_t t = 0; t < runs; t++) {
+        if (m->pos[t] < m->len[t]) {
+            m->heap[m->n++] = t;
+        }
+    }
+    for (size_t i = m->n / 2; i-- > 0;) {
+        sift_down(m, i);
+    }
+}
+
+/* ---------- SHOW ALL and NEXT ---------- */
+
+// The record table, with the shard each row comes from in front
+static void print_header(void)
+{
+    printf("%-15s %-10s %-22s %-26s %-6s\n", "Shard", "ID", "Name", "Programme", "Mark");
+    puts(  "--------------- ---------- ---------------------- -------------------------- ------");
+}
+
+static void print_row(const Shard* sh, const Record* r)
+{
+    printf("%-15s %-10d %-22.22s %-26.26s %6.2f\n",
+           sh->name, r->id, r->name, record_programme(r), record_mark(r));
+}
+
+typedef struct { //Shared by the threads that fetch every shard's view of one order
+    ShardSet* set;
+    const SortSpec* keys;
+    size_t nkeys;
+    const SortedView* views[MAX_SHARDS];
+} ViewJob;
+
+static void fetch_view(void* ctx, int worker)
+{
+    ViewJob* job = ctx;
+    job->views[worker] = view_get(&job->set->shards[worker].data, job->keys, job->nkeys);
+}
+
+static int view_order(const void* ctx, const Record* a, const Record* b)
+{
+    return compare_records(ctx, a, b);
+}
+
+/*
+ * merge_views:
+ * - Starts *m on every shard's cached view of keys. Views that are not
+ *   cached yet are built at the same time, one thread per shard.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+static int merge_views(ShardSet* set, const SortSpec* keys, size_t nkeys, Merge* m)
+{
+    ViewJob job;
+    job.set = set;
+    job.keys = keys;
+    job.nkeys = nkeys;
+    parallel_run((int)set->count, fetch_view, &job);
+
+    for (size_t i = 0; i < set->count; i++) {
+        if (!job.views[i]) {
+            return 0;
+        }
+        m->rows[i] = (const Node* const*)job.views[i]->order;
+        m->len[i] = job.views[i]->len;
+    }
+    // Every view of the same keys compares the same way, so any one's comparator will do
+    merge_start(m, set->count, view_order, &job.views[0]->cmp);
+    return 1;
+}
+
+/*
+ * shards_show_all:
+ * - SHOW ALL without a sort: every shard's records in list order, one
+ *   shard after the other.
+ */
+void shards_show_all(const ShardSet* set)
+{
+    size_t records = shards_records(set);
+    if (records == 0) {
+        puts("(no records)");
+        return;
+    }
+
+    print_header();
+    for (size_t i = 0; i < set->count; i++) {
+        const LinkedList* data = &set->shards[i].data;
+        for (const Node* n = list_node(data, data->head); n; n = list_node(data, n->next)) {
+            print_row(&set->shards[i], &n->s);
+        }
+    }
+    printf("There are in total %zu record(s).\n", records);
+}
+
+/*
+ * shards_show_sorted:
+ * - SHOW ALL SORT=...: merges the shards' sorted views; records that tie
+ *   on every key and the ID come in shard order.
+ */
+void shards_show_sorted(ShardSet* set, const SortSpec* keys, size_t nkeys)
+{
+    Merge m;
+    if (!merge_views(set, keys, nkeys, &m)) {
+        puts("CMS: Not enough memory to sort the records.");
+        return;
+    }
+    size_t records = shards_records(set);
+    if (records == 0) {
+        puts("(no records)");
+        return;
+    }
+
+    print_header();
+    size_t run;
+    for (const Node* n; (n = merge_next(&m, &run)) != NULL;) {
+        print_row(&set->shards[run], &n->s);
+    }
+    printf("There are in total %zu record(s).\n", records);
+}
+
+/*
+ * print_page:
+ * - Prints up to c->limit rows starting at position c->shown of the
+ *   merged order (or of the shards one after the other when unsorted) and
+ *   moves the cursor past them. A sorted page finds its start with
+ *   merge_skip; an unsorted one indexes the list-order view of the shard
+ *   it starts in.
+ */
+static void print_page(ShardSet* set, PageCursor* c)
+{
+    size_t total = shards_records(set);
+    if (c->shown >= total) {
+        puts(c->shown ? "CMS: No more records." : "(no records)");
+        c->active = 0;
+        return;
+    }
+
+    Merge m;
+    const SortedView* order[MAX_SHARDS];
+    int ok = 1;
+    if (c->nkeys > 0) {
+        ok = merge_views(set, c->keys, c->nkeys, &m);
+    } else {
+        for (size_t i = 0; i < set->count && ok; i++) {
+            ok = (order[i] = view_list_order(&set->shards[i].data)) != NULL;
+        }
+    }
+    if (!ok) {
+        puts("CMS: Not enough memory to sort the records.");
+        c->active = 0;
+        return;
+    }
+
+    size_t first = c->shown + 1;
+    size_t end = total - c->shown < c->limit ? total : c->shown + c->limit;
+    size_t run = 0, pos = c->shown;
+    if (c->nkeys > 0) {
+        merge_skip(&m, c->shown, set->count);
+    }
+
+    print_header();
+    for (; c->shown < end; c->shown++) {
+        const Node* n;
+        if (c->nkeys > 0) {
+            n = merge_next(&m, &run);
+        } else {
+            while (pos >= order[run]->len) {
+                pos -= order[run++]->len;
+            }
+            n = order[run]->order[pos++];
+        }
+        print_row(&set->shards[run], &n->s);
+    }
+
+    c->active = c->shown < total;
+    if (c->active) {
+        printf("CMS: Rows %zu-%zu of %zu. Type NEXT for more.\n", first, c->shown, total);
+    } else {
+        printf("CMS: Rows %zu-%zu of %zu. End of records.\n", first, c->shown, total);
+    }
+}
+
+/*
+ * shards_show_page:
+ * - SHOW ALL [SORT=...] LIMIT n [OFFSET m] over the shards: prints one
+ *   page and leaves *c where it stopped.
+ */
+void shards_show_page(ShardSet* set, PageCursor* c, const SortSpec* keys, size_t nkeys,
+                      size_t limit, size_t offset)
+{
+    c->limit = limit;
+    c->shown = offset;
+    c->nkeys = nkeys;
+    if (nkeys > 0) {
+        memcpy(c->keys, keys, nkeys * sizeof *keys);
+    }
+    print_page(set, c);
+}
+
+/*
+ * shards_next:
+ * - NEXT over the shards. They can't change while open, so the page
+ *   simply starts at the position the last one stopped at.
+ *
+ * Returns:
+ *   0, or -1 if there is no page in progress
+ */
+int shards_next(ShardSet* set, PageCursor* c)
+{
+    if (!c->active) {
+        puts("CMS: Nothing to continue. Start with SHOW ALL LIMIT <n>.");
+        return -1;
+    }
+    print_page(set, c);
+    return 0;
+}
+
+/* ---------- QUERY ---------- */
+
+typedef struct { //One shard's matches, collected by its thread
+    const Node** rows;
+    size_t len, cap;
+    int failed;
+} Matches;
+
+// NodeVisit that appends to a Matches
+static void collect(void* ctx, const Node* n)
+{
+    Matches* m = ctx;
+    if (m->failed) {
+        return;
+    }
+    if (m->len == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 64;
+        const Node** rows = realloc(m->rows, cap * sizeof *rows);
+        if (!rows) {
+            m->failed = 1;
+            return;
+        }
+        m->rows = rows;
+        m->cap = cap;
+    }
+    m->rows[m->len++] = n;
+}
+
+typedef struct { //Shared by the threads of one QUERY
+    const ShardSet* set;
+    const QuerySpec* q;
+    Matches found[MAX_SHARDS];
+} QueryJob;
+
+static void query_shard(void* ctx, int worker)
+{
+    QueryJob* job = ctx;
+    query_run(&job->set->shards[worker].data, job->q, collect, &job->found[worker]);
+}
+
+static int match_order(const void* ctx, const Record* a, const Record* b)
+{
+    return query_order(ctx, a, b);
+}
+
+/*
+ * shards_query:
+ * - QUERY over the shards: each shard runs it through its own indexes on
+ *   a thread of its own, then the matches are merged into QUERY's usual
+ *   order (by name or by mark; PROGRAMME= and ID= list shard by shard).
+ */
+void shards_query(const ShardSet* set, const char* args)
+{
+    QuerySpec q;
+    if (!parse_query(args, &q)) {
+        return;
+    }
+
+    QueryJob job;
+    job.set = set;
+    job.q = &q;
+    memset(job.found, 0, sizeof job.found);
+    parallel_run((int)set->count, query_shard, &job);
+
+    Merge m;
+    int failed = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        failed |= job.found[i].failed;
+        m.rows[i] = (const Node* const*)job.found[i].rows;
+        m.len[i] = job.found[i].len;
+    }
+
+    if (failed) {
+        puts("CMS: Not enough memory to run the query.");
+    } else {
+        merge_start(&m, set->count, match_order, &q);
+        size_t count = 0, run;
+        for (const Node* n; (n = merge_next(&m, &run)) != NULL; count++) {
+            if (count == 0) {
+                print_header();
+            }
+            print_row(&set->shards[run], &n->s);
+        }
+        query_footer(&q, count);
+    }
+
+    for (size_t i = 0; i < set->count; i++) {
+        free(job.found[i].rows);
+    }
+}
+
+/* ---------- SUMMARY [BY PROGRAMME] ---------- */
+
+typedef struct { //Shared by the threads of one SUMMARY
+    const ShardSet* set;
+    Summary parts[MAX_SHARDS];
+} SummaryJob;
+
+static void summarise_shard(void* ctx, int worker)
+{
+    SummaryJob* job = ctx;
+    summary_of(&job->set->shards[worker].data, &job->parts[worker]);
+}
+
+/*
+ * shards_summary:
+ * - SUMMARY over the shards: every shard's count, sum and extremes, taken
+ *   in parallel and merged, then how many students each shard holds.
+ */
+void shards_summary(const ShardSet* set)
+{
+    SummaryJob job;
+    job.set = set;
+    parallel_run((int)set->count, summarise_shard, &job);
+
+    Summary all = { 0 };
+    for (size_t i = 0; i < set->count; i++) {
+        summary_merge(&all, &job.parts[i]);
+    }
+    print_summary(&all);
+
+    printf("Students per shard:");
+    for (size_t i = 0; i < set->count; i++) {
+        printf("%s %s %zu", i ? "," : "", set->shards[i].name, job.parts[i].count);
+    }
+    printf("\n");
+}
+
+/*
+ * shards_summary_by_programme:
+ * - SUMMARY BY PROGRAMME over the shards. programme_stats splits every
+ *   shard's marks across its threads and merges the partials, so the
+ *   report (quartiles included) is the one a single list would give.
+ */
+void shards_summary_by_programme(const ShardSet* set)
+{
+    const LinkedList* lists[MAX_SHARDS];
+    for (size_t i = 0; i < set->count; i++) {
+        lists[i] = &set->shards[i].data;
+    }
+    show_summary_by_programme_lists(lists, set->count);
+}
@@ -0,0 +1,37 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <stddef.h>
+#include "linked_list.h"
+#include "commands.h"
+
+#define MAX_SHARDS 16
+#define SHARD_NAME 16           // longest shard name + 1
+
+typedef struct { //One database file, opened into a list of its own
+    char name[SHARD_NAME];
+    char file[256];
+    LinkedList data;
+    int status;                 // opendb's result, set by the thread that loaded it
+} Shard;
+
+typedef struct { //The files OPEN <name>=<file> ... attached; read-only while open
+    Shard shards[MAX_SHARDS];
+    size_t count;               // 0 = none, the session works on its single database
+} ShardSet;
+
+void shards_init(ShardSet* set);
+int shards_open(ShardSet* set, const char* args);
+void shards_close(ShardSet* set);
+size_t shards_records(const ShardSet* set);
+size_t shards_footprint(const ShardSet* set);
+void shards_show_all(const ShardSet* set);
+void shards_show_sorted(ShardSet* set, const SortSpec* keys, size_t nkeys);
+void shards_show_page(ShardSet* set, PageCursor* c, const SortSpec* keys, size_t nkeys,
+                      size_t limit, size_t offset);
+int shards_next(ShardSet* set, PageCursor* c);
+void shards_query(const ShardSet* set, const char* args);
+void shards_summary(const ShardSet* set);
+void shards_summary_by_programme(const ShardSet* set);
+
+#endif
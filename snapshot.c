@@ -0,0 +1,295 @@
+
+#include "snapshot.h"
+#include "checksum.h"
+#include "file_map.h"
+#include "stats.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Binary snapshot layout (.cmsb), all integers little-endian:
+ *
+ *   offset  size  field
+ *        0     4  magic "CMSB"
+ *        4     4  schema version (SNAPSHOT_VERSION)
+ *        8     4  reserved, written as 0 (version 1: the record size)
+ *       12     4  reserved, written as 0
+ *       16     8  record count
+ *       24     8  checksum64 over all record bytes
+ *       32     .  records
+ *
+ * Each record is as long as its text needs, so names have no length limit:
+ *
+ *        0     4  id (int32)
+ *        4     4  mark (IEEE-754 float bits)
+ *        8     4  name length n
+ *       12     4  programme length m
+ *       16   n+1  name and a NUL
+ *     17+n   m+1  programme and a NUL
+ *
+ * The NULs let a decoded Student point into the file instead of copying
+ * the name. Version 1 records were fixed width (id, name and programme
+ * NUL-padded to 50 bytes each, mark) and are still read.
+ */
+
+#define SNAPSHOT_VERSION 2
+#define HEADER_SIZE      32
+#define V1_RECORD_SIZE   108
+#define V1_TEXT          50
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char* p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t get_u64(const unsigned char* p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+/*
+ * snapshot_is_binary:
+ * - Checks the magic bytes at the start of a file.
+ *
+ * Returns:
+ *   1  if data starts with "CMSB"
+ *   0  otherwise (treat it as TSV)
+ */
+int snapshot_is_binary(const char* data, size_t size)
+{
+    return size >= SNAPSHOT_MAGIC_LEN && memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) == 0;
+}
+
+/*
+ * snapshot_record_size / snapshot_encode_record / snapshot_decode_record:
+ * - Convert between a Student and its record; a NULL name is written as
+ *   an empty one. Encoding writes exactly snapshot_record_size bytes.
+ * - Decoding checks the lengths against the avail bytes at r and points
+ *   st->name into r, so the name is only good while r is.
+ * - The journal uses the same record encoding for its entries.
+ *
+ * Returns (decode):
+ *   the record's size in bytes, or 0 if it is malformed
+ */
+size_t snapshot_record_size(const Student* st)
+{
+    return SNAPSHOT_RECORD_MIN + (st->name ? strlen(st->name) : 0) +
+           strnlen(st->programme, MAX_PROGRAM - 1);
+}
+
+void snapshot_encode_record(unsigned char* r, const Student* st)
+{
+    const char* name = st->name ? st->name : "";
+    size_t n = strlen(name);
+    size_t m = strnlen(st->programme, MAX_PROGRAM - 1);
+
+    uint32_t bits;
+    memcpy(&bits, &st->mark, sizeof bits);
+    put_u32(r, (uint32_t)st->id);
+    put_u32(r + 4, bits);
+    put_u32(r + 8, (uint32_t)n);
+    put_u32(r + 12, (uint32_t)m);
+
+    memcpy(r + 16, name, n);
+    r[16 + n] = '\0';
+    memcpy(r + 17 + n, st->programme, m);
+    r[17 + n + m] = '\0';
+}
+
+size_t snapshot_decode_record(const unsigned char* r, size_t avail, Student* st)
+{
+    if (avail < SNAPSHOT_RECORD_MIN) {
+        return 0;
+    }
+    size_t n = get_u32(r + 8);
+    size_t m = get_u32(r + 12);
+    if (n > avail - SNAPSHOT_RECORD_MIN || m > avail - SNAPSHOT_RECORD_MIN - n || m >= MAX_PROGRAM) {
+        return 0;
+    }
+    const char* name = (const char*)r + 16;
+    const char* programme = name + n + 1;
+    if (strnlen(name, n + 1) != n || strnlen(programme, m + 1) != m) {
+        return 0;       // a NUL inside the text, or none after it
+    }
+
+    uint32_t bits = get_u32(r + 4);
+    st->id = (int32_t)get_u32(r);
+    memcpy(&st->mark, &bits, sizeof bits);
+    st->name = name;
+    memcpy(st->programme, programme, m + 1);
+    return SNAPSHOT_RECORD_MIN + n + m;
+}
+
+// A version 1 record: fixed width, text NUL-padded
+static size_t decode_v1_record(const unsigned char* r, size_t avail, Student* st)
+{
+    const char* name = (const char*)r + 4;
+    const char* programme = name + V1_TEXT;
+    if (avail < V1_RECORD_SIZE || strnlen(name, V1_TEXT) == V1_TEXT ||
+        strnlen(programme, V1_TEXT) >= MAX_PROGRAM) {
+        return 0;
+    }
+
+    uint32_t bits = get_u32(r + 4 + 2 * V1_TEXT);
+    st->id = (int32_t)get_u32(r);
+    st->name = name;
+    strcpy(st->programme, programme);
+    memcpy(&st->mark, &bits, sizeof bits);
+    return V1_RECORD_SIZE;
+}
+
+/*
+ * snapshot_load:
+ * - Validates the header (version and checksum) and the records' lengths
+ *   of a snapshot already in memory (e.g. from map_file), then inserts
+ *   every record into store. Nothing is inserted if validation fails.
+ * - Duplicate IDs are reported and skipped, same as in a TSV file. A mark
+ *   a record cannot hold (see mark_fits) fails the whole load, again as in
+ *   a TSV file, rather than being lost at the next save.
+ *
+ * Returns:
+ *   0  on success (*loaded = number of records inserted)
+ *  -1  if the snapshot is corrupt, holds such a mark or an insert failed
+ */
+int snapshot_load(LinkedList* store, const char* data, size_t size, size_t* loaded)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    *loaded = 0;
+
+    if (size < HEADER_SIZE || !snapshot_is_binary(data, size)) {
+        fprintf(stderr, "snapshot: file too short for a header.\n");
+        return -1;
+    }
+
+    uint32_t version = get_u32(p + 4);
+    uint32_t recsize = get_u32(p + 8);
+    uint64_t count   = get_u64(p + 16);
+    uint64_t sum     = get_u64(p + 24);
+
+    size_t (*decode)(const unsigned char*, size_t, Student*) = snapshot_decode_record;
+    if (version == 1 && recsize == V1_RECORD_SIZE) {
+        decode = decode_v1_record;
+    } else if (version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "snapshot: unsupported version %u (record size %u).\n", version, recsize);
+        return -1;
+    }
+    if (checksum64(p + HEADER_SIZE, size - HEADER_SIZE, CHECKSUM_SEED) != sum) {
+        fprintf(stderr, "snapshot: checksum mismatch, file is corrupt.\n");
+        return -1;
+    }
+
+    // Every record must decode and together they must fill the file exactly
+    size_t off = HEADER_SIZE, used = 1;
+    Student st;
+    for (uint64_t i = 0; i < count && used; i++) {
+        used = decode(p + off, size - off, &st);
+        off += used;
+    }
+    if (!used || off != size) {
+        fprintf(stderr, "snapshot: file is truncated or has trailing bytes.\n");
+        return -1;
+    }
+
+    off = HEADER_SIZE;
+    for (uint64_t i = 0; i < count; i++) {
+        off += decode(p + off, size - off, &st);
+
+        int rc = insert_node(store, &st);
+        if (rc == -2) {
+            fprintf(stderr, "Record %llu: duplicate ID %d. Skipping.\n", (unsigned long long)i + 1, st.id);
+            continue;
+        }
+        if (rc == -3) {
+            fprintf(stderr, "Record %llu: mark %g of ID %d is outside 0 to %.2f, which a record can't hold. "
+                    "The file was not opened.\n", (unsigned long long)i + 1, st.mark, st.id, MARK_LIMIT);
+            return -1;
+        }
+        if (rc == -1) {
+            return -1;
+        }
+        (*loaded)++;
+    }
+    return 0;
+}
+
+/*
+ * snapshot_save:
+ * - Sizes the records, encodes the whole list into one buffer (header +
+ *   records) and writes it
+ *   with a single fwrite to "<filename>.tmp", which replace_commit fsyncs
+ *   and renames over filename.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  on allocation or I/O failure
+ */
+int snapshot_save(LinkedList* store, const char* filename)
+{
+    size_t count = store ? store->cols.len : 0;
+    size_t total = HEADER_SIZE;
+    Student st;
+    for (Node* n = store ? list_node(store, store->head) : NULL; n; n = list_node(store, n->next)) {
+        record_to_student(&st, &n->s);
+        total += snapshot_record_size(&st);
+    }
+
+    unsigned char* buf = malloc(total);
+    if (!buf) {
+        fprintf(stderr, "snapshot: out of memory for %zu record(s).\n", count);
+        return -1;
+    }
+
+    unsigned char* r = buf + HEADER_SIZE;
+    for (Node* n = store ? list_node(store, store->head) : NULL; n; n = list_node(store, n->next)) {
+        record_to_student(&st, &n->s);
+        snapshot_encode_record(r, &st);
+        r += snapshot_record_size(&st);
+    }
+
+    memcpy(buf, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN);
+    put_u32(buf + 4, SNAPSHOT_VERSION);
+    put_u32(buf + 8, 0);
+    put_u32(buf + 12, 0);
+    put_u64(buf + 16, count);
+    put_u64(buf + 24, checksum64(buf + HEADER_SIZE, total - HEADER_SIZE, CHECKSUM_SEED));
+
+    FileReplace out;
+    FILE* f = replace_open(&out, filename, "wb");
+    if (!f) {
+        fprintf(stderr, "snapshot: fopen(\"%s.tmp\") failed: ", filename);
+        perror("");
+        free(buf);
+        return -1;
+    }
+
+    int rc = 0;
+    if (fwrite(buf, 1, total, f) != total) {
+        perror("snapshot: fwrite");
+        replace_abort(&out);
+        rc = -1;
+    } else if (replace_commit(&out) != 0) {
+        perror("snapshot: commit");
+        rc = -1;
+    } else {
+        STATS_ADD(STAT_BYTES_SAVED, total);
+    }
+
+    free(buf);
+    return rc;
+}
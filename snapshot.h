@@ -0,0 +1,19 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include "linked_list.h"
+
+#define SNAPSHOT_MAGIC     "CMSB"
+#define SNAPSHOT_MAGIC_LEN 4
+#define SNAPSHOT_EXT       ".cmsb"
+#define SNAPSHOT_RECORD_MIN 18    // a record with an empty name and programme
+
+int snapshot_is_binary(const char* data, size_t size);
+int snapshot_load(LinkedList* store, const char* data, size_t size, size_t* loaded);
+int snapshot_save(LinkedList* store, const char* filename);
+size_t snapshot_record_size(const Student* st);
+void snapshot_encode_record(unsigned char* r, const Student* st);
+size_t snapshot_decode_record(const unsigned char* r, size_t avail, Student* st);
+
+#endif
@@ -0,0 +1,328 @@
+
+#include "sorted_view.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A view is an array of node pointers in one sort order. Sorting once and
+ * keeping the array means a repeated SHOW ALL SORT=... costs only the
+ * printing, and the list itself - which is what SAVE writes - keeps its
+ * insertion order. Single changes are patched into the arrays with a
+ * binary search and one memmove; a view that would need more patches than
+ * VIEW_PATCH_LIMIT before anyone looks at it again is simply dropped and
+ * rebuilt when it is next asked for.
+ */
+
+static int same_keys(const SortedView* v, const SortSpec* keys, size_t nkeys)
+{
+    if (v->nkeys != nkeys) {
+        return 0;
+    }
+    for (size_t k = 0; k < nkeys; k++) {
+        if (v->keys[k].key != keys[k].key || !v->keys[k].ascending != !keys[k].ascending) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * lower_bound_skip:
+ * - First position whose row does not sort before key, reading the array
+ *   as if the entry at skip were not there (skip = len means none is).
+ *
+ * Returns:
+ *   the position in that shortened array
+ */
+static size_t lower_bound_skip(const SortedView* v, const Record* key, size_t skip)
+{
+    size_t lo = 0, hi = v->len - (skip < v->len);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const Node* n = v->order[mid + (mid >= skip)];
+        if (compare_records(&v->cmp, &n->s, key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * view_lower_bound:
+ * - First position in v whose row does not sort before key, in O(log n).
+ */
+size_t view_lower_bound(const SortedView* v, const Record* key)
+{
+    return lower_bound_skip(v, key, v->len);
+}
+
+/*
+ * sort_nodes:
+ * - Stable merge sort of a[0, n) on cmp, using tmp (n entries) as scratch.
+ */
+static void sort_nodes(Node** a, Node** tmp, size_t n, const Comparator* cmp)
+{
+    if (n < 2) {
+        return;
+    }
+    size_t half = n / 2;
+    sort_nodes(a, tmp, half, cmp);
+    sort_nodes(a + half, tmp, n - half, cmp);
+
+    size_t i = 0, j = half, k = 0;
+    while (i < half && j < n) {
+        tmp[k++] = (compare_records(cmp, &a[j]->s, &a[i]->s) < 0) ? a[j++] : a[i++];
+    }
+    while (i < half) {
+        tmp[k++] = a[i++];
+    }
+    memcpy(a, tmp, k * sizeof *a);     // a[j, n) is already in place
+}
+
+/*
+ * build:
+ * - Fills v->order with every node in v's order.
+ * - A single MARK key is read straight off the mark index, which holds
+ *   exactly this order (mark, then ID in the same direction), in O(n).
+ *   The list order is the list itself. Anything else is collected from the
+ *   list and merge sorted.
+ *
+ * Returns:
+ *   0  on success
+ *  -1  if memory ran out (v stays invalid)
+ */
+static int build(const LinkedList* L, SortedView* v)
+{
+    size_t n = L->cols.len;
+    if (n > v->cap) {
+        Node** order = realloc(v->order, n * sizeof *order);
+        if (!order) {
+            return -1;
+        }
+        v->order = order;
+        v->cap   = n;
+    }
+
+    if (v->nkeys == 1 && v->keys[0].key == SORT_BY_MARK && !L->bulk) {
+        uint32_t x = tree_at(&L->by_mark, v->keys[0].ascending ? 0 : n - 1);
+        for (size_t i = 0; x != TREE_NIL; i++) {
+            v->order[i] = list_node(L, x);
+            x = v->keys[0].ascending ? tree_next(&L->by_mark, x) : tree_prev(&L->by_mark, x);
+        }
+    } else if (v->nkeys == 1 && v->keys[0].key == SORT_BY_LIST_ORDER && v->keys[0].ascending) {
+        size_t i = 0;
+        for (Node* cur = list_node(L, L->head); cur; cur = list_node(L, cur->next)) {
+            v->order[i++] = cur;
+        }
+    } else {
+        Node** tmp = malloc((n ? n : 1) * sizeof *tmp);
+        if (!tmp) {
+            return -1;
+        }
+        size_t i = 0;
+        for (Node* cur = list_node(L, L->head); cur; cur = list_node(L, cur->next)) {
+            v->order[i++] = cur;
+        }
+        sort_nodes(v->order, tmp, n, &v->cmp);
+        free(tmp);
+    }
+
+    v->len = n;
+    v->valid = 1;
+    return 0;
+}
+
+/*
+ * view_get:
+ * - Returns the view for keys, building it if it isn't cached or was
+ *   dropped. Reading a view resets its patch allowance.
+ * - The pointer is good until the list or the cache next changes.
+ *
+ * Returns:
+ *   the view, or NULL if the keys are invalid or memory ran out
+ */
+const SortedView* view_get(LinkedList* L, const SortSpec* keys, size_t nkeys)
+{
+    if (!L->views && !(L->views = calloc(1, sizeof *L->views))) {
+        return NULL;
+    }
+    ViewCache* c = L->views;
+
+    // Reuse the slot for these keys, else an empty one, else the least recently used
+    SortedView* v = NULL;
+    for (size_t i = 0; i < VIEW_CACHE_SIZE && !v; i++) {
+        if (same_keys(&c->views[i], keys, nkeys)) {
+            v = &c->views[i];
+        }
+    }
+    if (!v) {
+        v = &c->views[0];
+        for (size_t i = 0; i < VIEW_CACHE_SIZE; i++) {
+            if (c->views[i].nkeys == 0) {
+                v = &c->views[i];
+                break;
+            }
+            if (c->views[i].used < v->used) {
+                v = &c->views[i];
+            }
+        }
+        if (comparator_init(&v->cmp, keys, nkeys) == -1) {
+            return NULL;
+        }
+        comparator_break_ties(&v->cmp);
+        memcpy(v->keys, keys, nkeys * sizeof *keys);
+        v->nkeys = nkeys;
+        v->valid = 0;
+    }
+
+    if (!v->valid && build(L, v) == -1) {
+        return NULL;
+    }
+    v->patches = 0;
+    v->used = ++c->clock;
+    return v;
+}
+
+/*
+ * view_list_order:
+ * - The list's own order (Record.seq) as a view, for paging without SORT=:
+ *   OFFSET becomes an index and NEXT a binary search, instead of walks
+ *   along the list.
+ */
+const SortedView* view_list_order(LinkedList* L)
+{
+    static const SortSpec order = { SORT_BY_LIST_ORDER, 1 };
+    return view_get(L, &order, 1);
+}
+
+/*
+ * patchable:
+ * - Whether a change should be patched into v. A view that has already
+ *   taken VIEW_PATCH_LIMIT changes unread is dropped instead: rebuilding
+ *   it later is cheaper than more memmoves, and views nobody reads stop
+ *   costing anything.
+ */
+static int patchable(const LinkedList* L, SortedView* v)
+{
+    if (!v->valid) {
+        return 0;
+    }
+    if (L->bulk || v->patches >= VIEW_PATCH_LIMIT) {
+        v->valid = 0;
+        return 0;
+    }
+    v->patches++;
+    return 1;
+}
+
+// Position of n in v, found by its current data; len if it isn't there
+static size_t find_node(const SortedView* v, const Node* n)
+{
+    size_t pos = view_lower_bound(v, &n->s);
+    return (pos < v->len && v->order[pos] == n) ? pos : v->len;
+}
+
+/*
+ * views_inserted:
+ * - Patches a node that was just added to the list into every live view.
+ */
+void views_inserted(LinkedList* L, Node* n)
+{
+    if (!L->views) {
+        return;
+    }
+    for (size_t i = 0; i < VIEW_CACHE_SIZE; i++) {
+        SortedView* v = &L->views->views[i];
+        if (!patchable(L, v)) {
+            continue;
+        }
+        if (v->len == v->cap) {
+            size_t cap = v->cap ? v->cap * 2 : 16;
+            Node** order = realloc(v->order, cap * sizeof *order);
+            if (!order) {
+                v->valid = 0;
+                continue;
+            }
+            v->order = order;
+            v->cap   = cap;
+        }
+        size_t pos = view_lower_bound(v, &n->s);
+        memmove(v->order + pos + 1, v->order + pos, (v->len - pos) * sizeof *v->order);
+        v->order[pos] = n;
+        v->len++;
+    }
+}
+
+/*
+ * views_removing:
+ * - Takes a node out of every live view. Call it while the node still
+ *   holds its data, before it is unlinked and freed.
+ */
+void views_removing(LinkedList* L, Node* n)
+{
+    if (!L->views) {
+        return;
+    }
+    for (size_t i = 0; i < VIEW_CACHE_SIZE; i++) {
+        SortedView* v = &L->views->views[i];
+        if (!patchable(L, v)) {
+            continue;
+        }
+        size_t pos = find_node(v, n);
+        if (pos == v->len) {
+            v->valid = 0;           // out of step somehow: rebuild rather than guess
+            continue;
+        }
+        memmove(v->order + pos, v->order + pos + 1, (v->len - pos - 1) * sizeof *v->order);
+        v->len--;
+    }
+}
+
+/*
+ * views_updating:
+ * - Moves a node to where r will put it, in every live view. Call it
+ *   before n->s is overwritten. Only the entries between the old and the
+ *   new position shift.
+ */
+void views_updating(LinkedList* L, Node* n, const Record* r)
+{
+    if (!L->views) {
+        return;
+    }
+    for (size_t i = 0; i < VIEW_CACHE_SIZE; i++) {
+        SortedView* v = &L->views->views[i];
+        if (!patchable(L, v)) {
+            continue;
+        }
+        size_t from = find_node(v, n);
+        if (from == v->len) {
+            v->valid = 0;
+            continue;
+        }
+        size_t to = lower_bound_skip(v, r, from);
+        if (to > from) {
+            memmove(v->order + from, v->order + from + 1, (to - from) * sizeof *v->order);
+        } else if (to < from) {
+            memmove(v->order + to + 1, v->order + to, (from - to) * sizeof *v->order);
+        }
+        v->order[to] = n;
+    }
+}
+
+/*
+ * views_free:
+ * - Drops every view of the list (on list_clear).
+ */
+void views_free(LinkedList* L)
+{
+    if (!L->views) {
+        return;
+    }
+    for (size_t i = 0; i < VIEW_CACHE_SIZE; i++) {
+        free(L->views->views[i].order);
+    }
+    free(L->views);
+    L->views = NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef SORTED_VIEW_H
+#define SORTED_VIEW_H
+
+#include <stddef.h>
+#include "linked_list.h"
+
+#define VIEW_CACHE_SIZE 8       // sort orders kept at once; the least recently used goes first
+#define VIEW_PATCH_LIMIT 64     // changes patched into a view between two reads before it is dropped
+
+typedef struct { //One cached sort order: every node of the list, sorted
+    SortSpec keys[SORT_MAX_KEYS];
+    size_t nkeys;               // 0 = slot unused
+    Comparator cmp;             // keys plus the ID, so no two rows tie
+    Node** order;
+    size_t len, cap;
+    int valid;                  // order matches the list right now
+    size_t patches;             // changes patched in since the view was last read
+    unsigned long used;         // LRU stamp
+} SortedView;
+
+typedef struct ViewCache { //The views of one list, created on the first sorted display
+    SortedView views[VIEW_CACHE_SIZE];
+    unsigned long clock;
+} ViewCache;
+
+const SortedView* view_get(LinkedList* L, const SortSpec* keys, size_t nkeys);
+const SortedView* view_list_order(LinkedList* L);
+size_t view_lower_bound(const SortedView* v, const Record* key);
+void views_inserted(LinkedList* L, Node* n);
+void views_removing(LinkedList* L, Node* n);
+void views_updating(LinkedList* L, Node* n, const Record* r);
+void views_free(LinkedList* L);
+
+#endif
@@ -0,0 +1,219 @@
+
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/*
+ * stats_now_ns:
+ * - Monotonic clock in nanoseconds, for timing commands.
+ */
+uint64_t stats_now_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000u
+         + (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000u / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#ifdef CMS_DISABLE_STATS
+
+void stats_print(FILE* out)
+{
+    fputs("CMS: Statistics are not available in this build (CMS_DISABLE_STATS).\n", out);
+}
+
+void stats_dump_at_exit(void)
+{
+}
+
+#else
+
+#include <stdatomic.h>
+
+// Counters are bumped by the parse workers and the autosave thread as well,
+// so they are atomic; relaxed is enough because they are only ever summed.
+static _Atomic uint64_t counters[STAT_COUNTERS];
+
+static const char* const counter_names[STAT_COUNTERS] = {
+    "Bytes read from database files",
+    "Bytes written to database files",
+    "Bytes written to the journal",
+    "Records loaded",
+    "Records rejected",
+    "Nodes allocated",
+    "Node blocks allocated",
+};
+
+typedef struct { //Calls and latencies of one command, timed on the main thread only
+    const char* name;
+    uint64_t calls;
+    uint64_t failed;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[STATS_BUCKETS];
+} CommandStats;
+
+// Keyed by the first word of the command line; the last entry takes the rest
+static CommandStats commands[] = {
+    { .name = "OPEN" }, { .name = "SHOW" }, { .name = "NEXT" }, { .name = "SUMMARY" },
+    { .name = "INSERT" }, { .name = "QUERY" }, { .name = "TOP" }, { .name = "BOTTOM" },
+    { .name = "RANK" }, { .name = "UPDATE" }, { .name = "DELETE" }, { .name = "IMPORT" },
+    { .name = "CONVERT" }, { .name = "SAVE" }, { .name = "STATS" }, { .name = "HELP" },
+    { .name = "EXIT" }, { .name = "(other)" },
+};
+
+#define NCOMMANDS (sizeof commands / sizeof commands[0])
+
+void stats_add(StatCounter c, uint64_t n)
+{
+    atomic_fetch_add_explicit(&counters[c], n, memory_order_relaxed);
+}
+
+// Bucket of a latency: 0 for 0 ns, else one more than the index of its top bit
+static int bucket_of(uint64_t ns)
+{
+    int b = 0;
+    while (ns) {
+        ns >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/*
+ * stats_command:
+ * - Records one finished command: its call, whether it failed, and its
+ *   latency in the command's log2 histogram.
+ */
+void stats_command(const char* command, uint64_t ns, int failed)
+{
+    size_t word = strcspn(command, " ");
+    CommandStats* c = &commands[NCOMMANDS - 1];
+    for (size_t i = 0; i + 1 < NCOMMANDS; i++) {
+        if (strlen(commands[i].name) == word && strncmp(command, commands[i].name, word) == 0) {
+            c = &commands[i];
+            break;
+        }
+    }
+
+    c->calls++;
+    c->failed += failed != 0;
+    c->total_ns += ns;
+    if (ns > c->max_ns) {
+        c->max_ns = ns;
+    }
+    c->buckets[bucket_of(ns)]++;
+}
+
+/*
+ * percentile:
+ * - The p-th percentile latency (nearest rank) read off the histogram. It
+ *   is the upper edge of the bucket holding that rank, so at most twice the
+ *   true value, and never more than the slowest call.
+ */
+static uint64_t percentile(const CommandStats* c, double p)
+{
+    uint64_t rank = (uint64_t)(p * (double)c->calls + 0.999999);
+    uint64_t seen = 0;
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        seen += c->buckets[b];
+        if (seen >= rank) {
+            uint64_t edge = b == 0 ? 0 : b >= 64 ? UINT64_MAX : (uint64_t)1 << b;
+            return edge < c->max_ns ? edge : c->max_ns;
+        }
+    }
+    return c->max_ns;
+}
+
+// Writes ns in the most readable unit into buf
+static const char* duration(char* buf, size_t cap, uint64_t ns)
+{
+    if (ns < 1000) {
+        snprintf(buf, cap, "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, cap, "%.1fus", ns / 1e3);
+    } else if (ns < 1000000000) {
+        snprintf(buf, cap, "%.1fms", ns / 1e6);
+    } else {
+        snprintf(buf, cap, "%.2fs", ns / 1e9);
+    }
+    return buf;
+}
+
+/*
+ * stats_print:
+ * - Prints the per-command table (calls, failures, mean, p50/p95/p99 and
+ *   max latency) for every command used so far, then the I/O counters.
+ */
+void stats_print(FILE* out)
+{
+    char mean[16], p50[16], p95[16], p99[16], max[16];
+
+    fprintf(out, "%-8s %8s %6s %9s %9s %9s %9s %9s\n",
+            "Command", "Calls", "Failed", "Mean", "p50", "p95", "p99", "Max");
+    for (size_t i = 0; i < NCOMMANDS; i++) {
+        const CommandStats* c = &commands[i];
+        if (c->calls == 0) {
+            continue;
+        }
+        fprintf(out, "%-8s %8llu %6llu %9s %9s %9s %9s %9s\n", c->name,
+                (unsigned long long)c->calls, (unsigned long long)c->failed,
+                duration(mean, sizeof mean, c->total_ns / c->calls),
+                duration(p50, sizeof p50, percentile(c, 0.50)),
+                duration(p95, sizeof p95, percentile(c, 0.95)),
+                duration(p99, sizeof p99, percentile(c, 0.99)),
+                duration(max, sizeof max, c->max_ns));
+    }
+
+    fputc('\n', out);
+    for (int k = 0; k < STAT_COUNTERS; k++) {
+        fprintf(out, "%-32s %llu\n", counter_names[k],
+                (unsigned long long)atomic_load_explicit(&counters[k], memory_order_relaxed));
+    }
+}
+
+/*
+ * stats_dump_at_exit:
+ * - Writes stats_print's report when the CMS_STATS environment variable is
+ *   set: to stderr for "-", otherwise to the file it names.
+ */
+void stats_dump_at_exit(void)
+{
+    const char* v = getenv("CMS_STATS");
+    if (!v || !*v) {
+        return;
+    }
+    if (strcmp(v, "-") == 0) {
+        stats_print(stderr);
+        return;
+    }
+
+    FILE* f = fopen(v, "w");
+    if (!f) {
+        perror(v);
+        return;
+    }
+    stats_print(f);
+    fclose(f);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Session statistics for the STATS command: calls and latency per command
+ * and a few I/O counters. Building with -DCMS_DISABLE_STATS turns every
+ * STATS_* macro below into nothing, so the instrumented code compiles to
+ * exactly what it was without it.
+ */
+
+typedef enum {
+    STAT_BYTES_READ,        // files mapped by OPEN / IMPORT / CONVERT
+    STAT_BYTES_SAVED,       // written by SAVE / CONVERT
+    STAT_BYTES_JOURNALED,   // journal entries written by autosave
+    STAT_RECORDS_LOADED,    // rows that made it into the list on OPEN / IMPORT
+    STAT_RECORDS_REJECTED,  // rows skipped as malformed or duplicate
+    STAT_NODES_ALLOCATED,   // pool_alloc calls
+    STAT_NODE_BLOCKS,       // slabs pool_alloc had to malloc
+    STAT_COUNTERS
+} StatCounter;
+
+#define STATS_BUCKETS 65    // bucket b holds latencies in [2^(b-1), 2^b) ns; 0 holds 0 ns
+
+uint64_t stats_now_ns(void);
+void stats_print(FILE* out);
+void stats_dump_at_exit(void);
+
+#ifdef CMS_DISABLE_STATS
+
+#define STATS_ADD(counter, n)               ((void)0)
+#define STATS_START(var)                    ((void)0)
+#define STATS_COMMAND(command, var, failed) ((void)0)
+
+#else
+
+void stats_add(StatCounter c, uint64_t n);
+void stats_command(const char* command, uint64_t ns, int failed);
+
+#define STATS_ADD(counter, n)               stats_add((counter), (uint64_t)(n))
+#define STATS_START(var)                    uint64_t var = stats_now_ns()
+#define STATS_COMMAND(command, var, failed) stats_command((command), stats_now_ns() - (var), (failed))
+
+#endif
+
+#endif
@@ -0,0 +1,227 @@
+
+#include "summary_kernels.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+// Indices are tracked in 32-bit lanes, so the kernels never see more rows than this
+#define KERNEL_CHUNK ((size_t)1 << 30)
+
+/*
+ * stats_scalar:
+ * - Plain loop used for CPUs without SIMD support and for the tail rows the
+ *   vector kernels leave over.
+ * - Rows [from, n) are folded into *st, which must already hold the result
+ *   for rows [0, from). Strict comparisons keep the first row on ties.
+ */
+static void stats_scalar(const float* m, size_t from, size_t n, MarkStats* st)
+{
+    for (size_t i = from; i < n; i++) {
+        st->sum += m[i];
+        if (m[i] < st->min) { st->min = m[i]; st->argmin = i; }
+        if (m[i] > st->max) { st->max = m[i]; st->argmax = i; }
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * reduce_lanes:
+ * - Folds per-lane minimum/maximum values and their row numbers into *st.
+ * - On equal values the lower row wins, which keeps "first row" semantics.
+ */
+static void reduce_lanes(const float* mins, const int32_t* minidx,
+                         const float* maxs, const int32_t* maxidx,
+                         int lanes, MarkStats* st)
+{
+    for (int l = 0; l < lanes; l++) {
+        if (minidx[l] >= 0 && (mins[l] < st->min ||
+            (mins[l] == st->min && (size_t)minidx[l] < st->argmin))) {
+            st->min = mins[l];
+            st->argmin = (size_t)minidx[l];
+        }
+        if (maxidx[l] >= 0 && (maxs[l] > st->max ||
+            (maxs[l] == st->max && (size_t)maxidx[l] < st->argmax))) {
+            st->max = maxs[l];
+            st->argmax = (size_t)maxidx[l];
+        }
+    }
+}
+
+/*
+ * stats_sse2:
+ * - 4 marks per step. The sum is accumulated in double lanes so millions of
+ *   marks do not lose precision; min/max keep a row number per lane.
+ * - SSE2 has no blend instruction, so lanes are selected with and/andnot/or.
+ */
+#ifdef __SSE2__
+static void stats_sse2(const float* m, size_t n, MarkStats* st)
+{
+    size_t vn = n & ~(size_t)3;
+    __m128d sum_lo = _mm_setzero_pd(), sum_hi = _mm_setzero_pd();
+    __m128  vmin = _mm_set1_ps(INFINITY), vmax = _mm_set1_ps(-INFINITY);
+    __m128i imin = _mm_set1_epi32(-1), imax = _mm_set1_epi32(-1);
+    __m128i idx  = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i step = _mm_set1_epi32(4);
+
+    for (size_t i = 0; i < vn; i += 4) {
+        __m128 v = _mm_loadu_ps(m + i);
+        sum_lo = _mm_add_pd(sum_lo, _mm_cvtps_pd(v));
+        sum_hi = _mm_add_pd(sum_hi, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+
+        __m128 lt = _mm_cmplt_ps(v, vmin);
+        vmin = _mm_or_ps(_mm_and_ps(lt, v), _mm_andnot_ps(lt, vmin));
+        imin = _mm_or_si128(_mm_and_si128(_mm_castps_si128(lt), idx),
+                            _mm_andnot_si128(_mm_castps_si128(lt), imin));
+
+        __m128 gt = _mm_cmpgt_ps(v, vmax);
+        vmax = _mm_or_ps(_mm_and_ps(gt, v), _mm_andnot_ps(gt, vmax));
+        imax = _mm_or_si128(_mm_and_si128(_mm_castps_si128(gt), idx),
+                            _mm_andnot_si128(_mm_castps_si128(gt), imax));
+
+        idx = _mm_add_epi32(idx, step);
+    }
+
+    double sums[4];
+    float mins[4], maxs[4];
+    int32_t minidx[4], maxidx[4];
+    _mm_storeu_pd(sums, sum_lo);
+    _mm_storeu_pd(sums + 2, sum_hi);
+    _mm_storeu_ps(mins, vmin);
+    _mm_storeu_ps(maxs, vmax);
+    _mm_storeu_si128((__m128i*)minidx, imin);
+    _mm_storeu_si128((__m128i*)maxidx, imax);
+
+    st->sum += sums[0] + sums[1] + sums[2] + sums[3];
+    reduce_lanes(mins, minidx, maxs, maxidx, 4, st);
+    stats_scalar(m, vn, n, st);
+}
+#endif
+
+/*
+ * stats_avx2:
+ * - Same as stats_sse2 with 8 marks per step and real blend instructions.
+ * - Compiled with a target attribute so the rest of the program does not
+ *   need -mavx2; it is only called after a runtime CPU check.
+ */
+__attribute__((target("avx2")))
+static void stats_avx2(const float* m, size_t n, MarkStats* st)
+{
+    size_t vn = n & ~(size_t)7;
+    __m256d sum_lo = _mm256_setzero_pd(), sum_hi = _mm256_setzero_pd();
+    __m256  vmin = _mm256_set1_ps(INFINITY), vmax = _mm256_set1_ps(-INFINITY);
+    __m256i imin = _mm256_set1_epi32(-1), imax = _mm256_set1_epi32(-1);
+    __m256i idx  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(8);
+
+    for (size_t i = 0; i < vn; i += 8) {
+        __m256 v = _mm256_loadu_ps(m + i);
+        sum_lo = _mm256_add_pd(sum_lo, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+        sum_hi = _mm256_add_pd(sum_hi, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+
+        __m256 lt = _mm256_cmp_ps(v, vmin, _CMP_LT_OQ);
+        vmin = _mm256_blendv_ps(vmin, v, lt);
+        imin = _mm256_blendv_epi8(imin, idx, _mm256_castps_si256(lt));
+
+        __m256 gt = _mm256_cmp_ps(v, vmax, _CMP_GT_OQ);
+        vmax = _mm256_blendv_ps(vmax, v, gt);
+        imax = _mm256_blendv_epi8(imax, idx, _mm256_castps_si256(gt));
+
+        idx = _mm256_add_epi32(idx, step);
+    }
+
+    double sums[8];
+    float mins[8], maxs[8];
+    int32_t minidx[8], maxidx[8];
+    _mm256_storeu_pd(sums, sum_lo);
+    _mm256_storeu_pd(sums + 4, sum_hi);
+    _mm256_storeu_ps(mins, vmin);
+    _mm256_storeu_ps(maxs, vmax);
+    _mm256_storeu_si256((__m256i*)minidx, imin);
+    _mm256_storeu_si256((__m256i*)maxidx, imax);
+
+    for (int l = 0; l < 8; l++) {
+        st->sum += sums[l];
+    }
+    reduce_lanes(mins, minidx, maxs, maxidx, 8, st);
+    stats_scalar(m, vn, n, st);
+}
+
+#endif
+
+typedef void (*StatsKernel)(const float* m, size_t n, MarkStats* st);
+
+static void stats_plain(const float* m, size_t n, MarkStats* st)
+{
+    stats_scalar(m, 0, n, st);
+}
+
+static StatsKernel kernel = stats_plain;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void choose_kernel(void)
+{
+#ifdef HAVE_X86_KERNELS
+#ifdef __SSE2__
+    kernel = stats_sse2;
+#endif
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = stats_avx2;
+    }
+#endif
+}
+
+/*
+ * pick_kernel:
+ * - Chooses the widest kernel this CPU supports, once per process. The
+ *   per-programme stats call mark_stats from several threads at once, so
+ *   the choice goes through pthread_once.
+ */
+static StatsKernel pick_kernel(void)
+{
+    pthread_once(&kernel_once, choose_kernel);
+    return kernel;
+}
+
+/*
+ * mark_stats:
+ * - Computes count, sum, min, max and the first row of min and max over a
+ *   contiguous mark column in one pass.
+ * - Uses AVX2 or SSE2 when available, otherwise a scalar loop. NaN marks are
+ *   added to the sum but never become min or max, same as the old loop.
+ */
+void mark_stats(const float* marks, size_t n, MarkStats* out)
+{
+    StatsKernel kernel = pick_kernel();
+
+    out->count  = n;
+    out->sum    = 0.0;
+    out->min    = INFINITY;
+    out->max    = -INFINITY;
+    out->argmin = SIZE_MAX;
+    out->argmax = SIZE_MAX;
+
+    for (size_t base = 0; base < n; base += KERNEL_CHUNK) {
+        size_t len = n - base < KERNEL_CHUNK ? n - base : KERNEL_CHUNK;
+
+        MarkStats part = { len, 0.0, INFINITY, -INFINITY, SIZE_MAX, SIZE_MAX };
+        kernel(marks + base, len, &part);
+
+        // Later chunks only win on strictly better values, keeping the first row
+        out->sum += part.sum;
+        if (part.argmin != SIZE_MAX && part.min < out->min) {
+            out->min = part.min;
+            out->argmin = base + part.argmin;
+        }
+        if (part.argmax != SIZE_MAX && part.max > out->max) {
+            out->max = part.max;
+            out->argmax = base + part.argmax;
+        }
+    }
+}
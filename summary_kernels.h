@@ -0,0 +1,17 @@
+#ifndef SUMMARY_KERNELS_H
+#define SUMMARY_KERNELS_H
+
+#include <stddef.h>
+
+typedef struct { //Result of one pass over a mark column
+    size_t count;
+    double sum;
+    float min;
+    float max;
+    size_t argmin;      // first row holding min (SIZE_MAX if there is none)
+    size_t argmax;      // first row holding max (SIZE_MAX if there is none)
+} MarkStats;
+
+void mark_stats(const float* marks, size_t n, MarkStats* out);
+
+#endif
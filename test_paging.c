@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "linked_list.h"
+#include "commands.h"
+
+/*
+ * test_paging:
+ * Checks that SHOW ALL LIMIT n [OFFSET m] followed by NEXT keeps its row
+ * numbers right when rows are deleted between the two, before or at the
+ * cursor, and that a re-added ID is not mistaken for the last row shown.
+ * Page output goes to stdout as usual; failures are reported on stderr.
+ *
+ * Returns: 0 if every check passed, 1 otherwise.
+ */
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void fill(LinkedList *list, int n)
+{
+    for (int i = 1; i <= n; i++) {
+        Student st;
+        char name[32];
+        memset(&st, 0, sizeof st);
+        st.id = 2300000 + i;
+        snprintf(name, sizeof name, "Student %d", i);
+        st.name = name;
+        strcpy(st.programme, "Computer Science");
+        st.mark = 50.0f + i;
+        insert_node(list, &st);
+    }
+}
+
+/* Starts a fresh cursor, freeing the name the last one kept. */
+static void reset(PageCursor *c)
+{
+    free(c->last_name);
+    memset(c, 0, sizeof *c);
+}
+
+int main(void)
+{
+    LinkedList list;
+    PageCursor c = { 0 };
+
+    /* A row before the cursor goes: NEXT must print rows 2-3 of 5, not 3-4. */
+    list_init(&list);
+    reset(&c);
+    fill(&list, 6);
+    show_page(&list, &c, NULL, 0, 2, 0);
+    check(c.shown == 2 && c.active, "first page shows rows 1-2");
+    list_delete_by_id(&list, 2300001);
+    show_next(&list, &c);
+    check(c.shown == 3, "NEXT after deleting a shown row counts rows 2-3");
+    check(c.active, "rows remain after the second page");
+    show_next(&list, &c);
+    check(c.shown == 5 && !c.active, "last page ends at row 5 of 5");
+    list_clear(&list);
+
+    /* The row the cursor points at goes: NEXT resumes at the one after it. */
+    list_init(&list);
+    reset(&c);
+    fill(&list, 4);
+    show_page(&list, &c, NULL, 0, 2, 0);
+    list_delete_by_id(&list, 2300003);
+    show_next(&list, &c);
+    check(c.shown == 3 && !c.active, "NEXT after deleting the cursor row ends at 3 of 3");
+    list_clear(&list);
+
+    /* A row after the cursor goes: nothing before it moves. */
+    list_init(&list);
+    reset(&c);
+    fill(&list, 5);
+    show_page(&list, &c, NULL, 0, 2, 0);
+    list_delete_by_id(&list, 2300005);
+    show_next(&list, &c);
+    check(c.shown == 4 && !c.active, "NEXT after deleting a later row ends at 4 of 4");
+    list_clear(&list);
+
+    /* OFFSET starts mid-list; a row before it goes, NEXT still follows on. */
+    list_init(&list);
+    reset(&c);
+    fill(&list, 10);
+    show_page(&list, &c, NULL, 0, 3, 4);
+    check(c.shown == 7 && c.last.id == 2300007, "OFFSET 4 LIMIT 3 shows rows 5-7");
+    list_delete_by_id(&list, 2300001);
+    show_next(&list, &c);
+    check(c.shown == 9 && !c.active && c.last.id == 2300010, "NEXT after OFFSET and a delete ends at 9 of 9");
+    list_clear(&list);
+
+    /* The last row shown is deleted and added again: it now sits at the end. */
+    list_init(&list);
+    reset(&c);
+    fill(&list, 5);
+    show_page(&list, &c, NULL, 0, 2, 0);
+    list_delete_by_id(&list, 2300002);
+    fill(&list, 2);                     /* 2300001 is refused, 2300002 goes last */
+    show_next(&list, &c);
+    check(c.shown == 3 && c.last.id == 2300004, "a re-added last row is not skipped past");
+    list_clear(&list);
+
+    reset(&c);
+    if (failures == 0)
+        printf("test_paging: all checks passed\n");
+    return failures ? 1 : 0;
+}